@@ -5,68 +5,274 @@
 #include <algorithm>    // for max_element
 #include <cmath>        // for sqrt
 #include "Matrix.hpp"
+#include "DynamicMatrix.hpp"
+#include "LU.hpp"
+#include "QR.hpp"
+#include "Cholesky.hpp"
+
+namespace MatrixImpl{
+
+    template<typename T, typename Mat>
+    inline T det2(const Mat &m){
+        return m(0, 0)*m(1, 1)-m(0, 1)*m(1, 0);
+    }
+
+    template<typename T, typename Mat>
+    inline T det3(const Mat &m){
+        return m(0, 0)*(m(1, 1)*m(2, 2)-m(1, 2)*m(2, 1))
+              -m(0, 1)*(m(1, 0)*m(2, 2)-m(1, 2)*m(2, 0))
+              +m(0, 2)*(m(1, 0)*m(2, 1)-m(1, 1)*m(2, 0));
+    }
+
+    // Laplace expansion along the first two rows, 2x2 minors shared
+    template<typename T, typename Mat>
+    inline T det4(const Mat &m){
+        const T s0 = m(0, 0)*m(1, 1)-m(1, 0)*m(0, 1);
+        const T s1 = m(0, 0)*m(1, 2)-m(1, 0)*m(0, 2);
+        const T s2 = m(0, 0)*m(1, 3)-m(1, 0)*m(0, 3);
+        const T s3 = m(0, 1)*m(1, 2)-m(1, 1)*m(0, 2);
+        const T s4 = m(0, 1)*m(1, 3)-m(1, 1)*m(0, 3);
+        const T s5 = m(0, 2)*m(1, 3)-m(1, 2)*m(0, 3);
+
+        const T c5 = m(2, 2)*m(3, 3)-m(3, 2)*m(2, 3);
+        const T c4 = m(2, 1)*m(3, 3)-m(3, 1)*m(2, 3);
+        const T c3 = m(2, 1)*m(3, 2)-m(3, 1)*m(2, 2);
+        const T c2 = m(2, 0)*m(3, 3)-m(3, 0)*m(2, 3);
+        const T c1 = m(2, 0)*m(3, 2)-m(3, 0)*m(2, 2);
+        const T c0 = m(2, 0)*m(3, 1)-m(3, 0)*m(2, 1);
+
+        return s0*c5-s1*c4+s2*c3+s3*c2-s4*c1+s5*c0;
+    }
+
+    // product of the pivots of a pivoted LU
+    template<typename T, typename Mat>
+    T det_elimination(const Mat &m, std::false_type){
+        const size_t n = m.rows();
+        std::vector<T> a(n*n);
+        std::vector<size_t> perm(n);
+        for(size_t i = 0; i < n; ++i)
+            for(size_t j = 0; j < n; ++j)
+                a[i*n+j] = m(i, j);
+
+        T res = static_cast<T>(lu_factor(n, a.data(), n, perm.data()));
+        for(size_t i = 0; i < n && res != static_cast<T>(0); ++i)
+            res *= a[i*n+i];
+        return res;
+    }
+
+    // Bareiss fraction-free elimination, every division is exact
+    template<typename T, typename Mat>
+    T det_elimination(const Mat &m, std::true_type){
+        const size_t n = m.rows();
+        std::vector<T> a(n*n);
+        T sign = 1, prev = 1;
+        for(size_t i = 0; i < n; ++i)
+            for(size_t j = 0; j < n; ++j)
+                a[i*n+j] = m(i, j);
+
+        for(size_t k = 0; k+1 < n; ++k){
+            if(!a[k*n+k]){
+                size_t p = k+1;
+                while(p < n && !a[p*n+k]) ++p;
+                if(p == n) return 0;
+                std::swap_ranges(a.begin()+k*n, a.begin()+(k+1)*n, a.begin()+p*n);
+                sign = -sign;
+            }
+            for(size_t i = k+1; i < n; ++i){
+                for(size_t j = k+1; j < n; ++j)
+                    a[i*n+j] = (a[i*n+j]*a[k*n+k]-a[i*n+k]*a[k*n+j])/prev;
+            }
+            prev = a[k*n+k];
+        }
+        return n ? sign*a[n*n-1] : static_cast<T>(1);
+    }
+
+    template<typename T, size_t N>
+    struct Det{
+        template<typename Mat>
+        static T run(const Mat &m) { return det_elimination<T>(m, std::is_integral<T>()); }
+    };
+
+    template<typename T>
+    struct Det<T, 1>{
+        template<typename Mat>
+        static T run(const Mat &m) { return m(0, 0); }
+    };
+
+    template<typename T>
+    struct Det<T, 2>{
+        template<typename Mat>
+        static T run(const Mat &m) { return det2<T>(m); }
+    };
+
+    template<typename T>
+    struct Det<T, 3>{
+        template<typename Mat>
+        static T run(const Mat &m) { return det3<T>(m); }
+    };
+
+    template<typename T>
+    struct Det<T, 4>{
+        template<typename Mat>
+        static T run(const Mat &m) { return det4<T>(m); }
+    };
+
+}   // MatrixImpl
+
+namespace Lee{
+    enum class LeastSquareMethod { QR, Cholesky };
+}
+
+namespace MatrixImpl{
+
+    // a: m x n, b: m, x: n, all dense row-major
+    template<typename T>
+    void least_square(size_t m, size_t n, const T *a, const T *b, T *x, Lee::LeastSquareMethod method, T *residual){
+        static_assert(!std::is_integral<T>::value, "least squares needs a floating-point type");
+
+        if(method == Lee::LeastSquareMethod::Cholesky){
+            std::vector<T> s(n*n), y(n);
+            gemm_parallel(n, n, m, static_cast<T>(1), a, static_cast<size_t>(1), n, a, n, static_cast<size_t>(1), 
+                          static_cast<T>(0), s.data(), n);
+            gemv_parallel(n, m, static_cast<T>(1), a, static_cast<size_t>(1), n, b, static_cast<size_t>(1), 
+                          static_cast<T>(0), y.data(), static_cast<size_t>(1));
+
+            if(chol_factor(n, s.data(), n)){
+                chol_solve(n, s.data(), n, y.data(), static_cast<size_t>(1), static_cast<size_t>(1));
+                std::copy(y.begin(), y.end(), x);
+
+                // |A*x-b| a row at a time
+                if(residual){
+                    T sum = static_cast<T>(0);
+                    for(size_t i = 0; i < m; ++i){
+                        T r = -b[i];
+                        for(size_t j = 0; j < n; ++j)
+                            r += a[i*n+j]*x[j];
+                        sum += r*r;
+                    }
+                    *residual = std::sqrt(sum);
+                }
+                return;
+            }
+        }
+
+        std::vector<T> qr(a, a+m*n), y(b, b+m), tau(n);
+        qr_factor(m, n, qr.data(), n, tau.data());
+        qr_solve(m, n, qr.data(), n, tau.data(), y.data(), static_cast<size_t>(1), static_cast<size_t>(1));
+        std::copy(y.begin(), y.begin()+n, x);
+
+        // |A*x-b| = |(Q^T*b)(n:m)|
+        if(residual){
+            T sum = static_cast<T>(0);
+            for(size_t i = n; i < m; ++i)
+                sum += y[i]*y[i];
+            *residual = std::sqrt(sum);
+        }
+    }
+
+}   // MatrixImpl
 
 namespace Lee{
     
-    template<typename T, int N>
+    template<typename T, size_t N>
     Matrix<T, N, N> eye(){
         Matrix<T, N, N> m;
-        for(int i = 0; i != N; ++i)
+        for(size_t i = 0; i != N; ++i)
             m(i, i) = 1;
         return m;
     }
 
-    template<typename T, int M, int N>
+    template<typename T>
+    DynamicMatrix<T> eye(size_t n){
+        DynamicMatrix<T> m(n, n);
+        for(size_t i = 0; i != n; ++i)
+            m(i, i) = 1;
+        return m;
+    }
+
+    template<typename T, size_t M, size_t N>
     Matrix<T, M, N> rand(){
         Matrix<T, M, N> tmp;
         std::srand(time(nullptr));
-        for(int i = 0; i != M; ++i)
-            for(int j = 0; j != N; ++j)
+        for(size_t i = 0; i != M; ++i)
+            for(size_t j = 0; j != N; ++j)
                 tmp(i, j) = std::rand()%20+1;
         return tmp;
     }    
 
-    template<typename T, int M, int N>
+    template<typename T, size_t M, size_t N>
     T max(const Matrix<T, M, N> &m){
-        return *std::max_element(m.cbegin(), m.cend());
-    }
-
-    template<typename T, int M, int N>
-    Matrix<T, M, N> abs(const Matrix<T, M, N> &m){
-        Matrix<T, M, N> res = m;
-        for(int i = 0; i < M; ++i)
-            for(int j = 0; j < N; ++j)
-                res(i, j) = ((m(i, j) > 0) ? m(i, j) : -m(i, j));
-        return res;
+        return *std::max_element(m.begin(), m.end());
     }
 
-    template<typename T, int N>
+    template<typename T, size_t N>
     Matrix<T, N, N>& power(Matrix<T, N, N> &m, int k){
         while(--k){
-            m = m*m;
+            m = Matrix<T, N, N>(m*m);
         }
         return m;
     }
 
-    template<typename T, int M, int N>
-    void Matrix<T, M, N>::permute(int r1, int r2){
-        if(r1 >= M || r2 >= M) throw std::out_of_range("Matrix index");
-        for(int j = 0; j != N; ++j){
-            std::swap((*this)(r1, j), (*this)(r2, j));
-        }
+    template<typename T, size_t M, size_t N>
+    size_t rank(const Matrix<T, M, N> &m){
+        return pivot(m).size();
     }
 
-    template<typename T, int M, int N>
-    int rank(const Matrix<T, M, N> &m){
+    template<typename T>
+    size_t rank(const DynamicMatrix<T> &m){
         return pivot(m).size();
     }
 
-    template<typename T, int M, int N>
-    Matrix<T, M-1, N-1> left(const Matrix<T, M, N> &m, int ii, int jj){
-        if(M<1 || N<1 || ii<0 || ii>=M || jj<0 || jj>=N) throw std::out_of_range("Matrix index");
+    // [A b]
+    template<typename T, size_t M, size_t N, size_t N1, size_t N2>
+    Matrix<T, M, N> col_cat(const Matrix<T, M, N1> &A, const Matrix<T, M, N2> &B){
+        static_assert(N == N1+N2, "col_cat dimensions do not match");
+        Matrix<T, M, N> res;
+        for(size_t i = 0; i != M; ++i){
+            for(size_t j = 0; j != N1; ++j) res(i, j) = A(i, j);
+            for(size_t j = 0; j != N2; ++j) res(i, N1+j) = B(i, j);
+        }
+        return res;
+    }
+
+    template<typename T>
+    DynamicMatrix<T> col_cat(const DynamicMatrix<T> &A, const DynamicMatrix<T> &B){
+        assert(A.rows() == B.rows() && "col_cat dimensions do not match");
+        DynamicMatrix<T> res(A.rows(), A.cols()+B.cols());
+        for(size_t i = 0; i != A.rows(); ++i){
+            for(size_t j = 0; j != A.cols(); ++j) res(i, j) = A(i, j);
+            for(size_t j = 0; j != B.cols(); ++j) res(i, A.cols()+j) = B(i, j);
+        }
+        return res;
+    }
+
+    // columns c1..c2 of A
+    template<typename T, size_t M, size_t N, size_t N1>
+    Matrix<T, M, N> col_split(const Matrix<T, M, N1> &A, size_t c1, size_t c2){
+        assert(c1 <= c2 && c2 < N1 && c2-c1+1 == N && "col_split out of range");
+        Matrix<T, M, N> res;
+        for(size_t i = 0; i != M; ++i)
+            for(size_t j = 0; j != N; ++j)
+                res(i, j) = A(i, c1+j);
+        return res;
+    }
+
+    template<typename T>
+    DynamicMatrix<T> col_split(const DynamicMatrix<T> &A, size_t c1, size_t c2){
+        assert(c1 <= c2 && c2 < A.cols() && "col_split out of range");
+        DynamicMatrix<T> res(A.rows(), c2-c1+1);
+        for(size_t i = 0; i != A.rows(); ++i)
+            for(size_t j = 0; j != res.cols(); ++j)
+                res(i, j) = A(i, c1+j);
+        return res;
+    }
+
+    template<typename T, size_t M, size_t N>
+    Matrix<T, M-1, N-1> left(const Matrix<T, M, N> &m, size_t ii, size_t jj){
+        if(M<1 || N<1 || ii>=M || jj>=N) throw std::out_of_range("Matrix index");
         Matrix<T, M-1, N-1> res;
-        for(int i = 0; i != M-1; ++i)
-            for(int j = 0; j != N-1; ++j){
+        for(size_t i = 0; i != M-1; ++i)
+            for(size_t j = 0; j != N-1; ++j){
                 if(j>=jj && i<ii) res(i, j) = m(i, j+1);
                 else if(i>=ii && j<jj) res(i, j) = m(i+1, j);
                 else if(i>=ii && j>=jj) res(i, j) = m(i+1, j+1);
@@ -75,87 +281,109 @@ namespace Lee{
         return res;
     }
 
-    template<typename T, int N>
-    T det(Matrix<T, N, N> m){
-        if(N==1) return m(0, 0);
-        double num = 0;
-        int cntr = 0, cntc = 0;
-        for(int i = 0; i != N; ++i) if(!m(i, 0)) ++cntr;
-        for(int i = 0; i != N; ++i) if(!m(0, i)) ++cntc;
-        if(cntr > cntc)
-        {
-            for(int i = 0; i != N; ++i){
-                if(!m(i, 0)) num += 0;
-                else num += (m(i, 0)*cofactor(m, i, 0));
-            }
-        }
-        else{
-            for(int i = 0; i != N; ++i){
-                if(!m(0, i)) num += 0;
-                else num += (m(0, i)*cofactor(m, 0, i));
-            }
-        }
-        return num;
+    // closed forms up to 4x4, otherwise pivoted LU (fraction-free elimination for integers)
+    template<typename T, size_t N, typename V>
+    T det(const Matrix<T, N, N, V> &m){
+        return MatrixImpl::Det<T, N>::run(m);
     }
 
-    template<>
-    double det<double, 1>(Matrix<double, 1, 1> m){
-        return m(0, 0);
+    template<typename T, typename V>
+    T det(const DynamicMatrix<T, V> &m){
+        assert(m.rows() == m.cols() && "determinant of non-square matrix");
+        switch(m.rows()){
+            case 0:  return static_cast<T>(1);
+            case 1:  return m(0, 0);
+            case 2:  return MatrixImpl::det2<T>(m);
+            case 3:  return MatrixImpl::det3<T>(m);
+            case 4:  return MatrixImpl::det4<T>(m);
+            default: return MatrixImpl::det_elimination<T>(m, std::is_integral<T>());
+        }
     }
 
-    template<typename T, int N>
-    T cofactor(Matrix<T, N, N> m, int i, int j){
+    template<typename T, size_t N>
+    T cofactor(Matrix<T, N, N> m, size_t i, size_t j){
         return std::pow(-1, i+j)*det(left(m, i, j));
     }
 
-    template<typename T, int N>
+    template<typename T, size_t N>
     Matrix<T, N, N> adj(const Matrix<T, N, N> &m){
         Matrix<T, N, N> res;
-        for(int i = 0; i != N; ++i)
-            for(int j = 0; j != N; ++j)
+        for(size_t i = 0; i != N; ++i)
+            for(size_t j = 0; j != N; ++j)
                 res(i, j) = cofactor(m, j, i);
         return res;
     }
 
-    template<typename T, int N>
-    Matrix<T, N, N> inv(Matrix<T, N, N> &m){
+    // zero matrix when m is singular
+    template<typename T, size_t N>
+    Matrix<T, N, N> inv(Matrix<T, N, N> m){
         Matrix<T, N, N> res;        
+        std::vector<size_t> perm(N);
 
-        if(m.is_invertible()){
-            if(m.is_diagonal()){
-                for(int i = 0; i < N; ++i)
-                    res(i, i) = 1/m(i, i);
-            }
-            else{
-                Matrix<T, N, 2*N> aug = col_cat<T, N, 2*N>(m, eye<T, N>());
-                aug = rref(aug);
-                res = col_split<T, N, N>(aug, N, 2*N-1);
-            }
+        if(m.is_diagonal()){
+            for(size_t i = 0; i < N; ++i)
+                if(!m(i, i)) return Matrix<T, N, N>();
+            for(size_t i = 0; i < N; ++i)
+                res(i, i) = 1/m(i, i);
+        }
+        else if(MatrixImpl::lu_factor(N, &m(0, 0), N, perm.data())){
+            res = eye<T, N>();
+            MatrixImpl::lu_solve(N, m.data().data(), N, perm.data(), &res(0, 0), N, N);
+        }
+        return res;
+    }
+
+    template<typename T>
+    DynamicMatrix<T> inv(DynamicMatrix<T> m){
+        assert(m.rows() == m.cols() && "inverse of non-square matrix");
+        size_t n = m.rows();
+        DynamicMatrix<T> res(n, n);
+        std::vector<size_t> perm(n);
+
+        if(!n) return res;
+        if(m.is_diagonal()){
+            for(size_t i = 0; i < n; ++i)
+                if(!m(i, i)) return DynamicMatrix<T>(n, n);
+            for(size_t i = 0; i < n; ++i)
+                res(i, i) = 1/m(i, i);
+        }
+        else if(MatrixImpl::lu_factor(n, &m(0, 0), n, perm.data())){
+            res = eye<T>(n);
+            MatrixImpl::lu_solve(n, m.data().data(), n, perm.data(), &res(0, 0), n, n);
         }
         return res;
     }
 
-    template<typename T, int M, int N>
-    Matrix<T, N, 1> least_square(const Matrix<T, M, N> &A, const Matrix<T, M, 1> &b){
-        Lee::Matrix<double, N, N> S = transpose(A)*A;
-        Lee::Matrix<double, N, 1> x = inv(S)*transpose(A)*b;
-        Lee::Matrix<double, M, 1> p = A*x;
-        Lee::Matrix<double, M, 1> e = b-p;
-        Lee::Matrix<double, M, M> P = A*inv(S)*transpose(A);
-
-        // cout << "A and b \n";
-        // cout << A << "\n";
-        // cout << b << "\n";
-        // cout << "solution to x: \n" << x << "\n";
-        // cout << "the error: \n" << e << "\n";
-        // cout << "the projection matrix:\n" << P << "\n";
-        // cout << "the transpose matrix:\n" << transpose(P) << "\n";
-        // cout << std::boolalpha << (P == transpose(P)) << (P*P == P) << (P(0, 0) == transpose(P)(0, 0));
+    // x minimizing |A*x-b| in O(M*N) memory, residual: |A*x-b| when given
+    // | QR: Householder QR of A, the residual comes free from Q^T*b
+    // | Cholesky: normal equations A^T*A*x = A^T*b, half the flops of QR but 
+    // |           squares the condition number; falls back to QR when A^T*A is not definite
+    template<typename T, size_t M, size_t N>
+    Matrix<T, N, 1> least_square(const Matrix<T, M, N> &A, const Matrix<T, M, 1> &b, 
+                                 LeastSquareMethod method = LeastSquareMethod::QR, T *residual = nullptr){
+        static_assert(M >= N, "least squares needs at least as many rows as columns");
+        Matrix<T, N, 1> x;
+        MatrixImpl::least_square(M, N, A.data().data(), b.data().data(), &x(0, 0), method, residual);
+        return x;
+    }
+
+    template<typename T>
+    DynamicMatrix<T> least_square(const DynamicMatrix<T> &A, const DynamicMatrix<T> &b, 
+                                  LeastSquareMethod method = LeastSquareMethod::QR, T *residual = nullptr){
+        assert(A.rows() == b.rows() && b.cols() == 1 && "dimensions do not match");
+        assert(A.rows() >= A.cols() && "least squares needs at least as many rows as columns");
+        DynamicMatrix<T> x(A.cols(), 1);
+        if(A.cols()) MatrixImpl::least_square(A.rows(), A.cols(), A.data().data(), b.data().data(), &x(0, 0), method, residual);
         return x;
     }
 
-    template<typename T, int N>
-    T norm2(const Matrix<T, N, 1> &m){
+    template<typename T, size_t N, typename V>
+    T norm2(const Matrix<T, N, 1, V> &m){
+        return sqrt((transpose(m)*m)(0, 0));
+    }
+
+    template<typename T, typename V>
+    T norm2(const DynamicMatrix<T, V> &m){
         return sqrt((transpose(m)*m)(0, 0));
     }
 }
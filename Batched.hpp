@@ -0,0 +1,295 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include "Matrix.hpp"
+#include "Simd.hpp"
+#include "Parallel.hpp"
+#include "LU.hpp"
+#include "Cholesky.hpp"
+
+/*
+** Batches of small independent systems
+** | BatchMatrix<T, M, N>(count)          count matrices M x N, interleaved: element (i, j)
+** |                                      of system s is data()[(i*N+j)*stride()+s]
+** | batch_solve_lu(A, b)                 x_s = A_s^-1 * b_s, partial pivoting per system
+** | batch_solve_cholesky(A, b)           the same for symmetric positive definite A_s
+** SIMD
+** | one packet holds the same element of neighbouring systems, so a whole
+** | packet of systems is factored and solved at once; pivot choices differ
+** | per lane and are applied with lane-wise selects. AVX-512, AVX2 or SSE2 as
+** | in Simd.hpp; blocks of packets are split over threads (Parallel.hpp).
+*/
+
+namespace Lee{
+
+    template<typename T, size_t M, size_t N>
+    class BatchMatrix{
+    public:
+        using value_type = T;
+
+        // lanes are padded to a whole number of the widest packet
+        static const size_t LANES = 64/sizeof(T) ? 64/sizeof(T) : 1;
+
+        explicit BatchMatrix(size_t count)
+            : elems(M*N*((count+LANES-1)/LANES*LANES)), cnt{count}, strd{(count+LANES-1)/LANES*LANES} {}
+
+        size_t count() const { return cnt; }
+
+        size_t stride() const { return strd; }
+
+        static constexpr size_t rows() { return M; }
+
+        static constexpr size_t cols() { return N; }
+
+        T& operator()(size_t s, size_t i, size_t j){
+            assert(s < cnt && i < M && j < N && "batch index out of range");
+            return elems[(i*N+j)*strd+s];
+        }
+
+        const T& operator()(size_t s, size_t i, size_t j) const{
+            assert(s < cnt && i < M && j < N && "batch index out of range");
+            return elems[(i*N+j)*strd+s];
+        }
+
+        template<typename V>
+        void set(size_t s, const Matrix<T, M, N, V> &m){
+            for(size_t i = 0; i < M; ++i)
+                for(size_t j = 0; j < N; ++j)
+                    (*this)(s, i, j) = m(i, j);
+        }
+
+        Matrix<T, M, N> get(size_t s) const{
+            Matrix<T, M, N> res;
+            for(size_t i = 0; i < M; ++i)
+                for(size_t j = 0; j < N; ++j)
+                    res(i, j) = (*this)(s, i, j);
+            return res;
+        }
+
+        T* data() { return elems.data(); }
+
+        const T* data() const { return elems.data(); }
+
+    private:
+        std::vector<T> elems;
+        size_t cnt;
+        size_t strd;
+    };
+
+}   // Lee
+
+namespace MatrixImpl{
+
+#if defined(__GNUC__)
+    template<typename P, typename T>
+    inline void packet_sqrt(P &res, const P &a){
+        for(size_t l = 0; l < sizeof(P)/sizeof(T); ++l)
+            res[l] = std::sqrt(a[l]);
+    }
+
+    // res = mask ? a : b lane by lane, mask lanes all ones or all zeros
+    template<typename P, typename I>
+    inline void packet_select(P &res, const I &mask, const P &a, const P &b){
+        I ai, bi;
+        std::memcpy(&ai, &a, sizeof(P));
+        std::memcpy(&bi, &b, sizeof(P));
+        ai = (ai & mask) | (bi & ~mask);
+        std::memcpy(&res, &ai, sizeof(P));
+    }
+
+    // lanes [s, s+W) of the batch: Gaussian elimination on [A | B] with partial pivoting, then back substitution
+    template<typename P, typename T, size_t N, size_t K>
+    inline void batch_lu_packet(const T *a, const T *b, T *x, size_t stride, size_t s){
+        P A[N][N], B[N][K], zero;
+        packet_broadcast(zero, static_cast<T>(0));
+        for(size_t i = 0; i < N; ++i){
+            for(size_t j = 0; j < N; ++j)
+                std::memcpy(&A[i][j], a+(i*N+j)*stride+s, sizeof(P));
+            for(size_t j = 0; j < K; ++j)
+                std::memcpy(&B[i][j], b+(i*K+j)*stride+s, sizeof(P));
+        }
+
+        // the pivot choice is kept as one lane mask per candidate row, in an integer packet of the
+        // same width; swaps are bitwise blends on those masks (no compares of the masks themselves)
+        typedef decltype(zero < zero) I;
+
+        for(size_t k = 0; k < N; ++k){
+            P big = A[k][k] < zero ? -A[k][k] : A[k][k];
+            I sel[N];
+            for(size_t r = k+1; r < N; ++r){
+                P mag = A[r][k] < zero ? -A[r][k] : A[r][k];
+                const I gt = mag > big;
+                packet_select(big, gt, mag, big);
+                for(size_t q = k+1; q < r; ++q)
+                    sel[q] &= ~gt;
+                sel[r] = gt;
+            }
+            for(size_t r = k+1; r < N; ++r){
+                const I sw = sel[r];
+                for(size_t j = k; j < N; ++j){
+                    P t = A[k][j];
+                    packet_select(A[k][j], sw, A[r][j], t);
+                    packet_select(A[r][j], sw, t, A[r][j]);
+                }
+                for(size_t j = 0; j < K; ++j){
+                    P t = B[k][j];
+                    packet_select(B[k][j], sw, B[r][j], t);
+                    packet_select(B[r][j], sw, t, B[r][j]);
+                }
+            }
+
+            for(size_t r = k+1; r < N; ++r){
+                P l = A[r][k]/A[k][k];
+                for(size_t j = k+1; j < N; ++j)
+                    A[r][j] -= l*A[k][j];
+                for(size_t j = 0; j < K; ++j)
+                    B[r][j] -= l*B[k][j];
+            }
+        }
+
+        for(size_t i = N; i-- > 0; ){
+            for(size_t p = i+1; p < N; ++p)
+                for(size_t j = 0; j < K; ++j)
+                    B[i][j] -= A[i][p]*B[p][j];
+            for(size_t j = 0; j < K; ++j)
+                B[i][j] /= A[i][i];
+        }
+
+        for(size_t i = 0; i < N; ++i)
+            for(size_t j = 0; j < K; ++j)
+                std::memcpy(x+(i*K+j)*stride+s, &B[i][j], sizeof(P));
+    }
+
+    // lanes [s, s+W): A = L*L^T, then L*Y = B and L^T*X = Y
+    template<typename P, typename T, size_t N, size_t K>
+    inline void batch_cholesky_packet(const T *a, const T *b, T *x, size_t stride, size_t s){
+        P L[N][N], B[N][K];
+        for(size_t i = 0; i < N; ++i){
+            for(size_t j = 0; j <= i; ++j)
+                std::memcpy(&L[i][j], a+(i*N+j)*stride+s, sizeof(P));
+            for(size_t j = 0; j < K; ++j)
+                std::memcpy(&B[i][j], b+(i*K+j)*stride+s, sizeof(P));
+        }
+
+        for(size_t i = 0; i < N; ++i)
+            for(size_t j = 0; j <= i; ++j){
+                P t = L[i][j];
+                for(size_t p = 0; p < j; ++p)
+                    t -= L[i][p]*L[j][p];
+                if(i == j) packet_sqrt<P, T>(L[i][i], t);
+                else L[i][j] = t/L[j][j];
+            }
+
+        for(size_t i = 0; i < N; ++i){
+            for(size_t p = 0; p < i; ++p)
+                for(size_t j = 0; j < K; ++j)
+                    B[i][j] -= L[i][p]*B[p][j];
+            for(size_t j = 0; j < K; ++j)
+                B[i][j] /= L[i][i];
+        }
+        for(size_t i = N; i-- > 0; ){
+            for(size_t p = i+1; p < N; ++p)
+                for(size_t j = 0; j < K; ++j)
+                    B[i][j] -= L[p][i]*B[p][j];
+            for(size_t j = 0; j < K; ++j)
+                B[i][j] /= L[i][i];
+        }
+
+        for(size_t i = 0; i < N; ++i)
+            for(size_t j = 0; j < K; ++j)
+                std::memcpy(x+(i*K+j)*stride+s, &B[i][j], sizeof(P));
+    }
+
+    // Op: 0 LU, 1 Cholesky; lanes [first, last), a multiple of the packet width
+    template<int Op, typename T, size_t N, size_t K, size_t B>
+    inline void batch_solve_n(const T *a, const T *b, T *x, size_t stride, size_t first, size_t last){
+        typedef typename PacketType<T, B>::type P;
+        for(size_t s = first; s < last; s += B/sizeof(T)){
+            if(Op == 0) batch_lu_packet<P, T, N, K>(a, b, x, stride, s);
+            else batch_cholesky_packet<P, T, N, K>(a, b, x, stride, s);
+        }
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    template<int Op, typename T, size_t N, size_t K>
+    __attribute__((target("avx512f"), flatten))
+    void batch_solve_avx512(const T *a, const T *b, T *x, size_t stride, size_t first, size_t last){
+        batch_solve_n<Op, T, N, K, 64>(a, b, x, stride, first, last);
+    }
+
+    template<int Op, typename T, size_t N, size_t K>
+    __attribute__((target("avx2"), flatten))
+    void batch_solve_avx2(const T *a, const T *b, T *x, size_t stride, size_t first, size_t last){
+        batch_solve_n<Op, T, N, K, 32>(a, b, x, stride, first, last);
+    }
+#endif
+
+    template<int Op, typename T, size_t N, size_t K>
+    __attribute__((flatten))
+    void batch_solve_base(const T *a, const T *b, T *x, size_t stride, size_t first, size_t last){
+        batch_solve_n<Op, T, N, K, 16>(a, b, x, stride, first, last);
+    }
+
+    template<int Op, typename T, size_t N, size_t K>
+    void batch_solve(const T *a, const T *b, T *x, size_t stride, size_t first, size_t last){
+#if defined(__x86_64__) || defined(__i386__)
+        switch(simd_level()){
+            case 2:  batch_solve_avx512<Op, T, N, K>(a, b, x, stride, first, last); return;
+            case 1:  batch_solve_avx2<Op, T, N, K>(a, b, x, stride, first, last); return;
+            default: break;
+        }
+#endif
+        batch_solve_base<Op, T, N, K>(a, b, x, stride, first, last);
+    }
+
+#else
+    // one system at a time through the dense factorizations
+    template<int Op, typename T, size_t N, size_t K>
+    void batch_solve(const T *a, const T *b, T *x, size_t stride, size_t first, size_t last){
+        std::vector<T> m(N*N), y(N*K);
+        std::vector<size_t> perm(N);
+        for(size_t s = first; s < last; ++s){
+            for(size_t e = 0; e < N*N; ++e) m[e] = a[e*stride+s];
+            for(size_t e = 0; e < N*K; ++e) y[e] = b[e*stride+s];
+            if(Op == 0) { lu_factor(N, m.data(), N, perm.data()); lu_solve(N, m.data(), N, perm.data(), y.data(), K, K); }
+            else { chol_factor(N, m.data(), N); chol_solve(N, m.data(), N, y.data(), K, K); }
+            for(size_t e = 0; e < N*K; ++e) x[e*stride+s] = y[e];
+        }
+    }
+#endif
+
+    template<int Op, typename T, size_t N, size_t K>
+    Lee::BatchMatrix<T, N, K> batch_solve(const Lee::BatchMatrix<T, N, N> &A, const Lee::BatchMatrix<T, N, K> &b){
+        static_assert(!std::is_integral<T>::value, "batched solves need a floating-point type");
+        assert(A.count() == b.count() && "batch sizes do not match");
+        Lee::BatchMatrix<T, N, K> x(A.count());
+
+        // blocks of the widest packet, so every kernel sees whole packets
+        const size_t L = Lee::BatchMatrix<T, N, N>::LANES;
+        const T *pa = A.data(), *pb = b.data();
+        T *px = x.data();
+        const size_t stride = A.stride();
+        parallel_rows(stride/L, A.count()*N*N*N, [=](size_t r0, size_t r1){
+            batch_solve<Op, T, N, K>(pa, pb, px, stride, r0*L, r1*L);
+        });
+        return x;
+    }
+
+}   // MatrixImpl
+
+namespace Lee{
+
+    template<typename T, size_t N, size_t K>
+    BatchMatrix<T, N, K> batch_solve_lu(const BatchMatrix<T, N, N> &A, const BatchMatrix<T, N, K> &b){
+        return MatrixImpl::batch_solve<0>(A, b);
+    }
+
+    template<typename T, size_t N, size_t K>
+    BatchMatrix<T, N, K> batch_solve_cholesky(const BatchMatrix<T, N, N> &A, const BatchMatrix<T, N, K> &b){
+        return MatrixImpl::batch_solve<1>(A, b);
+    }
+
+}   // Lee
@@ -0,0 +1,58 @@
+#include <iostream>
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+#include "Batched.hpp"
+
+namespace{
+
+    // max |A_s*x_s-b_s| over a batch of diagonally weak systems that need pivoting
+    template<typename T, size_t N>
+    T batch_lu_residual(size_t count){
+        Lee::BatchMatrix<T, N, N> A(count);
+        Lee::BatchMatrix<T, N, 1> b(count);
+        unsigned seed = 7;
+        for(size_t s = 0; s < count; ++s)
+            for(size_t i = 0; i < N; ++i){
+                for(size_t j = 0; j < N; ++j){
+                    seed = seed*1103515245u+12345u;
+                    A(s, i, j) = static_cast<T>((seed >> 8)%1000)/500-1;
+                }
+                A(s, i, i) *= static_cast<T>(0.01);
+                b(s, i, 0) = static_cast<T>(i+1);
+            }
+
+        Lee::BatchMatrix<T, N, 1> x = Lee::batch_solve_lu(A, b);
+        T res = 0, scale = 0;
+        for(size_t s = 0; s < count; ++s)
+            for(size_t i = 0; i < N; ++i){
+                T r = -b(s, i, 0), sx = 0;
+                for(size_t j = 0; j < N; ++j){
+                    r += A(s, i, j)*x(s, j, 0);
+                    sx += std::abs(A(s, i, j)*x(s, j, 0));
+                }
+                res = std::max(res, std::abs(r));
+                scale = std::max(scale, sx);
+            }
+        return res/scale;
+    }
+
+    template<typename T>
+    void batch_lu_sizes(T tol){
+        assert((batch_lu_residual<T, 1>(37) < tol) && "batched LU N = 1");
+        assert((batch_lu_residual<T, 2>(37) < tol) && "batched LU N = 2");
+        assert((batch_lu_residual<T, 3>(37) < tol) && "batched LU N = 3");
+        assert((batch_lu_residual<T, 4>(37) < tol) && "batched LU N = 4");
+        assert((batch_lu_residual<T, 5>(37) < tol) && "batched LU N = 5");
+        assert((batch_lu_residual<T, 8>(37) < tol) && "batched LU N = 8");
+        assert((batch_lu_residual<T, 16>(37) < tol) && "batched LU N = 16");
+    }
+
+}
+
+void Batched_Test(){
+    std::cout << "\nBatched Test:\n";
+    batch_lu_sizes<double>(1e-12);
+    batch_lu_sizes<float>(1e-4f);
+    std::cout << "batched LU, N = 1..16, float and double: ok\n";
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+#include "Gemm.hpp"
+
+/*
+** Cholesky factorization A = L*L^T of a symmetric positive definite matrix
+** | chol_factor(n, a, lda)                 lower triangle of a = L, upper triangle untouched;
+** |                                        false when A is not positive definite
+** | chol_solve(n, a, lda, b, nrhs, ldb)    b (n x nrhs) = A^-1 * b
+** only the lower triangle of A is read; all matrices row-major
+** blocking
+** | n >= LEE_CHOL_BLOCKED: right-looking, LEE_CHOL_BLOCK columns per step;
+** | the rows of the panel L21 = A21*L11^-T and of the trailing update
+** | A22 -= L21*L21^T (lower triangle only, GEMM off the diagonal) are
+** | split over threads (Parallel.hpp)
+*/
+
+#ifndef LEE_CHOL_BLOCK
+#define LEE_CHOL_BLOCK 64
+#endif
+
+#ifndef LEE_CHOL_BLOCKED
+#define LEE_CHOL_BLOCKED 128
+#endif
+
+namespace MatrixImpl{
+
+    template<typename T>
+    bool chol_factor_unblocked(size_t n, T *a, size_t lda){
+        for(size_t i = 0; i < n; ++i){
+            T *li = a+i*lda;
+            for(size_t j = 0; j <= i; ++j){
+                const T *lj = a+j*lda;
+                T s = li[j];
+                for(size_t p = 0; p < j; ++p)
+                    s -= li[p]*lj[p];
+
+                if(i != j) li[j] = s/lj[j];
+                else if(s > static_cast<T>(0)) li[i] = std::sqrt(s);
+                else return false;
+            }
+        }
+        return true;
+    }
+
+    template<typename T>
+    bool chol_factor(size_t n, T *a, size_t lda){
+        if(n < LEE_CHOL_BLOCKED) return chol_factor_unblocked(n, a, lda);
+
+        const size_t NB = LEE_CHOL_BLOCK;
+        for(size_t k0 = 0; k0 < n; k0 += NB){
+            const size_t k1 = std::min(n, k0+NB), nb = k1-k0;
+            if(!chol_factor_unblocked(nb, a+k0*lda+k0, lda)) return false;
+            if(k1 == n) break;
+
+            // L21 = A21*L11^-T, row by row
+            parallel_rows(n-k1, (n-k1)*nb*nb, [=](size_t r0, size_t r1){
+                for(size_t i = k1+r0; i < k1+r1; ++i){
+                    T *li = a+i*lda;
+                    for(size_t j = k0; j < k1; ++j){
+                        const T *lj = a+j*lda;
+                        T s = li[j];
+                        for(size_t p = k0; p < j; ++p)
+                            s -= li[p]*lj[p];
+                        li[j] = s/lj[j];
+                    }
+                }
+            });
+
+            // A22 -= L21*L21^T on the lower triangle, in row blocks of NB
+            parallel_rows(n-k1, (n-k1)*(n-k1)*nb/2, [=](size_t r0, size_t r1){
+                for(size_t rb = k1+r0; rb < k1+r1; rb += NB){
+                    const size_t re = std::min(k1+r1, rb+NB);
+                    if(rb > k1)
+                        gemm(re-rb, rb-k1, nb, static_cast<T>(-1), a+rb*lda+k0, lda, static_cast<size_t>(1),
+                             a+k1*lda+k0, static_cast<size_t>(1), lda, static_cast<T>(1), a+rb*lda+k1, lda);
+                    for(size_t i = rb; i < re; ++i)
+                        for(size_t j = rb; j <= i; ++j){
+                            T s = static_cast<T>(0);
+                            for(size_t p = k0; p < k1; ++p)
+                                s += a[i*lda+p]*a[j*lda+p];
+                            a[i*lda+j] -= s;
+                        }
+                }
+            });
+        }
+        return true;
+    }
+
+    template<typename T>
+    void chol_solve(size_t n, const T *a, size_t lda, T *b, size_t nrhs, size_t ldb){
+        // L y = b
+        for(size_t i = 0; i < n; ++i){
+            T *bi = b+i*ldb;
+            for(size_t p = 0; p < i; ++p){
+                const T l = a[i*lda+p];
+                const T *bp = b+p*ldb;
+                for(size_t j = 0; j < nrhs; ++j)
+                    bi[j] -= l*bp[j];
+            }
+            for(size_t j = 0; j < nrhs; ++j)
+                bi[j] /= a[i*lda+i];
+        }
+
+        // L^T x = y, a column of L^T is a row of L
+        for(size_t i = n; i-- > 0; ){
+            T *bi = b+i*ldb;
+            for(size_t j = 0; j < nrhs; ++j)
+                bi[j] /= a[i*lda+i];
+            for(size_t p = 0; p < i; ++p){
+                const T l = a[i*lda+p];
+                T *bp = b+p*ldb;
+                for(size_t j = 0; j < nrhs; ++j)
+                    bp[j] -= l*bi[j];
+            }
+        }
+    }
+
+}   // MatrixImpl
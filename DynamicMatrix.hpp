@@ -0,0 +1,577 @@
+#pragma once
+
+#include "Matrix.hpp"
+
+/*
+** Runtime-sized matrix sharing the expression proxies of Matrix
+** classes
+** | DynamicMatrix<T>
+** initialize
+** | DynamicMatrix a(m, n)
+** | DynamicMatrix a(m, n, elem)
+** | DynamicMatrix a{{...}, {...}}
+** | DynamicMatrix a(b)               b: DynamicMatrix expression or Matrix
+** visit
+** | a(i, j)
+** | a.row(i)
+** | a.col(i)
+*/
+
+namespace Lee{
+
+    template<typename T>
+    class sliceDynamicMatrix;
+
+    template<typename T, typename V = std::vector<T>>
+    class DynamicMatrix{
+    public:
+        using value_type     = T;
+        using iterator       = typename V::iterator;
+        using const_iterator = typename V::const_iterator;
+
+        // Constructors
+        DynamicMatrix() : nrows{0}, ncols{0} {}
+
+        explicit DynamicMatrix(size_t m, size_t n) : nrows{m}, ncols{n} {
+            elems.resize(m*n);
+            std::fill(elems.begin(), elems.end(), static_cast<T>(0));
+        }
+
+        explicit DynamicMatrix(size_t m, size_t n, T elem) : nrows{m}, ncols{n} {
+            elems.resize(m*n);
+            std::fill(elems.begin(), elems.end(), elem);
+        }
+
+        DynamicMatrix(NestedInitializerListN<T, 2> il) : nrows{il.size()}, ncols{0} {
+            for(auto i : il) ncols = std::max(ncols, i.size());
+
+            elems.resize(nrows*ncols);
+            std::fill(elems.begin(), elems.end(), static_cast<T>(0));
+            auto row = elems.begin();
+            for(auto i : il){
+                std::copy(i.begin(), i.end(), row);
+                row += ncols;
+            }
+        }
+
+        // for several kinds of expression proxies
+        DynamicMatrix(size_t m, size_t n, const V &vec) : elems{vec}, nrows{m}, ncols{n} {}
+
+        template<typename V1>
+        DynamicMatrix(const DynamicMatrix<T, V1> &rhs) : nrows{rhs.rows()}, ncols{rhs.cols()} {
+            MatrixImpl::matrix_valid(rhs);
+
+            elems.resize(size());
+            MatrixImpl::Evaluator<V1>::run(*this, rhs);
+        }
+
+        template<size_t M, size_t N, typename V1>
+        DynamicMatrix(const Matrix<T, M, N, V1> &rhs) : nrows{M}, ncols{N} {
+            MatrixImpl::matrix_valid(rhs);
+
+            elems.resize(size());
+            for(size_t i = 0; i < nrows; ++i)
+                for(size_t j = 0; j < ncols; ++j)
+                    (*this)(i, j) = rhs(i, j);
+        }
+
+        DynamicMatrix(const sliceDynamicMatrix<T> &rhs) : nrows{rhs.rows()}, ncols{rhs.cols()} {
+            elems.resize(size());
+            for(size_t i = 0; i < nrows; ++i)
+                for(size_t j = 0; j < ncols; ++j)
+                    (*this)(i, j) = rhs(i, j);
+        }
+
+        DynamicMatrix(const DynamicMatrix &rhs) = default;
+
+        DynamicMatrix(DynamicMatrix &&rhs) = default;
+
+        ~DynamicMatrix() = default;
+
+        // assignments
+        DynamicMatrix& operator=(const DynamicMatrix &rhs) = default;
+
+        DynamicMatrix& operator=(DynamicMatrix &&rhs) = default;
+
+        template<typename V1>
+        DynamicMatrix& operator=(const DynamicMatrix<T, V1> &rhs){
+            MatrixImpl::matrix_valid(rhs);
+
+            // rhs may read *this (a = a*b): a new shape is evaluated aside and moved in
+            if(rhs.rows() != nrows || rhs.cols() != ncols)
+                return *this = DynamicMatrix(rhs);
+            MatrixImpl::Evaluator<V1>::run(*this, rhs);
+            return *this;
+        }
+
+        DynamicMatrix& operator=(const sliceDynamicMatrix<T> &rhs){
+            resize(rhs.rows(), rhs.cols());
+            for(size_t i = 0; i < nrows; ++i)
+                for(size_t j = 0; j < ncols; ++j)
+                    (*this)(i, j) = rhs(i, j);
+            return *this;
+        }
+
+        // member functions
+        size_t rows() const { return nrows; }
+
+        size_t cols() const { return ncols; }
+
+        size_t size() const { return nrows*ncols; }
+
+        // contents are unspecified after a change of shape
+        void resize(size_t m, size_t n){
+            nrows = m;
+            ncols = n;
+            elems.resize(m*n);
+        }
+
+        template<typename F>
+        DynamicMatrix<T, applyProxy<T, V, F>> apply(F f) const{
+            return DynamicMatrix<T, applyProxy<T, V, F>>(nrows, ncols, applyProxy<T, V, F>(elems, f));
+        }
+
+        // element access
+        template<typename Q = V>
+        typename std::enable_if<MatrixImpl::IsParenType<Q>::value, T>::type
+        operator()(size_t i, size_t j){
+            MatrixImpl::index_bounds_check(*this, i, j);
+
+            return elems(i, j);
+        }
+
+        template<typename Q = V>
+        typename std::enable_if<!MatrixImpl::IsParenType<Q>::value, T&>::type
+        operator()(size_t i, size_t j){
+            MatrixImpl::index_bounds_check(*this, i, j);
+
+            return elems[i*ncols+j];
+        }
+
+        template<typename Q = V>
+        typename std::enable_if<MatrixImpl::IsParenType<Q>::value, T>::type
+        operator()(size_t i, size_t j) const{
+            MatrixImpl::index_bounds_check(*this, i, j);
+
+            return elems(i, j);
+        }
+
+        template<typename Q = V>
+        typename std::enable_if<!MatrixImpl::IsParenType<Q>::value, T>::type
+        operator()(size_t i, size_t j) const{
+            MatrixImpl::index_bounds_check(*this, i, j);
+
+            return elems[i*ncols+j];
+        }
+
+        V& data() { return elems; }
+
+        const V& data() const { return elems; }
+
+        iterator begin() { return elems.begin(); }
+
+        const_iterator begin() const { return elems.begin(); }
+
+        iterator end() { return elems.end(); }
+
+        const_iterator end() const { return elems.end(); }
+
+        // submatrix access
+        sliceDynamicMatrix<T> operator()(slice r, slice c){
+            return sliceDynamicMatrix<T>(*this, r, c);
+        }
+
+        sliceDynamicMatrix<T> row(size_t i){
+            MatrixImpl::index_bounds_check(*this, i, 0);
+
+            return sliceDynamicMatrix<T>(*this, slice(i, i, ncols), slice(0, ncols-1, 1));
+        }
+
+        sliceDynamicMatrix<T> col(size_t i){
+            MatrixImpl::index_bounds_check(*this, 0, i);
+
+            return sliceDynamicMatrix<T>(*this, slice(0, nrows-1, ncols), slice(i, i, 1));
+        }
+
+        // unary operations
+        DynamicMatrix<T, applyProxy<T, V, std::negate<T>>> operator-() const{
+            return apply(std::negate<T>());
+        }
+
+        // binary operations
+        template<typename V1>
+        DynamicMatrix<T, binaryProxy<T, V, V1, std::plus<T>>> operator+(const DynamicMatrix<T, V1> &rhs) const{
+            assert(nrows == rhs.rows() && ncols == rhs.cols() && "dimensions do not match");
+
+            return DynamicMatrix<T, binaryProxy<T, V, V1, std::plus<T>>>
+                (nrows, ncols, binaryProxy<T, V, V1, std::plus<T>>(elems, rhs.data(), std::plus<T>()));
+        }
+
+        template<typename V1>
+        DynamicMatrix<T, binaryProxy<T, V, V1, std::minus<T>>> operator-(const DynamicMatrix<T, V1> &rhs) const{
+            assert(nrows == rhs.rows() && ncols == rhs.cols() && "dimensions do not match");
+
+            return DynamicMatrix<T, binaryProxy<T, V, V1, std::minus<T>>>
+                (nrows, ncols, binaryProxy<T, V, V1, std::minus<T>>(elems, rhs.data(), std::minus<T>()));
+        }
+
+        // arithmetic operations
+        DynamicMatrix& operator+=(const DynamicMatrix &m){
+            assert(nrows == m.rows() && ncols == m.cols() && "dimensions do not match");
+
+            for(size_t i = 0; i < size(); ++i)
+                elems[i] += m.elems[i];
+            return *this;
+        }
+
+        DynamicMatrix& operator-=(const DynamicMatrix &m){
+            assert(nrows == m.rows() && ncols == m.cols() && "dimensions do not match");
+
+            for(size_t i = 0; i < size(); ++i)
+                elems[i] -= m.elems[i];
+            return *this;
+        }
+
+        DynamicMatrix& operator*=(double r){
+            for(size_t i = 0; i < size(); ++i)
+                elems[i] *= r;
+            return *this;
+        }
+
+        DynamicMatrix& operator/=(double r){
+            return (*this) *= 1/r;
+        }
+
+        void to_eye(){
+            for(size_t i = 0; i < nrows; ++i)
+                for(size_t j = 0; j < ncols; ++j)
+                    (*this)(i, j) = (i == j) ? 1 : 0;
+        }
+
+        void to_one(){
+            std::fill(elems.begin(), elems.end(), static_cast<T>(1));
+        }
+
+        void to_zero(){
+            std::fill(elems.begin(), elems.end(), static_cast<T>(0));
+        }
+
+        void permute(size_t r1, size_t r2){
+            if(r1 >= nrows || r2 >= nrows) throw std::out_of_range("Matrix index");
+            for(size_t j = 0; j != ncols; ++j)
+                std::swap((*this)(r1, j), (*this)(r2, j));
+        }
+
+        bool is_diagonal() const{
+            if(nrows != ncols) return false;
+            for(size_t i = 0; i < nrows; ++i)
+                for(size_t j = 0; j < ncols; ++j)
+                    if(i!=j && (*this)(i, j)) return false;
+            return true;
+        }
+
+    private:
+        V elems;
+        size_t nrows;
+        size_t ncols;
+    };
+
+    // matrix format ouput
+    template<typename T, typename V>
+    std::ostream& operator<<(std::ostream &os, const DynamicMatrix<T, V> &m){
+        for(size_t i = 0; i < m.rows(); ++i){
+            for(size_t j = 0; j < m.cols(); ++j){
+                os.width(8);
+                os.precision(3);
+                os << std::fixed << m(i, j) << " ";
+            }
+            os << '\n';
+        }
+        os << '\n';
+        return os;
+    }
+
+    template<typename T, typename V>
+    class dynamicTransProxy{
+    public:
+        using value_type     = T;
+        using iterator       = Iterator<T, dynamicTransProxy>;
+        using const_iterator = ConstIterator<T, dynamicTransProxy>;
+
+        // m: rows of the transposed result
+        dynamicTransProxy(const V &v, size_t m) : vec{v}, nrows{m} {}
+
+        size_t size() const {
+            return vec.size();
+        }
+
+        T operator()(size_t i, size_t j) const{
+            return vec[j*nrows+i];
+        }
+
+        T operator[](size_t i) const{
+            size_t n = size()/nrows;
+            return vec[(i%n)*nrows+i/n];
+        }
+
+        const V& left() const { return vec; }
+
+        const_iterator begin() const{
+            return const_iterator(*this, 0);
+        }
+
+        const_iterator end() const{
+            return const_iterator(*this, size());
+        }
+
+    private:
+        const V &vec;
+        size_t  nrows;
+    };
+
+    template<typename T, typename V1, typename V2>
+    class dynamicMultiProxy{
+    public:
+        using value_type     = T;
+        using iterator       = Iterator<T, dynamicMultiProxy>;
+        using const_iterator = ConstIterator<T, dynamicMultiProxy>;
+
+        // (m x n) * (n x n1)
+        dynamicMultiProxy(const V1 &left, const V2 &right, size_t m, size_t n, size_t n1)
+            : lhs{left}, rhs{right}, nrows{m}, ninner{n}, ncols{n1} {}
+
+        size_t size() const { return nrows*ncols; }
+
+        template<typename Q = V1>
+        typename std::enable_if<MatrixImpl::IsParenType<Q>::value, T>::type
+        operator()(size_t r, size_t c) const{
+            T res = static_cast<T>(0);
+
+            for(size_t i = 0; i < ninner; ++i)
+                res += lhs(r, i)*rhs[i*ncols+c];
+
+            return res;
+        }
+
+        template<typename Q = V1>
+        typename std::enable_if<!MatrixImpl::IsParenType<Q>::value, T>::type
+        operator()(size_t r, size_t c) const{
+            T res = static_cast<T>(0);
+
+            for(size_t i = 0; i < ninner; ++i)
+                res += lhs[r*ninner+i]*rhs[i*ncols+c];
+
+            return res;
+        }
+
+        T operator[](size_t i) const{
+            return (*this)(i/ncols, i%ncols);
+        }
+
+        size_t rows() const { return nrows; }
+
+        size_t inner() const { return ninner; }
+
+        size_t cols() const { return ncols; }
+
+        const V1& left() const { return lhs; }
+
+        const V2& right() const { return rhs; }
+
+        const_iterator begin() const{
+            return const_iterator(*this, 0);
+        }
+
+        const_iterator end() const{
+            return const_iterator(*this, size());
+        }
+
+    private:
+        typename MatrixImpl::OperandHold<V1>::type lhs;
+        typename MatrixImpl::OperandHold<V2>::type rhs;
+        size_t   nrows;
+        size_t   ninner;
+        size_t   ncols;
+    };
+
+    /* unary operations */
+    // abs
+    template<typename T, typename V>
+    DynamicMatrix<T, applyProxy<T, V, MatrixImpl::abs<T>>>
+    abs(const DynamicMatrix<T, V> &m){
+        return m.apply(MatrixImpl::abs<T>());
+    }
+
+    // transpose
+    template<typename T, typename V>
+    DynamicMatrix<T, dynamicTransProxy<T, V>>
+    transpose(const DynamicMatrix<T, V> &m){
+        return DynamicMatrix<T, dynamicTransProxy<T, V>>(m.cols(), m.rows(), dynamicTransProxy<T, V>(m.data(), m.cols()));
+    }
+
+    /* binary operations */
+    // arithmetric add: matrix + scalar
+    template<typename T, typename V>
+    DynamicMatrix<T, binaryProxyRScalar<T, V, std::plus<T>>>
+    operator+(const DynamicMatrix<T, V> &lhs, const T &elem){
+        return DynamicMatrix<T, binaryProxyRScalar<T, V, std::plus<T>>>
+            (lhs.rows(), lhs.cols(), binaryProxyRScalar<T, V, std::plus<T>>(lhs.data(), Scalar<T>{elem}, std::plus<T>()));
+    }
+
+    // arithmetric add: scalar + matrix
+    template<typename T, typename V>
+    DynamicMatrix<T, binaryProxyLScalar<T, V, std::plus<T>>>
+    operator+(const T &elem, const DynamicMatrix<T, V> &rhs){
+        return DynamicMatrix<T, binaryProxyLScalar<T, V, std::plus<T>>>
+            (rhs.rows(), rhs.cols(), binaryProxyLScalar<T, V, std::plus<T>>(Scalar<T>{elem}, rhs.data(), std::plus<T>()));
+    }
+
+    // arithmetric subtract: matrix - scalar
+    template<typename T, typename V>
+    DynamicMatrix<T, binaryProxyRScalar<T, V, std::minus<T>>>
+    operator-(const DynamicMatrix<T, V> &lhs, const T &elem){
+        return DynamicMatrix<T, binaryProxyRScalar<T, V, std::minus<T>>>
+            (lhs.rows(), lhs.cols(), binaryProxyRScalar<T, V, std::minus<T>>(lhs.data(), Scalar<T>{elem}, std::minus<T>()));
+    }
+
+    // arithmetric multiply: scalar * matrix
+    template<typename T, typename V>
+    DynamicMatrix<T, binaryProxyLScalar<T, V, std::multiplies<T>>>
+    operator*(const T &elem, const DynamicMatrix<T, V> &rhs){
+        return DynamicMatrix<T, binaryProxyLScalar<T, V, std::multiplies<T>>>
+            (rhs.rows(), rhs.cols(), binaryProxyLScalar<T, V, std::multiplies<T>>(Scalar<T>{elem}, rhs.data(), std::multiplies<T>()));
+    }
+
+    // arithmetric multiply: matrix * scalar
+    template<typename T, typename V>
+    DynamicMatrix<T, binaryProxyRScalar<T, V, std::multiplies<T>>>
+    operator*(const DynamicMatrix<T, V> &lhs, const T &elem){
+        return DynamicMatrix<T, binaryProxyRScalar<T, V, std::multiplies<T>>>
+            (lhs.rows(), lhs.cols(), binaryProxyRScalar<T, V, std::multiplies<T>>(lhs.data(), Scalar<T>{elem}, std::multiplies<T>()));
+    }
+
+    // arithmetric divide: matrix / scalar
+    template<typename T, typename V>
+    DynamicMatrix<T, binaryProxyRScalar<T, V, std::divides<T>>>
+    operator/(const DynamicMatrix<T, V> &lhs, const T &elem){
+        return DynamicMatrix<T, binaryProxyRScalar<T, V, std::divides<T>>>
+            (lhs.rows(), lhs.cols(), binaryProxyRScalar<T, V, std::divides<T>>(lhs.data(), Scalar<T>{elem}, std::divides<T>()));
+    }
+
+    // arithmetric module: matrix % scalar
+    template<typename T, typename V>
+    DynamicMatrix<T, binaryProxyRScalar<T, V, std::modulus<T>>>
+    operator%(const DynamicMatrix<T, V> &lhs, const T &elem){
+        return DynamicMatrix<T, binaryProxyRScalar<T, V, std::modulus<T>>>
+            (lhs.rows(), lhs.cols(), binaryProxyRScalar<T, V, std::modulus<T>>(lhs.data(), Scalar<T>{elem}, std::modulus<T>()));
+    }
+
+    // equal judge: matrix == matrix
+    template<typename T, typename V1, typename V2>
+    DynamicMatrix<bool, binaryProxy<bool, V1, V2, std::equal_to<T>>>
+    operator==(const DynamicMatrix<T, V1> &lhs, const DynamicMatrix<T, V2> &rhs){
+        assert(lhs.rows() == rhs.rows() && lhs.cols() == rhs.cols() && "dimensions do not match");
+
+        return DynamicMatrix<bool, binaryProxy<bool, V1, V2, std::equal_to<T>>>
+            (lhs.rows(), lhs.cols(), binaryProxy<bool, V1, V2, std::equal_to<T>>(lhs.data(), rhs.data(), std::equal_to<T>()));
+    }
+
+    // not equal judge: matrix != matrix
+    template<typename T, typename V1, typename V2>
+    DynamicMatrix<bool, binaryProxy<bool, V1, V2, std::not_equal_to<T>>>
+    operator!=(const DynamicMatrix<T, V1> &lhs, const DynamicMatrix<T, V2> &rhs){
+        assert(lhs.rows() == rhs.rows() && lhs.cols() == rhs.cols() && "dimensions do not match");
+
+        return DynamicMatrix<bool, binaryProxy<bool, V1, V2, std::not_equal_to<T>>>
+            (lhs.rows(), lhs.cols(), binaryProxy<bool, V1, V2, std::not_equal_to<T>>(lhs.data(), rhs.data(), std::not_equal_to<T>()));
+    }
+
+    // matrix multiplication
+    // an operand that contains a product is evaluated once instead of per element
+    template<typename T, typename V1, typename V2>
+    DynamicMatrix<T, dynamicMultiProxy<T, typename MatrixImpl::ProductOperand<T, V1>::type, 
+                                          typename MatrixImpl::ProductOperand<T, V2>::type>>
+    operator*(const DynamicMatrix<T, V1> &lhs, const DynamicMatrix<T, V2> &rhs){
+        assert(lhs.cols() == rhs.rows() && "dimensions do not match");
+
+        typedef dynamicMultiProxy<T, typename MatrixImpl::ProductOperand<T, V1>::type, 
+                                     typename MatrixImpl::ProductOperand<T, V2>::type> P;
+        return DynamicMatrix<T, P>(lhs.rows(), rhs.cols(), 
+            P(MatrixImpl::ProductOperand<T, V1>::get(lhs), MatrixImpl::ProductOperand<T, V2>::get(rhs), 
+              lhs.rows(), lhs.cols(), rhs.cols()));
+    }
+
+    template<typename T>
+    class sliceDynamicMatrix{
+    public:
+        using iterator       = typename DynamicMatrix<T>::iterator;
+        using const_iterator = typename DynamicMatrix<T>::const_iterator;
+
+        sliceDynamicMatrix(DynamicMatrix<T> &m, slice row, slice col)
+            : mat{m}, r{row}, c{col} {}
+
+        size_t rows() const { return r.size; }
+
+        size_t cols() const { return c.size; }
+
+        size_t size() const { return r.size*c.size; }
+
+        T& operator()(size_t i, size_t j){
+            return mat.data()[r(i)+c.start+j*c.stride];
+        }
+
+        const T& operator()(size_t i, size_t j) const{
+            return mat.data()[r(i)+c.start+j*c.stride];
+        }
+
+        sliceDynamicMatrix& operator=(std::initializer_list<T> il){
+            assert(il.size() == size() && "overinput");
+
+            auto it = il.begin();
+            for(size_t i = 0; i < rows(); ++i)
+                for(size_t j = 0; j < cols(); ++j)
+                    (*this)(i, j) = *it++;
+
+            return *this;
+        }
+
+        template<typename V>
+        sliceDynamicMatrix& operator=(const DynamicMatrix<T, V> &rhs){
+            assert(rhs.rows() == rows() && rhs.cols() == cols() && "assignment does not match");
+
+            for(size_t i = 0; i < rows(); ++i)
+                for(size_t j = 0; j < cols(); ++j)
+                    (*this)(i, j) = rhs(i, j);
+
+            return *this;
+        }
+
+        sliceDynamicMatrix& operator=(const sliceDynamicMatrix &rhs){
+            for(size_t i = 0; i < rows(); ++i)
+                for(size_t j = 0; j < cols(); ++j)
+                    (*this)(i, j) = rhs(i, j);
+
+            return *this;
+        }
+
+    private:
+        DynamicMatrix<T> &mat;
+        slice r;
+        slice c;
+    };
+
+    template<typename T>
+    std::ostream& operator<<(std::ostream &os, const sliceDynamicMatrix<T> &sm){
+        for(size_t i = 0; i < sm.rows(); ++i){
+            for(size_t j = 0; j < sm.cols(); ++j){
+                os.width(8);
+                os.precision(3);
+                os << std::fixed << sm(i, j) << " ";
+            }
+            os << '\n';
+        }
+        os << '\n';
+        return os;
+    }
+
+}   // Lee
@@ -0,0 +1,343 @@
+#include <iostream>
+#include <cmath>
+#include <cassert>
+#include <complex>
+#include <tuple>
+#include <vector>
+#include "Matrix.hpp"
+#include "DynamicMatrix.hpp"
+#include "Factorization.hpp"
+#include "GeneralEigen.hpp"
+#include "SymmetricEigen.hpp"
+#include "Svd.hpp"
+
+namespace{
+
+    typedef std::complex<double> cplx;
+
+    // entries in [-1, 1) from a fixed seed
+    template<typename Mat>
+    void fill(Mat &a, unsigned seed){
+        typedef typename Mat::value_type T;
+        for(size_t i = 0; i < a.rows(); ++i)
+            for(size_t j = 0; j < a.cols(); ++j){
+                seed = seed*1103515245u+12345u;
+                a(i, j) = static_cast<T>((seed >> 8)%1000)/500-1;
+            }
+    }
+
+    template<typename T>
+    Lee::DynamicMatrix<T> filled(size_t m, size_t n, unsigned seed){
+        Lee::DynamicMatrix<T> a(m, n);
+        fill(a, seed);
+        return a;
+    }
+
+    // a random orthogonal n x n matrix
+    Lee::DynamicMatrix<double> orthogonal(size_t n, unsigned seed){
+        Lee::DynamicMatrix<double> Q, R;
+        std::tie(Q, R) = Lee::QRHouseholder(filled<double>(n, n, seed));
+        return Q;
+    }
+
+    // A = Q*T*Q^T, T upper quasi-triangular with 2x2 blocks [a b; -b a] (eigenvalues a+-ib)
+    // every fourth row and real values in between, so A is non-normal with a known spectrum
+    template<typename Mat>
+    std::vector<cplx> known_spectrum(Mat &A, unsigned seed){
+        const size_t n = A.rows();
+        Lee::DynamicMatrix<double> T = filled<double>(n, n, seed);
+        std::vector<cplx> w;
+        for(size_t i = 0; i < n; ++i)
+            for(size_t j = 0; j < i; ++j)
+                T(i, j) = 0;
+        for(size_t i = 0; i < n; ++i){
+            if(i%4 == 0 && i+1 < n){
+                const double a = 0.5+0.1*i, b = 1+0.05*i;
+                T(i, i) = T(i+1, i+1) = a;
+                T(i, i+1) = b;
+                T(i+1, i) = -b;
+                w.push_back(cplx(a, b));
+                w.push_back(cplx(a, -b));
+                ++i;
+            }
+            else{
+                T(i, i) = -1-0.1*i;
+                w.push_back(cplx(T(i, i), 0));
+            }
+        }
+        const Lee::DynamicMatrix<double> Q = orthogonal(n, seed+1);
+        const Lee::DynamicMatrix<double> B = Q*T*Lee::transpose(Q);
+        for(size_t i = 0; i < n; ++i)
+            for(size_t j = 0; j < n; ++j)
+                A(i, j) = B(i, j);
+        return w;
+    }
+
+    template<typename Mat>
+    double norm_max(const Mat &A){
+        double d = 0;
+        for(size_t i = 0; i < A.rows(); ++i)
+            for(size_t j = 0; j < A.cols(); ++j)
+                d = std::max(d, std::abs(A(i, j)));
+        return d;
+    }
+
+    // max |A*v_j-w_j*v_j|/|A| over all pairs, each v_j of unit length
+    template<typename Mat, typename W, typename V>
+    double eigen_residual(const Mat &A, const W &w, const V &v){
+        const size_t n = A.rows();
+        double res = 0;
+        for(size_t j = 0; j < n; ++j){
+            double len = 0;
+            for(size_t i = 0; i < n; ++i){
+                cplx r = -w(j, 0)*v(i, j);
+                for(size_t k = 0; k < n; ++k) r += A(i, k)*v(k, j);
+                res = std::max(res, std::abs(r));
+                len += std::norm(v(i, j));
+            }
+            assert(std::abs(len-1) < 1e-10 && "eigenvector not of unit length");
+        }
+        return res/std::max(norm_max(A), 1e-300);
+    }
+
+    // every value of a within tol of some value of b
+    template<typename W>
+    bool same_spectrum(const W &a, const std::vector<cplx> &b, double tol){
+        for(size_t i = 0; i < a.rows(); ++i){
+            double d = 1e300;
+            for(const cplx &z : b) d = std::min(d, std::abs(a(i, 0)-z));
+            if(d > tol) return false;
+        }
+        return a.rows() == b.size();
+    }
+
+    // conjugate pairs adjacent, positive imaginary part first
+    template<typename W>
+    bool conjugate_pairs(const W &w){
+        for(size_t i = 0; i < w.rows(); ++i){
+            if(w(i, 0).imag() == 0) continue;
+            if(w(i, 0).imag() < 0 || i+1 == w.rows() || w(i+1, 0) != std::conj(w(i, 0))) return false;
+            ++i;
+        }
+        return true;
+    }
+
+    template<typename Mat>
+    void general_case(Mat &A, unsigned seed){
+        const std::vector<cplx> ref = known_spectrum(A, seed);
+        Lee::SolverResult<double> r1 = {false, 0, -1}, r2 = r1;
+        auto wv = Lee::eigen(A, &r1);
+        auto w = Lee::eigenvalues(A, &r2);
+
+        assert(r1.converged && r2.converged && r1.residual >= 0 && "eigen did not converge");
+        assert(eigen_residual(A, std::get<0>(wv), std::get<1>(wv)) < 1e-12*A.rows() && "eigenpair residual");
+        assert(same_spectrum(std::get<0>(wv), ref, 1e-8) && "eigen: wrong spectrum");
+        assert(same_spectrum(w, ref, 1e-8) && "eigenvalues: wrong spectrum");
+        assert(conjugate_pairs(std::get<0>(wv)) && conjugate_pairs(w) && "conjugate pairs out of order");
+    }
+
+    void general(){
+        // inline storage, the rotation has the single pair +-i
+        const Lee::Matrix<double, 2, 2> rot = {0, -1, 1, 0};
+        const Lee::Matrix<std::complex<double>, 2, 1> w = Lee::eigenvalues(rot);
+        assert(std::abs(w(0, 0)-cplx(0, 1)) < 1e-14 && std::abs(w(1, 0)-cplx(0, -1)) < 1e-14 && "rotation eigenvalues");
+
+        Lee::Matrix<double, 1, 1> A1;
+        Lee::Matrix<double, 2, 2> A2;
+        Lee::Matrix<double, 3, 3> A3;
+        Lee::Matrix<double, 4, 4> A4;
+        general_case(A1, 1);
+        general_case(A2, 2);
+        general_case(A3, 3);
+        general_case(A4, 4);
+
+        // below, at and past LEE_AED_MIN, where the aggressive early deflation window is used
+        const size_t sizes[] = {9, LEE_AED_MIN-1, LEE_AED_MIN, LEE_AED_MIN+1, 2*LEE_AED_MIN+3};
+        for(size_t n : sizes){
+            Lee::DynamicMatrix<double> A(n, n);
+            general_case(A, static_cast<unsigned>(n));
+        }
+
+        // random matrix: only the pair residuals and the trace are known
+        const Lee::DynamicMatrix<double> R = filled<double>(160, 160, 5);
+        Lee::DynamicMatrix<cplx> rw, rv;
+        std::tie(rw, rv) = Lee::eigen(R);
+        cplx trace = 0;
+        for(size_t i = 0; i < R.rows(); ++i) trace += rw(i, 0)-R(i, i);
+        assert(eigen_residual(R, rw, rv) < 1e-11 && std::abs(trace) < 1e-9 && "random matrix eigenpairs");
+    }
+
+    // A*Z = Z*diag(w), Z^T*Z = I, w ascending and equal to symmetric_eigenvalues;
+    // the upper triangle is overwritten first since only the lower one may be read
+    template<typename Mat>
+    void symmetric_case(Mat A, const std::vector<double> &ref){
+        const size_t n = A.rows();
+        for(size_t i = 0; i < n; ++i)
+            for(size_t j = i+1; j < n; ++j)
+                A(j, i) = A(i, j);
+        const Mat full = A;
+        for(size_t i = 0; i < n; ++i)
+            for(size_t j = i+1; j < n; ++j)
+                A(i, j) = 1e3;
+
+        Lee::SolverResult<double> r1 = {false, 0, -1}, r2 = r1;
+        auto wz = Lee::symmetric_eigen(A, &r1);
+        auto w = Lee::symmetric_eigenvalues(A, &r2);
+        const auto &v = std::get<0>(wz);
+        const auto &Z = std::get<1>(wz);
+        assert(r1.converged && r2.converged && r1.residual >= 0 && "symmetric eigen did not converge");
+
+        const double scale = std::max(norm_max(full), 1.0);
+        double res = 0, orth = 0;
+        for(size_t j = 0; j < n; ++j){
+            assert((j == 0 || v(j-1, 0) <= v(j, 0)) && "eigenvalues not ascending");
+            assert(std::abs(v(j, 0)-w(j, 0)) < 1e-12*scale*n && "symmetric_eigenvalues differs");
+            if(!ref.empty()) assert(std::abs(v(j, 0)-ref[j]) < 1e-12*scale*n && "wrong symmetric spectrum");
+            for(size_t i = 0; i < n; ++i){
+                double r = -v(j, 0)*Z(i, j), d = i == j ? -1 : 0;
+                for(size_t k = 0; k < n; ++k){
+                    r += full(i, k)*Z(k, j);
+                    d += Z(k, i)*Z(k, j);
+                }
+                res = std::max(res, std::abs(r));
+                orth = std::max(orth, std::abs(d));
+            }
+        }
+        assert(res < 1e-13*scale*n && "symmetric eigenpair residual");
+        assert(orth < 1e-13*n && "eigenvectors not orthonormal");
+    }
+
+    void symmetric(){
+        Lee::Matrix<double, 1, 1> A1;
+        Lee::Matrix<double, 2, 2> A2;
+        Lee::Matrix<double, 3, 3> A3;
+        Lee::Matrix<double, 4, 4> A4;
+        fill(A1, 1);
+        fill(A2, 2);
+        fill(A3, 3);
+        fill(A4, 4);
+        symmetric_case(A1, {A1(0, 0)});
+        symmetric_case(A2, {});
+        symmetric_case(A3, {});
+        symmetric_case(A4, {});
+
+        // below, at and past LEE_SYTRD_BLOCK and a size where QL sweeps dominate
+        const size_t b = LEE_SYTRD_BLOCK;
+        const size_t sizes[] = {7, b-1, b, b+1, 2*b+5, 150};
+        for(size_t n : sizes)
+            symmetric_case(filled<double>(n, n, static_cast<unsigned>(n)), {});
+
+        // Q*diag(w)*Q^T with a triple eigenvalue: orthonormal vectors inside the eigenspace
+        const size_t n = 90;
+        const Lee::DynamicMatrix<double> Q = orthogonal(n, 21);
+        Lee::DynamicMatrix<double> D(n, n, 0.0);
+        std::vector<double> ref(n);
+        for(size_t i = 0; i < n; ++i) ref[i] = i < 3 ? -2.0 : 0.05*i;
+        for(size_t i = 0; i < n; ++i) D(i, i) = ref[i];
+        symmetric_case(Lee::DynamicMatrix<double>(Q*D*Lee::transpose(Q)), ref);
+    }
+
+    // max |X^T*X-I| over the columns of X
+    template<typename Mat>
+    double orthonormality(const Mat &X){
+        double d = 0;
+        for(size_t i = 0; i < X.cols(); ++i)
+            for(size_t j = 0; j < X.cols(); ++j){
+                double s = i == j ? -1 : 0;
+                for(size_t k = 0; k < X.rows(); ++k) s += X(k, i)*X(k, j);
+                d = std::max(d, std::abs(s));
+            }
+        return d;
+    }
+
+    // max |U*diag(s)*V^T-A|/|A|
+    template<typename Mat, typename U, typename S, typename V>
+    double svd_residual(const Mat &A, const U &u, const S &s, const V &v){
+        double d = 0;
+        for(size_t i = 0; i < A.rows(); ++i)
+            for(size_t j = 0; j < A.cols(); ++j){
+                double r = -A(i, j);
+                for(size_t k = 0; k < s.rows(); ++k) r += u(i, k)*s(k, 0)*v(j, k);
+                d = std::max(d, std::abs(r));
+            }
+        return d/std::max(norm_max(A), 1e-300);
+    }
+
+    // A = U*diag(s)*V^T with orthonormal U and V, s descending, equal to singular_values
+    template<typename Mat>
+    void svd_case(const Mat &A){
+        const size_t k = std::min(A.rows(), A.cols());
+        Lee::SolverResult<double> r1 = {false, 0, -1}, r2 = r1;
+        auto usv = Lee::svd(A, &r1);
+        auto w = Lee::singular_values(A, &r2);
+        const auto &s = std::get<1>(usv);
+        assert(r1.converged && r2.converged && r1.residual >= 0 && "svd did not converge");
+
+        for(size_t i = 0; i < k; ++i){
+            assert(s(i, 0) >= 0 && (i == 0 || s(i-1, 0) >= s(i, 0)) && "singular values not descending");
+            assert(std::abs(s(i, 0)-w(i, 0)) < 1e-12*k*std::max(s(0, 0), 1.0) && "singular_values differs");
+        }
+        assert(svd_residual(A, std::get<0>(usv), s, std::get<2>(usv)) < 1e-13*k && "U*diag(s)*V^T != A");
+        assert(orthonormality(std::get<0>(usv)) < 1e-13*k && "U not orthonormal");
+        assert(orthonormality(std::get<2>(usv)) < 1e-13*k && "V not orthonormal");
+    }
+
+    void svds(){
+        Lee::Matrix<double, 3, 2> A32;
+        Lee::Matrix<double, 2, 4> A24;
+        Lee::Matrix<double, 4, 4> A44;
+        fill(A32, 1);
+        fill(A24, 2);
+        fill(A44, 3);
+        svd_case(A32);
+        svd_case(A24);
+        svd_case(A44);
+
+        svd_case(filled<double>(1, 1, 4));
+        svd_case(filled<double>(33, 33, 5));
+        svd_case(filled<double>(120, 80, 6));
+        svd_case(filled<double>(50, 90, 7));
+
+        // rank 5: U is completed to orthonormal columns past the zero singular values
+        const Lee::DynamicMatrix<double> B = filled<double>(60, 5, 8), C = filled<double>(5, 40, 9);
+        const Lee::DynamicMatrix<double> L = B*C;
+        svd_case(L);
+        const Lee::DynamicMatrix<double> s = Lee::singular_values(L);
+        assert(s(4, 0) > 1e-3 && s(5, 0) < 1e-12*s(0, 0) && "rank 5 not revealed");
+    }
+
+    // rank r+5 with a gap after r: the leading r triplets are recovered
+    void randomized(){
+        const size_t m = 300, n = 200, r = 8;
+        const Lee::DynamicMatrix<double> U0 = orthogonal(m, 31), V0 = orthogonal(n, 32);
+        std::vector<double> s0(r+5);
+        for(size_t i = 0; i < s0.size(); ++i) s0[i] = i < r ? 10.0-i : 1e-4*(s0.size()-i);
+        Lee::DynamicMatrix<double> A(m, n, 0.0);
+        for(size_t i = 0; i < m; ++i)
+            for(size_t j = 0; j < n; ++j)
+                for(size_t k = 0; k < s0.size(); ++k)
+                    A(i, j) += U0(i, k)*s0[k]*V0(j, k);
+
+        Lee::SolverResult<double> res = {false, 0, -1};
+        Lee::DynamicMatrix<double> U, s, V;
+        std::tie(U, s, V) = Lee::randomized_svd(A, r, 10, 2, &res);
+        assert(res.converged && U.cols() == r && s.rows() == r && V.cols() == r && "randomized svd shapes");
+        for(size_t i = 0; i < r; ++i)
+            assert(std::abs(s(i, 0)-s0[i]) < 1e-8 && "randomized singular values");
+        assert(orthonormality(U) < 1e-12 && orthonormality(V) < 1e-12 && "randomized factors not orthonormal");
+        assert(svd_residual(A, U, s, V) < 1e-3 && "rank r approximation");
+    }
+
+}
+
+void Eigen_Test(){
+    std::cout << "\nEigen Test:\n";
+    general();
+    std::cout << "general eigen, n <= 4 and across LEE_AED_MIN, conjugate pairs: ok\n";
+    symmetric();
+    std::cout << "symmetric eigen, n <= 4 and across LEE_SYTRD_BLOCK, repeated values: ok\n";
+    svds();
+    std::cout << "svd, fixed, tall, wide and rank deficient: ok\n";
+    randomized();
+    std::cout << "randomized_svd on a matrix of known rank: ok\n";
+}
@@ -2,7 +2,154 @@
 #define _EIGENVALUEESTIMATE
 
 #include <tuple>
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <algorithm>
 #include "Basic.hpp"
+#include "Factorization.hpp"
+#include "LinearOperator.hpp"
+#include "Krylov.hpp"
+#include "Monitor.hpp"
+#include "LU.hpp"
+
+/*
+** Eigenvalue estimates, each stopping once ||A*x-lambda*x|| <= tol*|lambda| or after max_iter steps;
+** result (Monitor.hpp) receives the steps taken and that relative residual, converged = false for a zero x0
+** | power_method(A, x0, tol, max_iter, result)                       dominant eigenpair, A any operator
+** | inverse_power_method(A, x0, s, tol, max_iter, result)           eigenpair nearest s, A-sI factored once;
+** |                                                                  the iteration sees (A-sI)^-1, so the pair is
+** |                                                                  checked on A and refined when it misses tol
+** | rayleigh_quotient_iteration(A, x0, tol, max_iter, result)       shift = Rayleigh quotient, cubic convergence
+** | dominant_eigenpairs(A, k, tol, max_iter, result)                 k largest in magnitude by deflation, A symmetric;
+** |                                                                  result: all steps, the worst pair's residual
+*/
+
+namespace MatrixImpl{
+
+    // x /= ||x||, returns ||x||
+    template<typename T>
+    T normalize(size_t n, T *x){
+        const T nrm = std::sqrt(krylov_dot(n, x, x));
+        if(nrm != static_cast<T>(0))
+            for(size_t i = 0; i < n; ++i)
+                x[i] /= nrm;
+        return nrm;
+    }
+
+    // y -= Q*Q^T*y for the nb orthonormal columns stored one after another in q
+    template<typename T>
+    void deflate(size_t n, const T *q, size_t nb, T *y){
+        for(size_t j = 0; j < nb; ++j)
+            krylov_axpy(n, -krylov_dot(n, q+j*n, y), q+j*n, y);
+    }
+
+    // x <- B*x/||B*x|| with B = apply, deflated by q; theta = x^T*B*x; a start that is zero after the
+    // deflation is rejected with no steps taken
+    template<typename T, typename Apply>
+    Lee::SolverResult<T> vector_iteration(size_t n, Apply apply, T *x, T &theta, T tol, size_t max_iter,
+                                          const T *q = nullptr, size_t nb = 0){
+        std::vector<T> y(n);
+        deflate(n, q, nb, x);
+        Lee::SolverResult<T> res{false, 0, std::numeric_limits<T>::infinity()};
+        theta = 0;
+        if(normalize(n, x) == static_cast<T>(0)) return res;
+
+        while(res.iterations < max_iter){
+            apply(x, y.data());
+            deflate(n, q, nb, y.data());
+            theta = krylov_dot(n, x, y.data());
+            T r = 0;
+            for(size_t i = 0; i < n; ++i)
+                r += (y[i]-theta*x[i])*(y[i]-theta*x[i]);
+            res.residual = theta == static_cast<T>(0) ? std::sqrt(r) : std::sqrt(r)/std::abs(theta);
+            ++res.iterations;
+            if(normalize(n, y.data()) == static_cast<T>(0)) { res.converged = true; break; }   // x in the null space
+            std::copy(y.begin(), y.end(), x);
+            if(res.residual <= tol) { res.converged = true; break; }
+        }
+        return res;
+    }
+
+    // lu = A-shift*I factored, a: n x n row-major; a shift that is an eigenvalue (singular factor) is
+    // nudged away until the factorization succeeds; returns the shift used
+    template<typename T>
+    T shifted_lu_factor(size_t n, const T *a, T shift, T *lu, size_t *perm){
+        T nudge = std::numeric_limits<T>::epsilon()*std::max(std::abs(shift), static_cast<T>(1));
+        for(;;){
+            std::copy(a, a+n*n, lu);
+            for(size_t i = 0; i < n; ++i)
+                lu[i*n+i] -= shift;
+            if(lu_factor(n, lu, n, perm) != 0) return shift;
+            shift += nudge;
+            nudge *= 2;
+        }
+    }
+
+    // x with U*x = 0, U the upper factor of a singular lu_factor result: 1 at the first zero pivot,
+    // zero below it, back substitution above; then (A-shift*I)*x = 0 as well
+    template<typename T>
+    void lu_null_vector(size_t n, const T *lu, T *x){
+        size_t k = 0;
+        while(k+1 < n && lu[k*n+k] != static_cast<T>(0)) ++k;
+        std::fill(x, x+n, static_cast<T>(0));
+        x[k] = static_cast<T>(1);
+        for(size_t i = k; i-- > 0; ){
+            T s = 0;
+            for(size_t p = i+1; p <= k; ++p)
+                s += lu[i*n+p]*x[p];
+            x[i] = -s/lu[i*n+i];
+        }
+    }
+
+    // a: n x n row-major; x unit on return, lambda its Rayleigh quotient; a zero x is rejected
+    template<typename T>
+    Lee::SolverResult<T> rayleigh_quotient_iteration(size_t n, const T *a, T *x, T &lambda, T tol, size_t max_iter){
+        std::vector<T> lu(n*n), y(n);
+        std::vector<size_t> perm(n);
+        const T one = static_cast<T>(1), zero = static_cast<T>(0);
+
+        // y = A*x, lambda = x^T*y, relative residual of (lambda, x)
+        auto rayleigh = [&](){
+            gemv(n, n, one, a, n, 1, x, 1, zero, y.data(), 1);
+            lambda = krylov_dot(n, x, y.data());
+            T r = 0;
+            for(size_t i = 0; i < n; ++i)
+                r += (y[i]-lambda*x[i])*(y[i]-lambda*x[i]);
+            return lambda == zero ? std::sqrt(r) : std::sqrt(r)/std::abs(lambda);
+        };
+
+        if(normalize(n, x) == zero) return Lee::SolverResult<T>{false, 0, std::numeric_limits<T>::infinity()};
+        Lee::SolverResult<T> res{false, 0, rayleigh()};
+        T shift = lambda;
+        bool factored = false;
+        while(res.iterations < max_iter && res.residual > tol){
+            // refactor only when the Rayleigh quotient has moved, else A-shift*I is reused
+            if(!factored || std::abs(lambda-shift) > tol*std::abs(lambda)){
+                shift = lambda;
+                std::copy(a, a+n*n, lu.begin());
+                for(size_t i = 0; i < n; ++i)
+                    lu[i*n+i] -= shift;
+                if(lu_factor(n, lu.data(), n, perm.data()) == 0){
+                    // shift is an eigenvalue, though not necessarily the one of x: x = a null vector of A-shift*I
+                    lu_null_vector(n, lu.data(), x);
+                    normalize(n, x);
+                    res.residual = rayleigh();
+                    ++res.iterations;
+                    continue;
+                }
+                factored = true;
+            }
+            lu_solve(n, lu.data(), n, perm.data(), x, 1, 1);
+            normalize(n, x);
+            res.residual = rayleigh();
+            ++res.iterations;
+        }
+        res.converged = res.residual <= tol;
+        return res;
+    }
+
+}   // MatrixImpl
 
 namespace Lee{
     // template<typename T, int M, int N>
@@ -35,41 +182,153 @@ namespace Lee{
     //     return res;
     // }
 
-    template<typename T, int N>
-    std::tuple<T, Matrix<T, N, 1>> power_method(const Matrix<T, N, N> &A, const Matrix<T, N, 1> &x0){
-        Matrix<T, N, 1> u;
-        Matrix<T, N, 1> x = x0;
-        std::tuple<T, Matrix<T, N, 1>> res;
-        T lambda;
+    // x0: Matrix<T, N, 1> or DynamicMatrix<T>, the eigenvector returned with unit length
+    template<typename Op, typename Vec>
+    std::tuple<typename Vec::value_type, Vec> power_method(const Op &A, const Vec &x0,
+                                                           typename Vec::value_type tol = 1e-10, size_t max_iter = 1000,
+                                                           SolverResult<typename Vec::value_type> *result = nullptr){
+        typedef typename Vec::value_type T;
+        assert(A.rows() == A.cols() && A.cols() == x0.rows() && "dimensions do not match");
+        Vec x = x0;
+        T lambda = 0;
+        auto apply = [&A](const T *u, T *y) { MatrixImpl::operator_apply(A, u, y); };
+        MatrixImpl::solver_result(result, MatrixImpl::vector_iteration(x.rows(), apply, &x(0, 0), lambda, tol, max_iter));
+        return std::make_tuple(lambda, x);
+    }
+
+    // the iteration runs on (A-sI)^-1, applied by shift_solve(u, y), and stops on the residual of the
+    // inverse; lambda = s+1/theta is checked on A, and while it misses tol there the iteration resumes
+    // with the inner tolerance tightened, at most twice and never below 10*eps
+    template<typename T, typename Op, typename Vec, typename Solve>
+    std::tuple<T, Vec> inverse_power_iteration(const Op &A, const Vec &x0, T s, Solve shift_solve, T tol, size_t max_iter,
+                                               SolverResult<T> *result){
+        const size_t n = x0.rows();
+        const T floor = 10*std::numeric_limits<T>::epsilon();
+        Vec x = x0;
+        T theta = 0, lambda = s, inner = tol;
+        std::vector<T> ax(n);
+        SolverResult<T> res{false, 0, std::numeric_limits<T>::infinity()};
+
+        for(int pass = 0; pass < 3; ++pass){
+            const SolverResult<T> step = MatrixImpl::vector_iteration(n, shift_solve, &x(0, 0), theta, inner, max_iter-res.iterations);
+            res.iterations += step.iterations;
+            if(!step.iterations) break;
 
-        for(int i = 0; i < 40; ++i){
-            u = x/norm2(x);
-            x = A*u;
-            lambda = (transpose(u)*x)(0, 0);
+            // ||A*x-lambda*x||/|lambda|, x unit
+            lambda = s+1/theta;
+            MatrixImpl::operator_apply(A, &x(0, 0), ax.data());
+            T r = 0;
+            for(size_t i = 0; i < n; ++i)
+                r += (ax[i]-lambda*x(i, 0))*(ax[i]-lambda*x(i, 0));
+            res.residual = lambda == static_cast<T>(0) ? std::sqrt(r) : std::sqrt(r)/std::abs(lambda);
+            res.converged = res.residual <= tol;
+            if(res.converged || !step.converged || res.iterations >= max_iter || inner <= floor) break;
+            inner = std::max(inner*tol/(2*res.residual), floor);
         }
+        MatrixImpl::solver_result(result, res);
+        return std::make_tuple(lambda, x);
+    }
 
-        std::get<0>(res) = lambda;
-        std::get<1>(res) = x;
-        return res;
+    template<typename T, size_t N>
+    std::tuple<T, Matrix<T, N, 1>> inverse_power_method(const Matrix<T, N, N> &A, const Matrix<T, N, 1> &x0, double s,
+                                                        T tol = 1e-10, size_t max_iter = 1000, SolverResult<T> *result = nullptr){
+        // A-sI factored once, each step is two triangular solves; s an eigenvalue is nudged
+        std::vector<T> lu(N*N);
+        std::vector<size_t> perm(N);
+        const T shift = MatrixImpl::shifted_lu_factor(N, A.data().data(), static_cast<T>(s), lu.data(), perm.data());
+        auto solve = [&lu, &perm](const T *u, T *y){
+            std::copy(u, u+N, y);
+            MatrixImpl::lu_solve(N, lu.data(), N, perm.data(), y, 1, 1);
+        };
+        return inverse_power_iteration<T>(A, x0, shift, solve, tol, max_iter, result);
     }
 
-    template<typename T, int N>
-    std::tuple<T, Matrix<T, N, 1>> inverse_power_method(const Matrix<T, N, N> &A, const Matrix<T, N, 1> &x0, double s){
-        Matrix<T, N, 1> u;
+    template<typename T>
+    std::tuple<T, DynamicMatrix<T>> inverse_power_method(const DynamicMatrix<T> &A, const DynamicMatrix<T> &x0, double s,
+                                                         T tol = 1e-10, size_t max_iter = 1000, SolverResult<T> *result = nullptr){
+        assert(A.rows() == A.cols() && A.cols() == x0.rows() && "dimensions do not match");
+        const size_t n = A.rows();
+        std::vector<T> lu(n*n);
+        std::vector<size_t> perm(n);
+        const T shift = n ? MatrixImpl::shifted_lu_factor(n, A.data().data(), static_cast<T>(s), lu.data(), perm.data()) : static_cast<T>(s);
+        auto solve = [&lu, &perm, n](const T *u, T *y){
+            std::copy(u, u+n, y);
+            MatrixImpl::lu_solve(n, lu.data(), n, perm.data(), y, 1, 1);
+        };
+        return inverse_power_iteration<T>(A, x0, shift, solve, tol, max_iter, result);
+    }
+
+    // matrix-free: every step solves (A-sI)*y = u by GMRES, which may stall when A-sI is indefinite; the
+    // iteration is judged on the inexact operator, and the check on A catches a stalled solve
+    template<typename Op, typename Vec>
+    std::tuple<typename Vec::value_type, Vec> inverse_power_method(const Op &A, const Vec &x0, double s,
+                                                                   typename Vec::value_type tol = 1e-10, size_t max_iter = 1000,
+                                                                   SolverResult<typename Vec::value_type> *result = nullptr){
+        typedef typename Vec::value_type T;
+        const size_t n = x0.rows();
+        auto shifted = make_operator<T>(n, [&A, s, n](const T *x, T *y){
+            MatrixImpl::operator_apply(A, x, y);
+            for(size_t i = 0; i < n; ++i)
+                y[i] -= static_cast<T>(s)*x[i];
+        });
+        DynamicMatrix<T> u(n, 1), y(n, 1);
+        auto solve = [&](const T *x, T *z){
+            std::copy(x, x+n, &u(0, 0));
+            y = gmres(shifted, u, u, tol*static_cast<T>(1e-2));
+            std::copy(y.data().data(), y.data().data()+n, z);
+        };
+        return inverse_power_iteration<T>(A, x0, static_cast<T>(s), solve, tol, max_iter, result);
+    }
+
+    template<typename T, size_t N>
+    std::tuple<T, Matrix<T, N, 1>> rayleigh_quotient_iteration(const Matrix<T, N, N> &A, const Matrix<T, N, 1> &x0,
+                                                               T tol = 1e-10, size_t max_iter = 100, SolverResult<T> *result = nullptr){
         Matrix<T, N, 1> x = x0;
-        double lambda;
-        std::tuple<T, Matrix<T, N, 1>> res;
+        T lambda = 0;
+        MatrixImpl::solver_result(result, MatrixImpl::rayleigh_quotient_iteration(N, A.data().data(), &x(0, 0), lambda, tol, max_iter));
+        return std::make_tuple(lambda, x);
+    }
 
-        for(int i = 0; i < 40; ++i){
-            u = x/norm2(x);
-            x = GaussianDirect(A-s*eye<T, N>(), u);
-            lambda = (transpose(u)*x)(0, 0); 
-        }
-        lambda = 1/lambda + s;
+    template<typename T>
+    std::tuple<T, DynamicMatrix<T>> rayleigh_quotient_iteration(const DynamicMatrix<T> &A, const DynamicMatrix<T> &x0,
+                                                                T tol = 1e-10, size_t max_iter = 100, SolverResult<T> *result = nullptr){
+        assert(A.rows() == A.cols() && A.cols() == x0.rows() && "dimensions do not match");
+        DynamicMatrix<T> x = x0;
+        T lambda = 0;
+        MatrixImpl::solver_result(result, MatrixImpl::rayleigh_quotient_iteration(A.rows(), A.data().data(), &x(0, 0), lambda, tol, max_iter));
+        return std::make_tuple(lambda, x);
+    }
 
-        std::get<0>(res) = lambda;
-        std::get<1>(res) = x;
-        return res;
+    // values k x 1 in order found, vectors n x k; later iterates are kept orthogonal to the earlier vectors
+    template<typename Op>
+    std::tuple<DynamicMatrix<typename Op::value_type>, DynamicMatrix<typename Op::value_type>>
+    dominant_eigenpairs(const Op &A, size_t k, typename Op::value_type tol = 1e-10, size_t max_iter = 1000,
+                        SolverResult<typename Op::value_type> *result = nullptr){
+        typedef typename Op::value_type T;
+        assert(A.rows() == A.cols() && k <= A.rows() && "dimensions do not match");
+        const size_t n = A.rows();
+        std::vector<T> q(n*k);
+        DynamicMatrix<T> values(k, 1), vectors(n, k);
+        auto apply = [&A](const T *u, T *y) { MatrixImpl::operator_apply(A, u, y); };
+        SolverResult<T> res{true, 0, static_cast<T>(0)};
+
+        unsigned seed = 1;
+        for(size_t j = 0; j < k; ++j){
+            // a start with components along every eigenvector
+            T *x = q.data()+j*n;
+            for(size_t i = 0; i < n; ++i){
+                seed = seed*1103515245u+12345u;
+                x[i] = static_cast<T>(seed >> 8)/static_cast<T>(1u << 24)-static_cast<T>(0.5);
+            }
+            const SolverResult<T> pair = MatrixImpl::vector_iteration(n, apply, x, values(j, 0), tol, max_iter, q.data(), j);
+            res.converged = res.converged && pair.converged;
+            res.iterations += pair.iterations;
+            res.residual = std::max(res.residual, pair.residual);
+            for(size_t i = 0; i < n; ++i)
+                vectors(i, j) = x[i];
+        }
+        MatrixImpl::solver_result(result, res);
+        return std::make_tuple(values, vectors);
     }
 }
 #endif
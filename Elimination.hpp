@@ -6,27 +6,29 @@
 #include "Matrix.hpp"
 #include "Basic.hpp"
 
-namespace Lee{
+namespace MatrixImpl{
 
-    template<typename T, int M, int N>
-    std::vector<T> pivot(Matrix<T, M, N> m){
+    // shared by Matrix and DynamicMatrix: only rows(), cols(), (i, j) and permute are used
+    template<typename T, typename Mat>
+    std::vector<T> pivot(Mat &m){
+        const size_t M = m.rows(), N = m.cols();
         std::vector<T> pivots;
         T piv;
 
-        for(int i = 0; i < M; ++i)                      // row pos of pivot
-            for(int j = i; j < N; ++j){                 // col pos of pivot
+        for(size_t i = 0; i < M; ++i)                   // row pos of pivot
+            for(size_t j = i; j < N; ++j){              // col pos of pivot
                 if(!m(i, j)){                           // pivot zero, row permutation
-                    for(int r = i+1; r < M; ++r){
+                    for(size_t r = i+1; r < M; ++r){
                         if(m(r, j)) { m.permute(i, r); break; }
                     }
                 }
                 if(m(i, j)){                    // pivot not zero, forward elimination
                     piv = m(i, j);
                     pivots.push_back(piv);
-                    for(int r = i+1; r < M; ++r){
+                    for(size_t r = i+1; r < M; ++r){
                         if(!m(r, j)) continue;          // variable zero, no need to eliminate
                         T base = m(r, j)/m(i, j);
-                        for(int c = j; c < N; ++c){
+                        for(size_t c = j; c < N; ++c){
                             m(r, c) -= (base*m(i, c));
                         }
                     }
@@ -37,25 +39,23 @@ namespace Lee{
         return pivots;
     }
 
-    // Row echelon form: A -> U
-    // Algorithm: Gaussian Elimination
-    template<typename T, int M, int N>
-    Matrix<T, M, N> upper(Matrix<T, M, N> m){
-        
+    template<typename T, typename Mat>
+    void upper(Mat &m){
+        const size_t M = m.rows(), N = m.cols();
         int flag = 0;
-        for (int i = 0; i < M; ++i){                 // row pos of pivot
-           for (int j = i; j < N; ++j){              // col pos of pivot
+        for (size_t i = 0; i < M; ++i){              // row pos of pivot
+           for (size_t j = i; j < N; ++j){           // col pos of pivot
                 flag = 0;
                 if (!m(i, j)){                       // pivot zero, row permutation
-                    for (int r = i+1; r < M; ++r){
+                    for (size_t r = i+1; r < M; ++r){
                         if (m(r, j)) {m.permute(i, r); flag = 1; break;}  
                     }
                 }
                 if (m(i, j) || flag){                // pivot not zero, forward elimination
-                    for (int r = i+1; r < M; ++r){  
+                    for (size_t r = i+1; r < M; ++r){  
                         if (!m(r, j)) continue;      // variable zero, no need to eliminate
                         T base = m(r, j)/m(i, j);
-                        for (int c = j; c < N; ++c){
+                        for (size_t c = j; c < N; ++c){
                             m(r, c) -= (base*m(i, c));
                         }
                     }
@@ -64,26 +64,25 @@ namespace Lee{
                 else continue;                      // zero col, find pivot in next col
            }
         }
-
-        return m;
     }
 
-    template<typename T, int M, int N>
-    Matrix<T, M, N> lower(Matrix<T, M, N> m){
+    template<typename T, typename Mat>
+    void lower(Mat &m){
+        const size_t M = m.rows(), N = m.cols();
         int flag = 0;
-        for(int i = M-1; i >= 0; --i) {             // row pos of pivot
-            for(int j = N-1; j >= 0; --j){          // col pos of pivot
+        for(size_t i = M; i-- > 0;) {               // row pos of pivot
+            for(size_t j = N; j-- > 0;){            // col pos of pivot
                 flag = 0;
                 if(!m(i, j)){                       // pivot zero, row permutation
-                    for(int r = i-1; r >= 0; --r){
+                    for(size_t r = i; r-- > 0;){
                         if(m(r, j)) { m.permute(i, r); flag = 1; }
                     }
                 }
                 if(m(i, j) || flag){                // pivot not zero, forward elimination
-                    for(int r = i-1; r >= 0; --r){    
+                    for(size_t r = i; r-- > 0;){    
                         if(!m(r, j)) continue;      // variable zero, no need to eliminate
                         T base = m(r, j)/m(i, j);
-                        for(int c = N-1; c >= 0; --c){
+                        for(size_t c = N; c-- > 0;){
                             m(r, c) -= base*m(i, c);
                         }
                     }
@@ -92,24 +91,23 @@ namespace Lee{
                 else continue;                      // zero col, find pivot in next col
             }
         }
-        return m;
     }
 
+    template<typename T, typename Mat>
+    void rref(Mat &m){
+        const size_t M = m.rows(), N = m.cols();
+        std::vector<std::tuple<T, size_t, size_t>> pivots;
+        std::tuple<T, size_t, size_t> pivot;        
 
-    template<typename T, int M, int N>
-    Matrix<T, M, N> rref(Matrix<T, M, N> m){
-        std::vector<std::tuple<T, int, int>> pivots;
-        std::tuple<T, int, int> pivot;        
-
-        for (int i = 0; i < M; ++i){                // row pos of pivot
-           for (int j = i; j < N; ++j){             // col pos of pivot
+        for (size_t i = 0; i < M; ++i){             // row pos of pivot
+           for (size_t j = i; j < N; ++j){          // col pos of pivot
                 if (!m(i, j)){                      // pivot zero, row permutation
-                    for (int r = i+1; r < M; ++r){
+                    for (size_t r = i+1; r < M; ++r){
                         if (m(r, j)) {m.permute(i, r); break;}  
                     }
                 }
                 if (m(i, j)){                       // pivot not zero, forward elimination
-                    for(int c = j+1; c < N; ++c){     // pivot row turn to identity
+                    for(size_t c = j+1; c < N; ++c){  // pivot row turn to identity
                         m(i, c) /= m(i, j);
                     }
                     std::get<0>(pivot) = m(i, j);
@@ -117,10 +115,10 @@ namespace Lee{
                     std::get<2>(pivot) = j;
                     pivots.push_back(pivot);
                     m(i, j) = 1;                    
-                    for (int r = i+1; r < M; ++r){    // forward elimination
+                    for (size_t r = i+1; r < M; ++r){ // forward elimination
                         if (!m(r, j)) continue;
                         T base = m(r, j);
-                        for (int c = j; c < N; ++c){
+                        for (size_t c = j; c < N; ++c){
                             m(r, c) -= (base*m(i, c));
                         }
                     }
@@ -130,18 +128,69 @@ namespace Lee{
            }
         }
 
+        if(pivots.empty()) return;
         for (auto p = pivots.rbegin(); p != pivots.rend()-1; ++p){      // do back elimination
-            for(int r = std::get<1>(*p)-1; r >= 0; --r){
+            for(size_t r = std::get<1>(*p); r-- > 0;){
                 T base = m(r, std::get<2>(*p));         
-                for(int c = r; c < N; ++c){
+                for(size_t c = r; c < N; ++c){
                     m(r, c) -= (base*m(std::get<1>(*p), c));
                 }
             }
         }
+    }
+
+}   // MatrixImpl
+
+namespace Lee{
+
+    template<typename T, size_t M, size_t N>
+    std::vector<T> pivot(Matrix<T, M, N> m){
+        return MatrixImpl::pivot<T>(m);
+    }
+
+    template<typename T>
+    std::vector<T> pivot(DynamicMatrix<T> m){
+        return MatrixImpl::pivot<T>(m);
+    }
 
+    // Row echelon form: A -> U
+    // Algorithm: Gaussian Elimination
+    template<typename T, size_t M, size_t N>
+    Matrix<T, M, N> upper(Matrix<T, M, N> m){
+        MatrixImpl::upper<T>(m);
+        return m;
+    }
+
+    template<typename T>
+    DynamicMatrix<T> upper(DynamicMatrix<T> m){
+        MatrixImpl::upper<T>(m);
+        return m;
+    }
+
+    template<typename T, size_t M, size_t N>
+    Matrix<T, M, N> lower(Matrix<T, M, N> m){
+        MatrixImpl::lower<T>(m);
+        return m;
+    }
+
+    template<typename T>
+    DynamicMatrix<T> lower(DynamicMatrix<T> m){
+        MatrixImpl::lower<T>(m);
+        return m;
+    }
+
+    template<typename T, size_t M, size_t N>
+    Matrix<T, M, N> rref(Matrix<T, M, N> m){
+        MatrixImpl::rref<T>(m);
         return m;
     }    
 
+    template<typename T>
+    DynamicMatrix<T> rref(DynamicMatrix<T> m){
+        MatrixImpl::rref<T>(m);
+        return m;
+    }
+
     // template<typename T, int M, int N>
     // void solve(Matrix<T, M, N> &A, const Matrix<T, M, 1> &b){
     //     Matrix<T, M, N+1> aug = col_cat<T, M, N+1>(A, b);
@@ -4,7 +4,9 @@
 #include "Polynomial.hpp"
 
 namespace Lee{
-    double bisect(const Poly &p, double a, double b, double tol){
+    // p: Poly, Polynomial<double> or any callable double -> double
+    template<typename F>
+    double bisect(const F &p, double a, double b, double tol){
         double c;
         if(p(a) == 0) return a;
         if(p(b) == 0) return b;
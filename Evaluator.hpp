@@ -0,0 +1,488 @@
+#pragma once
+
+#include <vector>
+#include <type_traits>
+#include "Gemm.hpp"
+#include "Simd.hpp"
+
+/*
+** Materialization of expression proxies into dense storage
+** | Evaluator<V>::run(dst, src)      dst: Matrix or DynamicMatrix with dense storage
+** |                                  src: Matrix or DynamicMatrix over proxy V
+** | default: element by element through src(i, j)
+** | element-wise trees over dense storage: packet loop (Simd.hpp); trees with a product or a
+** |                                  transpose inside are evaluated aside, since they may read dst
+** | results above parallel_threshold() are split over threads by row blocks
+** | products of dense or transposed dense operands: blocked GEMM, GEMV for vectors
+** | transposes of dense storage: blocked transpose_copy
+** | materialize(m): m evaluated once into a tempStorage from the per-thread BufferPool;
+** |                 operator* uses it for operands that contain a product
+** | product chains: split by the matrix-chain DP over their compile-time dimensions,
+** |                 (A^T*A)*x is evaluated as A^T*(A*x)
+*/
+
+namespace Lee{
+    template<typename T, size_t S>
+    class inlineStorage;
+
+    template<typename T>
+    class tempStorage;
+
+    template<typename T, size_t M, typename V>
+    class transProxy;
+
+    template<typename T, typename V>
+    class dynamicTransProxy;
+
+    template<typename T, size_t M, size_t N, size_t N1, typename V1, typename V2>
+    class matrixMultiProxy;
+
+    template<typename T, typename V1, typename V2>
+    class dynamicMultiProxy;
+
+    template<typename T, typename Dims, typename... Vs>
+    class matrixChainProxy;
+}
+
+namespace MatrixImpl{
+
+    // operand of a GEMM call: element (i, j) of an r x c view is ptr[i*rs+j*cs]
+    template<typename V>
+    struct GemmOperand{
+        static const bool value = false;
+    };
+
+    template<typename T>
+    struct GemmOperand<std::vector<T>>{
+        static const bool value = !std::is_same<T, bool>::value;
+
+        static const T* ptr(const std::vector<T> &v) { return v.data(); }
+
+        static size_t rs(size_t, size_t c) { return c; }
+
+        static size_t cs(size_t, size_t) { return 1; }
+    };
+
+    template<typename T, size_t S>
+    struct GemmOperand<Lee::inlineStorage<T, S>>{
+        static const bool value = true;
+
+        static const T* ptr(const Lee::inlineStorage<T, S> &v) { return v.data(); }
+
+        static size_t rs(size_t, size_t c) { return c; }
+
+        static size_t cs(size_t, size_t) { return 1; }
+    };
+
+    template<typename T>
+    struct GemmOperand<Lee::tempStorage<T>>{
+        static const bool value = !std::is_same<T, bool>::value;
+
+        static const T* ptr(const Lee::tempStorage<T> &v) { return v.data(); }
+
+        static size_t rs(size_t, size_t c) { return c; }
+
+        static size_t cs(size_t, size_t) { return 1; }
+    };
+
+    // transposed view of an r x c result: element (i, j) is ptr[j*r+i]
+    template<typename T, size_t M, typename V>
+    struct GemmOperand<Lee::transProxy<T, M, V>>{
+        static const bool value = GemmOperand<V>::value;
+
+        static const T* ptr(const Lee::transProxy<T, M, V> &v) { return GemmOperand<V>::ptr(v.left()); }
+
+        static size_t rs(size_t, size_t) { return 1; }
+
+        static size_t cs(size_t r, size_t) { return r; }
+    };
+
+    template<typename T, typename V>
+    struct GemmOperand<Lee::dynamicTransProxy<T, V>>{
+        static const bool value = GemmOperand<V>::value;
+
+        static const T* ptr(const Lee::dynamicTransProxy<T, V> &v) { return GemmOperand<V>::ptr(v.left()); }
+
+        static size_t rs(size_t, size_t) { return 1; }
+
+        static size_t cs(size_t r, size_t) { return r; }
+    };
+
+    // recycled buffers for temporaries, one free list per thread
+    template<typename T>
+    struct BufferPool{
+        struct Cache{
+            std::vector<std::vector<T>*> free;
+
+            ~Cache() { for(auto p : free) delete p; }
+        };
+
+        static Cache& cache(){
+            static thread_local Cache c;
+            return c;
+        }
+
+        static std::vector<T>* acquire(size_t n){
+            Cache &c = cache();
+            std::vector<T> *p;
+            if(c.free.empty()) p = new std::vector<T>;
+            else { p = c.free.back(); c.free.pop_back(); }
+            p->resize(n);
+            return p;
+        }
+
+        static void release(std::vector<T> *p){
+            Cache &c = cache();
+            if(c.free.size() < 8) c.free.push_back(p);
+            else delete p;
+        }
+    };
+
+    // row-major destination over a plain buffer
+    template<typename T>
+    class DenseView{
+    public:
+        DenseView(std::vector<T> &v, size_t m, size_t n) : buf(v), nrows{m}, ncols{n} {}
+
+        size_t rows() const { return nrows; }
+
+        size_t cols() const { return ncols; }
+
+        size_t size() const { return nrows*ncols; }
+
+        T& operator()(size_t i, size_t j) { return buf[i*ncols+j]; }
+
+        std::vector<T>& data() { return buf; }
+
+    private:
+        std::vector<T> &buf;
+        size_t nrows;
+        size_t ncols;
+    };
+
+    template<typename Dst, typename Src>
+    void evaluate_rows(Dst &dst, const Src &src, size_t r0, size_t r1){
+        for(size_t i = r0; i < r1; ++i)
+            for(size_t j = 0; j < dst.cols(); ++j)
+                dst(i, j) = src(i, j);
+    }
+
+    template<typename Dst, typename Src>
+    void evaluate_elementwise(Dst &dst, const Src &src, std::true_type){
+        parallel_rows(dst.rows(), dst.size(), [&](size_t r0, size_t r1){
+            evaluate_rows(dst, src, r0, r1);
+        });
+    }
+
+    // std::vector<bool> cannot be written from several threads
+    template<typename Dst, typename Src>
+    void evaluate_elementwise(Dst &dst, const Src &src, std::false_type){
+        evaluate_rows(dst, src, 0, dst.rows());
+    }
+
+    template<typename Dst, typename Src>
+    void evaluate_elementwise(Dst &dst, const Src &src){
+        typedef typename std::remove_reference<decltype(dst.data())>::type DV;
+        evaluate_elementwise(dst, src, std::integral_constant<bool, GemmOperand<DV>::value>());
+    }
+
+    // dst = src through a temporary, for sources that read dst
+    template<typename T, typename Dst, typename Src>
+    void evaluate_aside(Dst &dst, const Src &src){
+        std::vector<T> tmp(dst.size());
+        DenseView<T> view(tmp, dst.rows(), dst.cols());
+        evaluate_elementwise(view, src);
+        for(size_t i = 0; i < dst.rows(); ++i)
+            for(size_t j = 0; j < dst.cols(); ++j)
+                dst(i, j) = tmp[i*dst.cols()+j];
+    }
+
+    // dst = lhs*rhs with lhs: m x k, rhs: k x n
+    template<typename T, typename V1, typename V2, typename Dst, typename Src>
+    void evaluate_product(Dst &dst, const Src &src, const V1 &lhs, const V2 &rhs, size_t m, size_t k, size_t n, std::true_type){
+        if(!m || !n) return;
+
+        const T *A = GemmOperand<V1>::ptr(lhs);
+        const T *B = GemmOperand<V2>::ptr(rhs);
+        T *C = &dst(0, 0);
+
+        // a = a*b reads a while writing it
+        const bool alias = C == A || C == B;
+        if(m*n*k < LEE_GEMM_THRESHOLD){
+            if(alias) evaluate_aside<T>(dst, src);
+            else evaluate_elementwise(dst, src);
+            return;
+        }
+        if(alias){
+            std::vector<T> tmp(m*n);
+            product_parallel(m, n, k, A, GemmOperand<V1>::rs(m, k), GemmOperand<V1>::cs(m, k),
+                             B, GemmOperand<V2>::rs(k, n), GemmOperand<V2>::cs(k, n), tmp.data());
+            std::copy(tmp.begin(), tmp.end(), C);
+            return;
+        }
+        product_parallel(m, n, k, A, GemmOperand<V1>::rs(m, k), GemmOperand<V1>::cs(m, k),
+                         B, GemmOperand<V2>::rs(k, n), GemmOperand<V2>::cs(k, n), C);
+    }
+
+    // operands that are not plain storage may still read dst
+    template<typename T, typename V1, typename V2, typename Dst, typename Src>
+    void evaluate_product(Dst &dst, const Src &src, const V1 &, const V2 &, size_t, size_t, size_t, std::false_type){
+        evaluate_aside<T>(dst, src);
+    }
+
+    // element (i, j) reads other positions of its operands: products and transposes anywhere in the tree
+    template<typename V>
+    struct ReadsAcross{
+        static const bool value = false;
+    };
+
+    template<typename T, size_t M, size_t N, size_t N1, typename V1, typename V2>
+    struct ReadsAcross<Lee::matrixMultiProxy<T, M, N, N1, V1, V2>>{
+        static const bool value = true;
+    };
+
+    template<typename T, typename V1, typename V2>
+    struct ReadsAcross<Lee::dynamicMultiProxy<T, V1, V2>>{
+        static const bool value = true;
+    };
+
+    template<typename T, typename Dims, typename... Vs>
+    struct ReadsAcross<Lee::matrixChainProxy<T, Dims, Vs...>>{
+        static const bool value = true;
+    };
+
+    template<typename T, size_t M, typename V>
+    struct ReadsAcross<Lee::transProxy<T, M, V>>{
+        static const bool value = true;
+    };
+
+    template<typename T, typename V>
+    struct ReadsAcross<Lee::dynamicTransProxy<T, V>>{
+        static const bool value = true;
+    };
+
+    template<typename T, typename V, typename F>
+    struct ReadsAcross<Lee::applyProxy<T, V, F>>{
+        static const bool value = ReadsAcross<V>::value;
+    };
+
+    template<typename T, typename V1, typename V2, typename F>
+    struct ReadsAcross<Lee::binaryProxy<T, V1, V2, F>>{
+        static const bool value = ReadsAcross<V1>::value || ReadsAcross<V2>::value;
+    };
+
+    template<typename T, typename V, typename F>
+    struct ReadsAcross<Lee::binaryProxyRScalar<T, V, F>>{
+        static const bool value = ReadsAcross<V>::value;
+    };
+
+    template<typename T, typename V, typename F>
+    struct ReadsAcross<Lee::binaryProxyLScalar<T, V, F>>{
+        static const bool value = ReadsAcross<V>::value;
+    };
+
+    template<typename Dst, typename Src>
+    void evaluate_flat(Dst &dst, const Src &src, std::true_type){
+        if(!dst.size()) return;
+
+        const size_t n = dst.cols();
+        auto ptr = &dst(0, 0);
+        parallel_rows(dst.rows(), dst.size(), [&](size_t r0, size_t r1){
+            packet_assign(ptr, src.data(), r0*n, r1*n);
+        });
+    }
+
+    template<typename Dst, typename Src>
+    void evaluate_flat(Dst &dst, const Src &src, std::false_type){
+        evaluate_elementwise(dst, src);
+    }
+
+    // b+a*c into a: a*c and transposes read elements of a that are already written
+    template<typename Dst, typename Src>
+    void evaluate_tree(Dst &dst, const Src &src, std::true_type){
+        evaluate_aside<typename Src::value_type>(dst, src);
+    }
+
+    template<typename Dst, typename Src>
+    void evaluate_tree(Dst &dst, const Src &src, std::false_type){
+        typedef typename std::remove_reference<decltype(dst.data())>::type DV;
+        typedef typename std::decay<decltype(src.data())>::type V;
+        evaluate_flat(dst, src, std::integral_constant<bool, PacketExpr<V>::value && PacketExpr<DV>::value>());
+    }
+
+    template<typename V>
+    struct Evaluator{
+        template<typename Dst, typename Src>
+        static void run(Dst &dst, const Src &src){
+            evaluate_tree(dst, src, std::integral_constant<bool, ReadsAcross<V>::value>());
+        }
+    };
+
+    // dst = src^T, src: c x r dense
+    template<typename T, typename V, typename Dst, typename Src>
+    void evaluate_transpose(Dst &dst, const Src &src, const V &v, std::true_type){
+        const size_t r = dst.rows(), c = dst.cols();
+        if(!dst.size()) return;
+
+        const T *A = GemmOperand<V>::ptr(v);
+        T *B = &dst(0, 0);
+        if(A == B){
+            std::vector<T> tmp(r*c);
+            transpose_copy(c, r, A, tmp.data());
+            std::copy(tmp.begin(), tmp.end(), B);
+            return;
+        }
+        transpose_copy(c, r, A, B);
+    }
+
+    template<typename T, typename V, typename Dst, typename Src>
+    void evaluate_transpose(Dst &dst, const Src &src, const V &, std::false_type){
+        evaluate_elementwise(dst, src);
+    }
+
+    template<typename T, size_t M, typename V>
+    struct Evaluator<Lee::transProxy<T, M, V>>{
+        template<typename Dst, typename Src>
+        static void run(Dst &dst, const Src &src){
+            typedef typename std::remove_reference<decltype(dst.data())>::type DV;
+            evaluate_transpose<T>(dst, src, src.data().left(),
+                std::integral_constant<bool, GemmOperand<V>::value && GemmOperand<DV>::value>());
+        }
+    };
+
+    template<typename T, typename V>
+    struct Evaluator<Lee::dynamicTransProxy<T, V>>{
+        template<typename Dst, typename Src>
+        static void run(Dst &dst, const Src &src){
+            typedef typename std::remove_reference<decltype(dst.data())>::type DV;
+            evaluate_transpose<T>(dst, src, src.data().left(),
+                std::integral_constant<bool, GemmOperand<V>::value && GemmOperand<DV>::value>());
+        }
+    };
+
+    template<typename T, size_t M, size_t N, size_t N1, typename V1, typename V2>
+    struct Evaluator<Lee::matrixMultiProxy<T, M, N, N1, V1, V2>>{
+        template<typename Dst, typename Src>
+        static void run(Dst &dst, const Src &src){
+            const Lee::matrixMultiProxy<T, M, N, N1, V1, V2> &p = src.data();
+            evaluate_product<T>(dst, src, p.left(), p.right(), M, N, N1,
+                std::integral_constant<bool, GemmOperand<V1>::value && GemmOperand<V2>::value>());
+        }
+    };
+
+    template<typename T, typename V1, typename V2>
+    struct Evaluator<Lee::dynamicMultiProxy<T, V1, V2>>{
+        template<typename Dst, typename Src>
+        static void run(Dst &dst, const Src &src){
+            const Lee::dynamicMultiProxy<T, V1, V2> &p = src.data();
+            evaluate_product<T>(dst, src, p.left(), p.right(), p.rows(), p.inner(), p.cols(),
+                std::integral_constant<bool, GemmOperand<V1>::value && GemmOperand<V2>::value>());
+        }
+    };
+
+    template<typename T, typename Mat>
+    Lee::tempStorage<T> materialize(const Mat &m){
+        typedef typename std::decay<decltype(m.data())>::type V;
+
+        Lee::tempStorage<T> res(m.rows()*m.cols());
+        DenseView<T> dst(res.buffer(), m.rows(), m.cols());
+        Evaluator<V>::run(dst, m);
+        return res;
+    }
+
+    // matrix-chain DP over Dims (d0 x d1, d1 x d2, ...): every (I, J) subchain is one class
+    // instantiation, so the compiler evaluates each subproblem once, O(n^3) in all
+    template<typename Dims, size_t I, size_t J, bool = (I == J)>
+    struct ChainCost;
+
+    // multiply-adds of (I..K)(K+1..J), both halves in their cheapest order
+    template<typename Dims, size_t I, size_t J, size_t K>
+    struct ChainSplitCost{
+        static constexpr size_t value = ChainCost<Dims, I, K>::value+ChainCost<Dims, K+1, J>::value
+                                       +Dims::value[I]*Dims::value[K+1]*Dims::value[J+1];
+    };
+
+    // cheapest split K of I..J among [K0, J), the first one on ties
+    template<typename Dims, size_t I, size_t J, size_t K0 = I, bool = (K0+1 == J)>
+    struct ChainSplit{
+        static constexpr size_t rest = ChainSplit<Dims, I, J, K0+1>::value;
+        static constexpr size_t value = 
+            ChainSplitCost<Dims, I, J, K0>::value <= ChainSplitCost<Dims, I, J, rest>::value ? K0 : rest;
+    };
+
+    template<typename Dims, size_t I, size_t J, size_t K0>
+    struct ChainSplit<Dims, I, J, K0, true>{
+        static constexpr size_t value = K0;
+    };
+
+    template<typename Dims, size_t I, size_t J, bool>
+    struct ChainCost{
+        static constexpr size_t value = ChainSplitCost<Dims, I, J, ChainSplit<Dims, I, J>::value>::value;
+    };
+
+    template<typename Dims, size_t I, size_t J>
+    struct ChainCost<Dims, I, J, true>{
+        static constexpr size_t value = 0;
+    };
+
+    template<typename T, size_t M, size_t K, size_t N, typename V1, typename V2>
+    Lee::Matrix<T, M, N, Lee::matrixMultiProxy<T, M, K, N, V1, V2>>
+    chain_product(const V1 &lhs, const V2 &rhs){
+        return Lee::matrixMultiProxy<T, M, K, N, V1, V2>(lhs, rhs);
+    }
+
+    // product of operands I..J of a chain
+    template<typename T, typename Chain, size_t I, size_t J, bool = (I == J)>
+    struct ChainEval{
+        using type = Lee::tempStorage<T>;
+
+        static type run(const Chain &c){
+            typedef typename Chain::dims D;
+            const size_t K = ChainSplit<D, I, J>::value;
+            typedef typename std::decay<typename ChainEval<T, Chain, I, K>::type>::type V1;
+            typedef typename std::decay<typename ChainEval<T, Chain, K+1, J>::type>::type V2;
+
+            const V1 &lhs = ChainEval<T, Chain, I, K>::run(c);
+            const V2 &rhs = ChainEval<T, Chain, K+1, J>::run(c);
+            return materialize<T>(chain_product<T, D::value[I], D::value[K+1], D::value[J+1]>(lhs, rhs));
+        }
+    };
+
+    template<typename T, typename Chain, size_t I, size_t J>
+    struct ChainEval<T, Chain, I, J, true>{
+        using type = const typename std::decay<typename std::tuple_element<I, typename Chain::operand_tuple>::type>::type&;
+
+        static type run(const Chain &c) { return std::get<I>(c.operands()); }
+    };
+
+    // the last product goes straight into dst
+    template<typename T, typename Dims, typename... Vs, typename Dst>
+    void evaluate_chain(Dst &dst, const Lee::matrixChainProxy<T, Dims, Vs...> &c){
+        typedef Lee::matrixChainProxy<T, Dims, Vs...> Chain;
+        const size_t J = sizeof...(Vs)-1;
+        const size_t K = ChainSplit<Dims, 0, J>::value;
+        typedef typename std::decay<typename ChainEval<T, Chain, 0, K>::type>::type V1;
+        typedef typename std::decay<typename ChainEval<T, Chain, K+1, J>::type>::type V2;
+
+        const V1 &lhs = ChainEval<T, Chain, 0, K>::run(c);
+        const V2 &rhs = ChainEval<T, Chain, K+1, J>::run(c);
+        auto prod = chain_product<T, Dims::value[0], Dims::value[K+1], Dims::value[J+1]>(lhs, rhs);
+        Evaluator<Lee::matrixMultiProxy<T, Dims::value[0], Dims::value[K+1], Dims::value[J+1], V1, V2>>::run(dst, prod);
+    }
+
+    template<typename T, typename Chain>
+    void evaluate_chain(std::vector<T> &res, const Chain &c){
+        res.resize(c.size());
+        DenseView<T> dst(res, Chain::M, Chain::N1);
+        evaluate_chain(dst, c);
+    }
+
+    template<typename T, typename Dims, typename... Vs>
+    struct Evaluator<Lee::matrixChainProxy<T, Dims, Vs...>>{
+        template<typename Dst, typename Src>
+        static void run(Dst &dst, const Src &src){
+            evaluate_chain(dst, src.data());
+        }
+    };
+
+}   // MatrixImpl
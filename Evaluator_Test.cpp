@@ -0,0 +1,387 @@
+#include <iostream>
+#include <cmath>
+#include <cassert>
+#include <type_traits>
+#include "Matrix.hpp"
+#include "DynamicMatrix.hpp"
+
+namespace{
+
+    // entries in [-1, 1) from a fixed seed
+    template<typename Mat>
+    void fill(Mat &a, unsigned seed){
+        typedef typename Mat::value_type T;
+        for(size_t i = 0; i < a.rows(); ++i)
+            for(size_t j = 0; j < a.cols(); ++j){
+                seed = seed*1103515245u+12345u;
+                a(i, j) = static_cast<T>((seed >> 8)%1000)/500-1;
+            }
+    }
+
+    template<typename T, size_t M, size_t N>
+    Lee::Matrix<T, M, N> filled(unsigned seed){
+        Lee::Matrix<T, M, N> a;
+        fill(a, seed);
+        return a;
+    }
+
+    template<typename T>
+    Lee::DynamicMatrix<T> filled(size_t m, size_t n, unsigned seed){
+        Lee::DynamicMatrix<T> a(m, n);
+        fill(a, seed);
+        return a;
+    }
+
+    // lhs*rhs by the textbook triple loop, read through element access only
+    template<typename T, typename A, typename B>
+    Lee::DynamicMatrix<T> naive_product(const A &lhs, const B &rhs){
+        Lee::DynamicMatrix<T> c(lhs.rows(), rhs.cols(), static_cast<T>(0));
+        for(size_t i = 0; i < lhs.rows(); ++i)
+            for(size_t p = 0; p < lhs.cols(); ++p)
+                for(size_t j = 0; j < rhs.cols(); ++j)
+                    c(i, j) += lhs(i, p)*rhs(p, j);
+        return c;
+    }
+
+    // split of the whole chain chosen by the DP for the product expression E
+    template<typename E>
+    size_t top_split(const E &e){
+        typedef typename std::decay<decltype(e.data())>::type P;
+        return MatrixImpl::ChainSplit<typename P::dims, 0, std::tuple_size<typename P::operand_tuple>::value-1>::value;
+    }
+
+    // max |a(i, j)-b(i, j)|, any two matrices or expressions of the same shape
+    template<typename A, typename B>
+    double max_diff(const A &a, const B &b){
+        assert(a.rows() == b.rows() && a.cols() == b.cols() && "shapes differ");
+        double d = 0;
+        for(size_t i = 0; i < a.rows(); ++i)
+            for(size_t j = 0; j < a.cols(); ++j)
+                d = std::max(d, std::abs(static_cast<double>(a(i, j))-static_cast<double>(b(i, j))));
+        return d;
+    }
+
+    void chain_order(){
+        const Lee::Matrix<double, 40, 30> A = filled<double, 40, 30>(1);
+        const Lee::Matrix<double, 30, 1> x = filled<double, 30, 1>(2);
+
+        // A^T*A*x: A^T*(A*x), 2*40*30 multiply-adds against 30*40*30+30*30
+        assert(top_split(Lee::transpose(A)*A*x) == 0 && "A^T*A*x not split as A^T*(A*x)");
+        const Lee::Matrix<double, 40, 1> ax = A*x;
+        Lee::Matrix<double, 30, 1> ref = Lee::transpose(A)*ax;
+        Lee::Matrix<double, 30, 1> y = Lee::transpose(A)*A*x;
+        assert(max_diff(y, ref) < 1e-12 && "A^T*A*x");
+
+        // x^T*A^T*A: (x^T*A^T)*A
+        assert(top_split(Lee::transpose(x)*Lee::transpose(A)*A) == 1 && "x^T*A^T*A not split as (x^T*A^T)*A");
+    }
+
+    // twelve operands: compiles in O(n^3) instantiations, checked against left to right
+    void long_chain(){
+        const Lee::Matrix<double, 3, 5> a0 = filled<double, 3, 5>(3);
+        const Lee::Matrix<double, 5, 2> a1 = filled<double, 5, 2>(4);
+        const Lee::Matrix<double, 2, 7> a2 = filled<double, 2, 7>(5);
+        const Lee::Matrix<double, 7, 4> a3 = filled<double, 7, 4>(6);
+        const Lee::Matrix<double, 4, 6> a4 = filled<double, 4, 6>(7);
+        const Lee::Matrix<double, 6, 1> a5 = filled<double, 6, 1>(8);
+        const Lee::Matrix<double, 1, 8> a6 = filled<double, 1, 8>(9);
+        const Lee::Matrix<double, 8, 3> a7 = filled<double, 8, 3>(10);
+        const Lee::Matrix<double, 3, 9> a8 = filled<double, 3, 9>(11);
+        const Lee::Matrix<double, 9, 2> a9 = filled<double, 9, 2>(12);
+        const Lee::Matrix<double, 2, 5> a10 = filled<double, 2, 5>(13);
+        const Lee::Matrix<double, 5, 4> a11 = filled<double, 5, 4>(14);
+
+        Lee::Matrix<double, 3, 4> p = a0*a1*a2*a3*a4*a5*a6*a7*a8*a9*a10*a11;
+
+        Lee::Matrix<double, 3, 2> r1 = a0*a1;
+        Lee::Matrix<double, 3, 7> r2 = r1*a2;
+        Lee::Matrix<double, 3, 4> r3 = r2*a3;
+        Lee::Matrix<double, 3, 6> r4 = r3*a4;
+        Lee::Matrix<double, 3, 1> r5 = r4*a5;
+        Lee::Matrix<double, 3, 8> r6 = r5*a6;
+        Lee::Matrix<double, 3, 3> r7 = r6*a7;
+        Lee::Matrix<double, 3, 9> r8 = r7*a8;
+        Lee::Matrix<double, 3, 2> r9 = r8*a9;
+        Lee::Matrix<double, 3, 5> r10 = r9*a10;
+        Lee::Matrix<double, 3, 4> r11 = r10*a11;
+        const Lee::Matrix<double, 3, 4> zero(12, 0.0);
+        assert(max_diff(p, r11) < 1e-12*(1+max_diff(r11, zero)) && "twelve-operand chain");
+    }
+
+    // fixed and dynamic products on both sides of LEE_GEMM_THRESHOLD, sizes off the register tile
+    void products(){
+        const Lee::Matrix<double, 3, 5> a = filled<double, 3, 5>(21);
+        const Lee::Matrix<double, 5, 2> b = filled<double, 5, 2>(22);
+        Lee::Matrix<double, 3, 2> ab = a*b;
+        assert(max_diff(ab, naive_product<double>(a, b)) < 1e-14 && "small fixed product");
+
+        const Lee::Matrix<double, 37, 45> c = filled<double, 37, 45>(23);
+        const Lee::Matrix<double, 45, 29> d = filled<double, 45, 29>(24);
+        Lee::Matrix<double, 37, 29> cd = c*d;
+        assert(max_diff(cd, naive_product<double>(c, d)) < 1e-12 && "fixed GEMM");
+
+        // MC, KC blocks and a partial last panel in each
+        const Lee::DynamicMatrix<double> e = filled<double>(261, 300, 25), f = filled<double>(300, 133, 26);
+        Lee::DynamicMatrix<double> ef = e*f;
+        assert(max_diff(ef, naive_product<double>(e, f)) < 1e-11 && "dynamic GEMM");
+
+        const Lee::DynamicMatrix<float> g = filled<float>(67, 90, 27), h = filled<float>(90, 71, 28);
+        Lee::DynamicMatrix<float> gh = g*h;
+        assert(max_diff(gh, naive_product<float>(g, h)) < 1e-4 && "float GEMM");
+
+        Lee::DynamicMatrix<int> gi(67, 90), hi(90, 71);
+        for(size_t i = 0; i < gi.size(); ++i) gi.data()[i] = static_cast<int>(i*7%13)-6;
+        for(size_t i = 0; i < hi.size(); ++i) hi.data()[i] = static_cast<int>(i*5%11)-5;
+        Lee::DynamicMatrix<int> ghi = gi*hi;
+        assert(max_diff(ghi, naive_product<int>(gi, hi)) == 0 && "integer GEMM");
+    }
+
+    // matrix-vector and vector-matrix products go through GEMV
+    void gemv(){
+        const Lee::DynamicMatrix<double> a = filled<double>(301, 257, 31), x = filled<double>(257, 1, 32), y = filled<double>(1, 301, 33);
+        Lee::DynamicMatrix<double> ax = a*x, ya = y*a;
+        assert(max_diff(ax, naive_product<double>(a, x)) < 1e-12 && "GEMV A*x");
+        assert(max_diff(ya, naive_product<double>(y, a)) < 1e-12 && "GEMV y*A");
+
+        const Lee::Matrix<double, 90, 70> b = filled<double, 90, 70>(34);
+        const Lee::Matrix<double, 70, 1> u = filled<double, 70, 1>(35);
+        Lee::Matrix<double, 90, 1> bu = b*u;
+        assert(max_diff(bu, naive_product<double>(b, u)) < 1e-12 && "fixed GEMV");
+    }
+
+    // a = a*b and a = b+a*c read a while it is written, below and above the GEMM threshold
+    void aliasing(){
+        Lee::Matrix<double, 4, 4> s = filled<double, 4, 4>(41);
+        const Lee::Matrix<double, 4, 4> t = filled<double, 4, 4>(42);
+        const Lee::DynamicMatrix<double> st = naive_product<double>(s, t);
+        s = s*t;
+        assert(max_diff(s, st) < 1e-14 && "small a = a*b");
+
+        Lee::Matrix<double, 40, 40> a = filled<double, 40, 40>(43);
+        const Lee::Matrix<double, 40, 40> b = filled<double, 40, 40>(44), c = filled<double, 40, 40>(45);
+        const Lee::DynamicMatrix<double> ab = naive_product<double>(a, b), ba = naive_product<double>(b, a);
+        Lee::Matrix<double, 40, 40> a0 = a;
+        a = a*b;
+        assert(max_diff(a, ab) < 1e-12 && "a = a*b");
+        a = a0;
+        a = b*a;
+        assert(max_diff(a, ba) < 1e-12 && "a = b*a");
+
+        a = a0;
+        Lee::DynamicMatrix<double> bac = naive_product<double>(a0, c);
+        for(size_t i = 0; i < 40; ++i)
+            for(size_t j = 0; j < 40; ++j)
+                bac(i, j) += b(i, j);
+        a = b+a*c;
+        assert(max_diff(a, bac) < 1e-12 && "a = b+a*c");
+
+        Lee::DynamicMatrix<double> d = filled<double>(50, 50, 46), d0 = d;
+        const Lee::DynamicMatrix<double> e = filled<double>(50, 50, 47);
+        d = d*e;
+        assert(max_diff(d, naive_product<double>(d0, e)) < 1e-12 && "dynamic a = a*b");
+        d = d0;
+        d = e+d*e;
+        Lee::DynamicMatrix<double> ede = naive_product<double>(d0, e);
+        for(size_t i = 0; i < 50; ++i)
+            for(size_t j = 0; j < 50; ++j)
+                ede(i, j) += e(i, j);
+        assert(max_diff(d, ede) < 1e-12 && "dynamic a = b+a*c");
+    }
+
+
+    // a transposed copy of a, element by element
+    template<typename T, typename A>
+    Lee::DynamicMatrix<T> naive_transpose(const A &a){
+        Lee::DynamicMatrix<T> t(a.cols(), a.rows());
+        for(size_t i = 0; i < a.rows(); ++i)
+            for(size_t j = 0; j < a.cols(); ++j)
+                t(j, i) = a(i, j);
+        return t;
+    }
+
+    // A^T*B, A*B^T, A^T*B^T and A^T*x read the untransposed storage through strides
+    void transposed_products(){
+        const Lee::DynamicMatrix<double> a = filled<double>(131, 67, 71), b = filled<double>(131, 45, 72), c = filled<double>(45, 67, 73);
+        const Lee::DynamicMatrix<double> e = filled<double>(45, 131, 76), x = filled<double>(131, 1, 74);
+        const Lee::DynamicMatrix<double> at = naive_transpose<double>(a), ct = naive_transpose<double>(c), et = naive_transpose<double>(e);
+
+        Lee::DynamicMatrix<double> atb = Lee::transpose(a)*b, act = a*Lee::transpose(c), 
+                                   atet = Lee::transpose(a)*Lee::transpose(e), atx = Lee::transpose(a)*x;
+        assert(max_diff(atb, naive_product<double>(at, b)) < 1e-12 && "A^T*B");
+        assert(max_diff(act, naive_product<double>(a, ct)) < 1e-12 && "A*B^T");
+        assert(max_diff(atet, naive_product<double>(at, et)) < 1e-12 && "A^T*B^T");
+        assert(max_diff(atx, naive_product<double>(at, x)) < 1e-12 && "A^T*x");
+
+        const Lee::Matrix<float, 40, 33> f = filled<float, 40, 33>(75);
+        Lee::Matrix<float, 33, 33> ftf = Lee::transpose(f)*f;
+        assert(max_diff(ftf, naive_product<float>(Lee::transpose(f), f)) < 1e-4 && "fixed A^T*A");
+    }
+
+    // blocked transpose_copy over partial tiles, on its own and in place
+    void transposes(){
+        const Lee::DynamicMatrix<double> a = filled<double>(257, 131, 81);
+        Lee::DynamicMatrix<double> t = Lee::transpose(a);
+        assert(t.rows() == 131 && t.cols() == 257 && max_diff(t, naive_transpose<double>(a)) == 0 && "transpose_copy");
+
+        Lee::DynamicMatrix<int> big(300, 301);
+        for(size_t i = 0; i < big.size(); ++i) big.data()[i] = static_cast<int>(i);
+        Lee::DynamicMatrix<int> bt = Lee::transpose(big);
+        assert(max_diff(bt, naive_transpose<int>(big)) == 0 && "threaded transpose_copy");
+
+        Lee::Matrix<double, 70, 70> s = filled<double, 70, 70>(82);
+        const Lee::DynamicMatrix<double> st = naive_transpose<double>(s);
+        s = Lee::transpose(s);
+        assert(max_diff(s, st) == 0 && "s = s^T");
+    }
+
+    // storage a product keeps of its right operand
+    template<typename P>
+    struct ProductRhs;
+
+    template<typename T, size_t M, size_t N, size_t N1, typename V1, typename V2>
+    struct ProductRhs<Lee::matrixMultiProxy<T, M, N, N1, V1, V2>>{
+        using type = V2;
+    };
+
+    template<typename T, typename V1, typename V2>
+    struct ProductRhs<Lee::dynamicMultiProxy<T, V1, V2>>{
+        using type = V2;
+    };
+
+    template<typename E>
+    bool rhs_materialized(const E &e){
+        typedef typename std::decay<decltype(e.data())>::type P;
+        return std::is_same<typename ProductRhs<P>::type, Lee::tempStorage<typename E::value_type>>::value;
+    }
+
+    // operands that contain a product are evaluated once into a temporary, then multiplied
+    void nested_products(){
+        const Lee::Matrix<double, 30, 30> d = filled<double, 30, 30>(61), l = filled<double, 30, 30>(62), u = filled<double, 30, 30>(63);
+        const Lee::Matrix<double, 30, 1> b = filled<double, 30, 1>(64), x = filled<double, 30, 1>(65);
+
+        // d*(b-(l+u)*x), the Jacobi step
+        assert(rhs_materialized(d*(b-(l+u)*x)) && "operand with a product not materialized");
+        Lee::Matrix<double, 30, 1> y = d*(b-(l+u)*x);
+        Lee::DynamicMatrix<double> r = naive_product<double>(Lee::DynamicMatrix<double>(l+u), x);
+        for(size_t i = 0; i < 30; ++i)
+            r(i, 0) = b(i, 0)-r(i, 0);
+        assert(max_diff(y, naive_product<double>(d, r)) < 1e-12 && "d*(b-(l+u)*x)");
+
+        // d*abs(l*u)^T, a transposed product as an operand
+        Lee::Matrix<double, 30, 30> z = d*Lee::transpose(Lee::abs(l*u));
+        Lee::DynamicMatrix<double> lu = naive_product<double>(l, u), lut(30, 30);
+        for(size_t i = 0; i < 30; ++i)
+            for(size_t j = 0; j < 30; ++j)
+                lut(i, j) = std::abs(lu(j, i));
+        assert(max_diff(z, naive_product<double>(d, lut)) < 1e-12 && "d*(abs(l*u))^T");
+
+        const Lee::DynamicMatrix<double> e = filled<double>(45, 45, 66), f = filled<double>(45, 45, 67), v = filled<double>(45, 1, 68);
+        assert(rhs_materialized(e*(v+f*v)) && "dynamic operand with a product not materialized");
+        Lee::DynamicMatrix<double> w = e*(v+f*v), fv = naive_product<double>(f, v);
+        for(size_t i = 0; i < 45; ++i)
+            fv(i, 0) += v(i, 0);
+        assert(max_diff(w, naive_product<double>(e, fv)) < 1e-12 && "e*(v+f*v)");
+    }
+
+    // one element-wise tree over every packet width and a scalar tail, checked element by element
+    template<typename T>
+    void elementwise_tree(size_t m, size_t n){
+        Lee::DynamicMatrix<T> a(m, n), b(m, n);
+        for(size_t i = 0; i < a.size(); ++i){
+            a.data()[i] = static_cast<T>(static_cast<int>(i*37%101)-50);
+            b.data()[i] = static_cast<T>(static_cast<int>(i*13%29)-14);
+        }
+        const T two = 2, three = 3, seven = 7;
+        Lee::DynamicMatrix<T> r = (three*a+b)/seven-Lee::abs(b)+(-a)*two;
+        for(size_t i = 0; i < a.size(); ++i){
+            const T x = a.data()[i], y = b.data()[i];
+            assert(r.data()[i] == (three*x+y)/seven-(y < 0 ? -y : y)+(-x)*two && "element-wise tree");
+        }
+    }
+
+    // integer % and / truncate toward zero, negative operands included
+    template<typename T>
+    void integer_tree(size_t m, size_t n){
+        Lee::DynamicMatrix<T> a(m, n);
+        for(size_t i = 0; i < a.size(); ++i)
+            a.data()[i] = static_cast<T>(static_cast<int>(i*37%101)-50);
+        const T two = 2, five = 5, sixteen = 16, ten = 10;
+        Lee::DynamicMatrix<T> r = two*(a+five)%five+a/sixteen%two-ten;
+        for(size_t i = 0; i < a.size(); ++i){
+            const T x = a.data()[i];
+            assert(r.data()[i] == two*(x+five)%five+x/sixteen%two-ten && "integer % and /");
+        }
+    }
+
+    void simd(){
+        // widths 1 .. 257 cover every packet size with and without a tail; 301 x 257 is split over threads
+        for(size_t n : {1, 3, 7, 8, 15, 17, 31, 33, 64, 65, 257}){
+            elementwise_tree<double>(3, n);
+            elementwise_tree<float>(3, n);
+            elementwise_tree<int>(3, n);
+            elementwise_tree<long long>(3, n);
+            integer_tree<int>(3, n);
+            integer_tree<long long>(3, n);
+            integer_tree<short>(3, n);
+        }
+        elementwise_tree<double>(301, 257);
+        integer_tree<int>(301, 257);
+
+        // inline storage of a fixed-size Matrix
+        const Lee::Matrix<int, 3, 5> f{{-7, 3, 11, -2, 0}, {5, -13, 8, 1, -1}, {9, 4, -6, 2, 14}};
+        Lee::Matrix<int, 3, 5> g = 2*(1+2+f-1+2+3)*2/16%2+10;
+        for(size_t i = 0; i < 3; ++i)
+            for(size_t j = 0; j < 5; ++j)
+                assert(g(i, j) == 2*(1+2+f(i, j)-1+2+3)*2/16%2+10 && "fixed integer tree");
+    }
+
+    // DynamicMatrix assignments that change the shape, with the source reading the destination
+    void dynamic_assignment(){
+        Lee::DynamicMatrix<double> a = filled<double>(20, 30, 51), a0 = a;
+        const Lee::DynamicMatrix<double> b = filled<double>(30, 70, 52), c = filled<double>(90, 20, 53), d = filled<double>(30, 5, 55);
+        a = a*b;
+        assert(a.rows() == 20 && a.cols() == 70 && max_diff(a, naive_product<double>(a0, b)) < 1e-12 && "a = a*b, larger");
+        a = a0;
+        a = c*a;
+        assert(a.rows() == 90 && a.cols() == 30 && max_diff(a, naive_product<double>(c, a0)) < 1e-12 && "a = c*a, larger");
+        a = a0;
+        a = a*d;
+        assert(a.rows() == 20 && a.cols() == 5 && max_diff(a, naive_product<double>(a0, d)) < 1e-12 && "a = a*b, smaller");
+
+        a = a0;
+        a = Lee::transpose(a);
+        assert(a.rows() == 30 && a.cols() == 20 && "a = a^T, new shape");
+        for(size_t i = 0; i < 30; ++i)
+            for(size_t j = 0; j < 20; ++j)
+                assert(a(i, j) == a0(j, i) && "a = a^T");
+
+        Lee::DynamicMatrix<double> e;
+        e = a0*b;
+        assert(max_diff(e, naive_product<double>(a0, b)) < 1e-12 && "empty = a*b");
+
+        const Lee::Matrix<double, 4, 3> f = filled<double, 4, 3>(54);
+        Lee::DynamicMatrix<double> g(f), h = g*Lee::transpose(g);
+        assert(h.rows() == 4 && h.cols() == 4 && max_diff(h, naive_product<double>(f, Lee::transpose(f))) < 1e-14 && "from Matrix");
+    }
+
+}
+
+void Evaluator_Test(){
+    std::cout << "\nEvaluator Test:\n";
+    chain_order();
+    long_chain();
+    std::cout << "product chains, split order and twelve operands: ok\n";
+    products();
+    gemv();
+    aliasing();
+    std::cout << "GEMM, GEMV and aliased products, fixed and dynamic: ok\n";
+    nested_products();
+    std::cout << "product operands that contain products: ok\n";
+    transposed_products();
+    transposes();
+    std::cout << "transposed operands and transpose_copy: ok\n";
+    dynamic_assignment();
+    std::cout << "DynamicMatrix assignments that reshape: ok\n";
+    simd();
+    std::cout << "packet element-wise trees, tails and integer %: ok\n";
+}
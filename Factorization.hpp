@@ -2,111 +2,359 @@
 #define FACTORIZATION_H
 
 #include <tuple>
+#include <vector>
+#include <cmath>
 #include "Matrix.hpp"
 #include "Basic.hpp"
+#include "LU.hpp"
+#include "Cholesky.hpp"
+#include "QR.hpp"
+
+namespace MatrixImpl{
+
+    // A = L*U with L = P^T*L0 row-permuted unit lower, from the compact factorization
+    template<typename T, typename Mat> 
+    std::tuple<Mat, Mat> PLU(Mat A){
+        const size_t N = A.rows();
+        std::vector<size_t> perm(N);
+        Mat L = A;
+        L.to_zero();
+
+        if(N) lu_factor(N, &A(0, 0), N, perm.data());
+        for(size_t i = 0; i < N; ++i){
+            for(size_t j = 0; j < i; ++j){
+                L(perm[i], j) = A(i, j);
+                A(i, j) = 0;
+            }
+            L(perm[i], i) = 1;
+        }
+        return std::make_tuple(L, A);
+    }
+
+    // b = A^-1 * b, A: compact factors from lu_inplace
+    template<typename T, typename Mat, typename Vec>
+    void lu_solve(const Mat &LU, const std::vector<size_t> &perm, Vec &b){
+        if(LU.rows()) lu_solve(LU.rows(), LU.data().data(), LU.cols(), perm.data(), &b(0, 0), b.cols(), b.cols());
+    }
+
+    // dense types of the solution of A*x = b (least squares for QR), A: Mat, b: B
+    // | rhs: copy of b the solvers work in
+    template<typename Mat, typename B>
+    struct SolveResult;
+
+    template<typename T, size_t M, size_t N, typename V, size_t K, typename V1>
+    struct SolveResult<Lee::Matrix<T, M, N, V>, Lee::Matrix<T, M, K, V1>>{
+        using rhs  = Lee::Matrix<T, M, K>;
+        using type = Lee::Matrix<T, N, K>;
+
+        static type make(size_t, size_t) { return type(); }
+    };
+
+    template<typename T, typename V, typename V1>
+    struct SolveResult<Lee::DynamicMatrix<T, V>, Lee::DynamicMatrix<T, V1>>{
+        using rhs  = Lee::DynamicMatrix<T>;
+        using type = Lee::DynamicMatrix<T>;
+
+        static type make(size_t m, size_t n) { return type(m, n); }
+    };
+
+    // classical Gram-Schmidt on the columns of A, Q and R sized by the caller
+    template<typename T, typename Mat, typename MatQ, typename MatR>
+    void QRGramScmidt(const Mat &A, MatQ &Q, MatR &R){
+        const size_t M = A.rows(), N = A.cols();
+        std::vector<T> y(M);
+        T tmp;
+
+        for(size_t i = 0; i < N; ++i){
+            for(size_t k = 0; k < M; ++k) y[k] = A(k, i);
+            for(size_t j = 0; j < i; ++j){
+                tmp = 0;
+                for(size_t k = 0; k < M; ++k) tmp += Q(k, j)*A(k, i);
+                for(size_t k = 0; k < M; ++k) y[k] -= Q(k, j)*tmp;
+                R(j, i) = tmp;
+            }
+            tmp = 0;
+            for(size_t k = 0; k < M; ++k) tmp += y[k]*y[k];
+            R(i, i) = std::sqrt(tmp);
+            for(size_t k = 0; k < M; ++k) Q(k, i) = y[k]/R(i, i);
+        }
+    }
+
+    // Householder QR, Q: M x K with K = N (thin) or K = M (full), R: K x N
+    template<typename T, typename Mat, typename MatQ, typename MatR>
+    void QRHouseholder(const Mat &A, MatQ &Q, MatR &R){
+        const size_t M = A.rows(), N = A.cols(), K = Q.cols(), kn = std::min(M, N);
+        std::vector<T> a(M*N), tau(kn), q(M*K);
+
+        for(size_t i = 0; i < M; ++i)
+            for(size_t j = 0; j < N; ++j)
+                a[i*N+j] = A(i, j);
+        qr_factor(M, N, a.data(), N, tau.data());
+        qr_form_q(M, kn, a.data(), N, tau.data(), q.data(), K);
+
+        for(size_t i = 0; i < M; ++i)
+            for(size_t j = 0; j < K; ++j)
+                Q(i, j) = q[i*K+j];
+        for(size_t i = 0; i < K; ++i)
+            for(size_t j = 0; j < N; ++j)
+                R(i, j) = (i < kn && j >= i) ? a[i*N+j] : static_cast<T>(0);
+    }
+
+}   // MatrixImpl
 
 namespace Lee{
-    // If Permutation is done on A, then E is product of Es and P, so L may not be lower triangular.
-    template<typename T, int N> 
+    // A overwritten by L\U (unit diagonal of L not stored), row i of L*U is row perm[i] of A;
+    // returns the sign of the permutation, 0 when A is singular
+    template<typename T, size_t N>
+    int lu_inplace(Matrix<T, N, N> &A, std::vector<size_t> &perm){
+        perm.resize(N);
+        return N ? MatrixImpl::lu_factor(N, &A(0, 0), N, perm.data()) : 1;
+    }
+
+    template<typename T>
+    int lu_inplace(DynamicMatrix<T> &A, std::vector<size_t> &perm){
+        assert(A.rows() == A.cols() && "LU of non-square matrix");
+        perm.resize(A.rows());
+        return A.rows() ? MatrixImpl::lu_factor(A.rows(), &A(0, 0), A.rows(), perm.data()) : 1;
+    }
+
+    /* factorization objects: factor once, then solve any number of right-hand sides */
+    // PA = LU with partial pivoting, A: Matrix<T, N, N> or DynamicMatrix<T>
+    template<typename Mat>
+    class LU{
+    public:
+        using value_type = typename Mat::value_type;
+
+        explicit LU(const Mat &A) : lu(A), perm{}, sgn{lu_inplace(lu, perm)} {}
+
+        bool singular() const { return sgn == 0; }
+
+        // sign of the permutation, 0 when A is singular
+        int sign() const { return sgn; }
+
+        // L\U, the unit diagonal of L not stored
+        const Mat& factors() const { return lu; }
+
+        const std::vector<size_t>& permutation() const { return perm; }
+
+        value_type det() const{
+            value_type res = static_cast<value_type>(sgn);
+            for(size_t i = 0; i < lu.rows() && sgn; ++i)
+                res *= lu(i, i);
+            return res;
+        }
+
+        // A^-1 * b, b: one or more columns
+        template<typename B>
+        typename MatrixImpl::SolveResult<Mat, B>::type solve(const B &b) const{
+            assert(b.rows() == lu.rows() && "dimensions do not match");
+            typename MatrixImpl::SolveResult<Mat, B>::type x(b);
+
+            MatrixImpl::lu_solve<value_type>(lu, perm, x);
+            return x;
+        }
+
+        Mat inverse() const{
+            Mat res = lu;
+            res.to_eye();
+            if(!singular()) MatrixImpl::lu_solve<value_type>(lu, perm, res);
+            else res.to_zero();
+            return res;
+        }
+
+    private:
+        Mat lu;
+        std::vector<size_t> perm;
+        int sgn;
+    };
+
+    // A = L*L^T, A symmetric positive definite; only the lower triangle of A is read
+    template<typename Mat>
+    class Cholesky{
+    public:
+        using value_type = typename Mat::value_type;
+
+        explicit Cholesky(const Mat &A) : l(A), spd{false} {
+            assert(l.rows() == l.cols() && "Cholesky of non-square matrix");
+            spd = !l.rows() || MatrixImpl::chol_factor(l.rows(), &l(0, 0), l.cols());
+            for(size_t i = 0; i < l.rows(); ++i)
+                for(size_t j = i+1; j < l.cols(); ++j)
+                    l(i, j) = 0;
+        }
+
+        // false: A is not positive definite and the factor is incomplete
+        bool positive_definite() const { return spd; }
+
+        const Mat& factors() const { return l; }
+
+        template<typename B>
+        typename MatrixImpl::SolveResult<Mat, B>::type solve(const B &b) const{
+            assert(spd && "Cholesky solve with a matrix that is not positive definite");
+            assert(b.rows() == l.rows() && "dimensions do not match");
+            typename MatrixImpl::SolveResult<Mat, B>::type x(b);
+
+            if(l.rows()) MatrixImpl::chol_solve(l.rows(), l.data().data(), l.cols(), &x(0, 0), x.cols(), x.cols());
+            return x;
+        }
+
+    private:
+        Mat l;
+        bool spd;
+    };
+
+    // A = Q*R by Householder reflections, A: M x N with M >= N
+    template<typename Mat>
+    class QR{
+    public:
+        using value_type = typename Mat::value_type;
+
+        explicit QR(const Mat &A) : qr(A), tau(std::min(A.rows(), A.cols())) {
+            assert(qr.rows() >= qr.cols() && "QR needs at least as many rows as columns");
+            if(qr.size()) MatrixImpl::qr_factor(qr.rows(), qr.cols(), &qr(0, 0), qr.cols(), tau.data());
+        }
+
+        // R in the upper triangle, Householder vectors below it
+        const Mat& factors() const { return qr; }
+
+        const std::vector<value_type>& coefficients() const { return tau; }
+
+        // x minimizing |A*x-b|, A of full column rank
+        template<typename B>
+        typename MatrixImpl::SolveResult<Mat, B>::type solve(const B &b) const{
+            assert(b.rows() == qr.rows() && "dimensions do not match");
+            typedef MatrixImpl::SolveResult<Mat, B> SR;
+            typename SR::rhs y(b);
+            typename SR::type x = SR::make(qr.cols(), y.cols());
+
+            if(!qr.size()) return x;
+            MatrixImpl::qr_solve(qr.rows(), qr.cols(), qr.data().data(), qr.cols(), tau.data(), &y(0, 0), y.cols(), y.cols());
+            for(size_t i = 0; i < x.rows(); ++i)
+                for(size_t j = 0; j < x.cols(); ++j)
+                    x(i, j) = y(i, j);
+            return x;
+        }
+
+    private:
+        Mat qr;
+        std::vector<value_type> tau;
+    };
+
+    template<typename T, size_t N, typename V>
+    LU<Matrix<T, N, N>> lu(const Matrix<T, N, N, V> &A){
+        return LU<Matrix<T, N, N>>(A);
+    }
+
+    template<typename T, typename V>
+    LU<DynamicMatrix<T>> lu(const DynamicMatrix<T, V> &A){
+        return LU<DynamicMatrix<T>>(A);
+    }
+
+    template<typename T, size_t N, typename V>
+    Cholesky<Matrix<T, N, N>> cholesky(const Matrix<T, N, N, V> &A){
+        return Cholesky<Matrix<T, N, N>>(A);
+    }
+
+    template<typename T, typename V>
+    Cholesky<DynamicMatrix<T>> cholesky(const DynamicMatrix<T, V> &A){
+        return Cholesky<DynamicMatrix<T>>(A);
+    }
+
+    template<typename T, size_t M, size_t N, typename V>
+    QR<Matrix<T, M, N>> qr(const Matrix<T, M, N, V> &A){
+        return QR<Matrix<T, M, N>>(A);
+    }
+
+    template<typename T, typename V>
+    QR<DynamicMatrix<T>> qr(const DynamicMatrix<T, V> &A){
+        return QR<DynamicMatrix<T>>(A);
+    }
+
+    // lower triangle of A overwritten by L with A = L*L^T, upper triangle untouched;
+    // false when A is not positive definite
+    template<typename T, size_t N>
+    bool cholesky_inplace(Matrix<T, N, N> &A){
+        return !N || MatrixImpl::chol_factor(N, &A(0, 0), N);
+    }
+
+    template<typename T>
+    bool cholesky_inplace(DynamicMatrix<T> &A){
+        assert(A.rows() == A.cols() && "Cholesky of non-square matrix");
+        return !A.rows() || MatrixImpl::chol_factor(A.rows(), &A(0, 0), A.rows());
+    }
+
+    template<typename T, size_t N> 
     std::tuple<Matrix<T, N, N>, Matrix<T, N, N>> PLU(Matrix<T, N, N> A){
-        Matrix<T, N, N> L;
-        Matrix<T, N, N> E, tmp;
-        Matrix<T, N, N> P;
-        E.to_eye(); tmp.to_eye(); P.to_eye(); L.to_eye();
-        std::tuple<Matrix<T, N, N>, Matrix<T, N, N>> res;
-
-        for(int i = 0; i < N; ++i)          // row pos of pivots
-            for(int j = i; j < N; ++j){     // col pos of pivots 
-                if(!A(i, j)) {                         // bad pivot, do permutations
-                    for(int r = i+1; r < N; ++r){
-                        if(A(r, j)) { 
-                            P.to_eye();
-                            A.permute(r, i); 
-                            P(r, r) = 0;
-                            P(i, i) = 0;
-                            P(r, i ) = 1;
-                            P(i, r) = 1; 
-                            break;
-                        }
-                    }
-                }
-                if(A(i, j)){                    // good pivot, do forward elimination
-                    tmp.to_eye();
-                    for(int r = i+1; r < N; ++r){
-                        if(!A(r, j)) continue;
-                        T base = A(r, j)/A(i, j);           // keng!!!
-                        tmp(r, j) =  -base;             
-                        for(int c = j; c < N; ++c){
-                            A(r, c) -= (base*A(i, c));
-                        }
-                    }
-                    E = tmp*P*E;
-                    break;                              // find pivot in the next line
-                }
-                else continue;
-            }
+        return MatrixImpl::PLU<T>(A);
+    }
 
-        L = inv(E);
-        std::get<0>(res) = L;
-        std::get<1>(res) = A;
-        return res;
+    template<typename T>
+    std::tuple<DynamicMatrix<T>, DynamicMatrix<T>> PLU(DynamicMatrix<T> A){
+        assert(A.rows() == A.cols() && "PLU of non-square matrix");
+        return MatrixImpl::PLU<T>(A);
     }
 
-    template<typename T, int M, int N>
+    template<typename T, size_t M, size_t N>
     std::tuple<Matrix<T, M, N>, Matrix<T, N, N>> QRGramScmidt(Matrix<T, M, N> A){
         Matrix<T, M, N> Q;
         Matrix<T, N, N> R;
-        std::tuple<Matrix<T, M, N>, Matrix<T, N, N>> res; 
-        Matrix<T, M, 1> y;
-        double tmp;
-
-        for(int i = 0; i < N; ++i){
-            y.to_zero();
-            y = A.getcol(i);
-            for(int j = 0; j < i; ++j){
-                tmp = (transpose(Q.getcol(j))*A.getcol(i))(0, 0);
-                y -= Q.getcol(j)*(tmp);
-                R(j, i) = tmp;
-            }
-            R(i, i) = norm2(y);
-            Q.setcol(i, y/norm2(y));
-        }
 
-        std::get<0>(res) = Q;
-        std::get<1>(res) = R;
-        return res;
+        MatrixImpl::QRGramScmidt<T>(A, Q, R);
+        return std::make_tuple(Q, R);
+    }
+
+    template<typename T>
+    std::tuple<DynamicMatrix<T>, DynamicMatrix<T>> QRGramScmidt(const DynamicMatrix<T> &A){
+        DynamicMatrix<T> Q(A.rows(), A.cols());
+        DynamicMatrix<T> R(A.cols(), A.cols());
+
+        MatrixImpl::QRGramScmidt<T>(A, Q, R);
+        return std::make_tuple(Q, R);
+    }
+
+    // thin QR: Q M x N with orthonormal columns, R N x N upper triangular
+    template<typename T, size_t M, size_t N>
+    std::tuple<Matrix<T, M, N>, Matrix<T, N, N>> QRHouseholder(const Matrix<T, M, N> &A){
+        static_assert(M >= N, "thin QR needs at least as many rows as columns");
+        Matrix<T, M, N> Q;
+        Matrix<T, N, N> R;
+
+        MatrixImpl::QRHouseholder<T>(A, Q, R);
+        return std::make_tuple(Q, R);
+    }
+
+    template<typename T>
+    std::tuple<DynamicMatrix<T>, DynamicMatrix<T>> QRHouseholder(const DynamicMatrix<T> &A){
+        assert(A.rows() >= A.cols() && "thin QR needs at least as many rows as columns");
+        DynamicMatrix<T> Q(A.rows(), A.cols());
+        DynamicMatrix<T> R(A.cols(), A.cols());
+
+        MatrixImpl::QRHouseholder<T>(A, Q, R);
+        return std::make_tuple(Q, R);
     }
 
-    template<typename T, int M, int N>
-    std::tuple<Matrix<T, M, M>, Matrix<T, M, N>> QRGramScmidtex(Matrix<T, M, N> A){
+    // full QR: Q M x M orthogonal, R M x N upper triangular
+    template<typename T, size_t M, size_t N>
+    std::tuple<Matrix<T, M, M>, Matrix<T, M, N>> QRHouseholderex(const Matrix<T, M, N> &A){
         Matrix<T, M, M> Q;
         Matrix<T, M, N> R;
-        std::tuple<Matrix<T, M, M>, Matrix<T, M, N>> res; 
-        Matrix<T, M, 1> y;
-        double tmp;
-
-        Matrix<T, M, M> Aex;
-        for(int i = 0; i < N; ++i)
-            Aex.setcol(i, A.getcol(i));
-        do{
-            for(int i = N; i < M; ++i)
-                Aex.setcol(i, rand<T, M, 1>());
-        }while(rank(Aex) != M);
-
-        for(int i = 0; i < M; ++i){
-            y = Aex.getcol(i);
-            for(int j = 0; j < i; ++j){
-                tmp = (transpose(Q.getcol(j))*Aex.getcol(i))(0, 0);
-                y -= Q.getcol(j)*tmp;
-                if(i < N)R(j, i) = tmp;
-            }
-            R(i, i) = norm2(y);
-            Q.setcol(i, y/norm2(y));
-        }
 
-        std::get<0>(res) = Q;
-        std::get<1>(res) = R;
-        return res;
+        MatrixImpl::QRHouseholder<T>(A, Q, R);
+        return std::make_tuple(Q, R);
+    }
+
+    template<typename T>
+    std::tuple<DynamicMatrix<T>, DynamicMatrix<T>> QRHouseholderex(const DynamicMatrix<T> &A){
+        DynamicMatrix<T> Q(A.rows(), A.rows());
+        DynamicMatrix<T> R(A.rows(), A.cols());
+
+        MatrixImpl::QRHouseholder<T>(A, Q, R);
+        return std::make_tuple(Q, R);
+    }
+
+    // the columns past N of Q come from the Householder reflectors, no random completion
+    template<typename T, size_t M, size_t N>
+    std::tuple<Matrix<T, M, M>, Matrix<T, M, N>> QRGramScmidtex(const Matrix<T, M, N> &A){
+        return QRHouseholderex(A);
     }    
 
 }
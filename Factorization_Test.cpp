@@ -0,0 +1,247 @@
+#include <iostream>
+#include <cmath>
+#include <cassert>
+#include <tuple>
+#include "Matrix.hpp"
+#include "DynamicMatrix.hpp"
+#include "Factorization.hpp"
+
+namespace{
+
+    // entries in [-1, 1) from a fixed seed
+    template<typename Mat>
+    void fill(Mat &a, unsigned seed){
+        typedef typename Mat::value_type T;
+        for(size_t i = 0; i < a.rows(); ++i)
+            for(size_t j = 0; j < a.cols(); ++j){
+                seed = seed*1103515245u+12345u;
+                a(i, j) = static_cast<T>((seed >> 8)%1000)/500-1;
+            }
+    }
+
+    template<typename T>
+    Lee::DynamicMatrix<T> filled(size_t m, size_t n, unsigned seed){
+        Lee::DynamicMatrix<T> a(m, n);
+        fill(a, seed);
+        return a;
+    }
+
+    // max |a(i, j)-b(i, j)|, any two matrices or expressions of the same shape
+    template<typename A, typename B>
+    double max_diff(const A &a, const B &b){
+        assert(a.rows() == b.rows() && a.cols() == b.cols() && "shapes differ");
+        double d = 0;
+        for(size_t i = 0; i < a.rows(); ++i)
+            for(size_t j = 0; j < a.cols(); ++j)
+                d = std::max(d, std::abs(static_cast<double>(a(i, j))-static_cast<double>(b(i, j))));
+        return d;
+    }
+
+    // L*U = A with L row-permuted unit lower, solve and inverse, weak diagonal so rows get swapped
+    void lu_residual(size_t n){
+        Lee::DynamicMatrix<double> A = filled<double>(n, n, static_cast<unsigned>(n));
+        for(size_t i = 0; i < n; ++i) A(i, i) *= 1e-3;
+        const Lee::DynamicMatrix<double> b = filled<double>(n, 3, 5);
+
+        Lee::DynamicMatrix<double> L, U;
+        std::tie(L, U) = Lee::PLU(A);
+        assert(max_diff(L*U, A) < 1e-12*n && "L*U != A");
+        for(size_t i = 0; i < n; ++i)
+            for(size_t j = 0; j < i; ++j)
+                assert(U(i, j) == 0 && "U not upper triangular");
+
+        const Lee::LU<Lee::DynamicMatrix<double>> f = Lee::lu(A);
+        assert(!f.singular() && "LU of a regular matrix reported singular");
+        assert(max_diff(A*f.solve(b), b) < 1e-9 && "LU solve");
+        assert(max_diff(A*f.inverse(), Lee::eye<double>(n)) < 1e-9 && "LU inverse");
+    }
+
+    void lu(){
+        const size_t sizes[] = {1, 2, 5, 63, LEE_LU_BLOCKED-1, LEE_LU_BLOCKED, LEE_LU_BLOCKED+1, 2*LEE_LU_BLOCKED+7};
+        for(size_t n : sizes)
+            lu_residual(n);
+
+        // exactly singular past the blocked threshold: a zero column in the second panel
+        Lee::DynamicMatrix<double> S = filled<double>(LEE_LU_BLOCKED+5, LEE_LU_BLOCKED+5, 9);
+        for(size_t i = 0; i < S.rows(); ++i) S(i, LEE_LU_BLOCK+3) = 0;
+        assert(Lee::lu(S).singular() && Lee::lu(S).det() == 0 && "singular matrix not detected");
+    }
+
+    // P*L*U with small integer entries and a known determinant, A(0, 0) = 0 so Bareiss has to swap
+    template<typename Mat>
+    typename Mat::value_type integer_plu(Mat &A){
+        typedef typename Mat::value_type T;
+        const size_t n = A.rows();
+        Mat L = A, U = A;
+        T d = n > 1 ? -1 : 1;
+        unsigned seed = static_cast<unsigned>(n);
+        for(size_t i = 0; i < n; ++i)
+            for(size_t j = 0; j < n; ++j){
+                seed = seed*1103515245u+12345u;
+                const T r = static_cast<T>((seed >> 8)%7)-3;
+                L(i, j) = i > j && !(i == n-1 && j == 0) ? r : static_cast<T>(i == j);
+                U(i, j) = i < j ? r : static_cast<T>(0);
+            }
+        for(size_t i = 0; i < n; ++i){
+            U(i, i) = static_cast<T>(i%3 == 1 ? -2 : 1+i%2);
+            d *= U(i, i);
+        }
+        A = L*U;
+        if(n > 1) A.permute(0, n-1);
+        return d;
+    }
+
+    template<typename T>
+    void integer_det(){
+        for(size_t n = 1; n <= 9; ++n){
+            Lee::DynamicMatrix<T> A(n, n);
+            const T d = integer_plu(A);
+            assert(Lee::det(A) == d && "integer det, closed form or Bareiss");
+            if(n == 1) continue;
+            assert(A(0, 0) == 0 && "test matrix needs a row swap");
+
+            for(size_t j = 0; j < n; ++j) A(n-1, j) = A(0, j);
+            assert(Lee::det(A) == 0 && "singular integer det");
+        }
+
+        Lee::Matrix<T, 6, 6> F;
+        const T d = integer_plu(F);
+        assert(Lee::det(F) == d && "fixed-size integer det");
+    }
+
+    void det(){
+        integer_det<int>();
+        integer_det<long long>();
+
+        // floating point past the closed forms against the same construction
+        Lee::DynamicMatrix<double> A(7, 7);
+        const double d = integer_plu(A);
+        assert(std::abs(Lee::det(A)-d) < 1e-9*std::abs(d) && "floating-point det");
+    }
+
+    // B*B^T+n*I, symmetric positive definite
+    Lee::DynamicMatrix<double> spd(size_t n, unsigned seed){
+        const Lee::DynamicMatrix<double> B = filled<double>(n, n, seed);
+        Lee::DynamicMatrix<double> A = B*Lee::transpose(B);
+        for(size_t i = 0; i < n; ++i) A(i, i) += n;
+        return A;
+    }
+
+    // L*L^T = A and solve through the object; the in-place form leaves the upper triangle alone
+    void cholesky_residual(size_t n){
+        const Lee::DynamicMatrix<double> A = spd(n, static_cast<unsigned>(n)), b = filled<double>(n, 3, 7);
+
+        const Lee::Cholesky<Lee::DynamicMatrix<double>> f = Lee::cholesky(A);
+        assert(f.positive_definite() && "SPD matrix reported indefinite");
+        const Lee::DynamicMatrix<double> &L = f.factors();
+        assert(max_diff(L*Lee::transpose(L), A) < 1e-12*n*n && "L*L^T != A");
+        assert(max_diff(A*f.solve(b), b) < 1e-9 && "Cholesky solve");
+
+        Lee::DynamicMatrix<double> C = A;
+        assert(Lee::cholesky_inplace(C) && "in-place Cholesky failed");
+        for(size_t i = 0; i < n; ++i)
+            for(size_t j = 0; j < n; ++j)
+                assert(C(i, j) == (j > i ? A(i, j) : L(i, j)) && "in-place factor differs");
+    }
+
+    void cholesky(){
+        const size_t sizes[] = {1, 2, 4, 33, LEE_CHOL_BLOCKED-1, LEE_CHOL_BLOCKED, LEE_CHOL_BLOCKED+1, 2*LEE_CHOL_BLOCKED+7};
+        for(size_t n : sizes)
+            cholesky_residual(n);
+
+        // indefinite only in a trailing block
+        Lee::DynamicMatrix<double> A = spd(LEE_CHOL_BLOCKED+40, 11);
+        A(LEE_CHOL_BLOCKED+20, LEE_CHOL_BLOCKED+20) = -1;
+        assert(!Lee::cholesky(A).positive_definite() && "indefinite matrix not detected");
+    }
+
+    // thin Q*R = A, Q^T*Q = I and R upper triangular, m x n with m >= n
+    void qr_residual(size_t m, size_t n){
+        const Lee::DynamicMatrix<double> A = filled<double>(m, n, static_cast<unsigned>(m*n));
+        Lee::DynamicMatrix<double> Q, R;
+        std::tie(Q, R) = Lee::QRHouseholder(A);
+
+        assert(Q.rows() == m && Q.cols() == n && R.rows() == n && R.cols() == n && "QR shapes");
+        assert(max_diff(Q*R, A) < 1e-12*m && "Q*R != A");
+        assert(max_diff(Lee::transpose(Q)*Q, Lee::eye<double>(n)) < 1e-12*m && "Q not orthonormal");
+        for(size_t i = 0; i < n; ++i)
+            for(size_t j = 0; j < i; ++j)
+                assert(R(i, j) == 0 && "R not upper triangular");
+    }
+
+    // A*x = b through the factorization object, square A
+    void qr_solve(size_t n){
+        const Lee::DynamicMatrix<double> A = filled<double>(n, n, static_cast<unsigned>(n)), b = filled<double>(n, 2, 3);
+        const Lee::DynamicMatrix<double> x = Lee::qr(A).solve(b);
+        assert(max_diff(A*x, b) < 1e-9 && "QR solve");
+    }
+
+    // A^T*(A*x-b) = 0 and the reported residual |A*x-b|, by both methods; exact data recovered
+    void least_square_residual(size_t m, size_t n){
+        const Lee::DynamicMatrix<double> A = filled<double>(m, n, static_cast<unsigned>(m+n)), b = filled<double>(m, 1, 13);
+        const Lee::LeastSquareMethod methods[] = {Lee::LeastSquareMethod::QR, Lee::LeastSquareMethod::Cholesky};
+
+        for(Lee::LeastSquareMethod method : methods){
+            double res = -1;
+            const Lee::DynamicMatrix<double> x = Lee::least_square(A, b, method, &res);
+            const Lee::DynamicMatrix<double> r = A*x-b;
+            assert(max_diff(Lee::transpose(A)*r, Lee::DynamicMatrix<double>(n, 1, 0.0)) < 1e-9 && "normal equations");
+            double rr = 0;
+            for(size_t i = 0; i < m; ++i) rr += r(i, 0)*r(i, 0);
+            assert(std::abs(res-std::sqrt(rr)) < 1e-9 && "least squares residual");
+
+            const Lee::DynamicMatrix<double> x0 = filled<double>(n, 1, 17), b0 = A*x0;
+            assert(max_diff(Lee::least_square(A, b0, method, &res), x0) < 1e-9 && res < 1e-9 && "consistent system");
+        }
+    }
+
+    void least_squares(){
+        const size_t b = LEE_QR_BLOCK;
+        least_square_residual(1, 1);
+        least_square_residual(7, 3);
+        least_square_residual(3*b, b-1);
+        least_square_residual(2*b+5, b+1);
+        least_square_residual(300, 2*b+3);
+
+        const Lee::Matrix<double, 5, 2> A = {1, 0, 1, 1, 1, 2, 1, 3, 1, 4};
+        const Lee::Matrix<double, 5, 1> y = {1, 3, 5, 7, 9.5};
+        double res = -1;
+        const Lee::Matrix<double, 2, 1> x = Lee::least_square(A, y, Lee::LeastSquareMethod::QR, &res);
+        assert(std::abs(x(0, 0)-0.9) < 1e-12 && std::abs(x(1, 0)-2.1) < 1e-12 && "fixed-size line fit");
+        assert(std::abs(res-std::sqrt(0.1)) < 1e-12 && "fixed-size residual");
+    }
+
+    // block edges of LEE_QR_BLOCK, square and tall, plus the full Q of a fixed-size matrix
+    void qr(){
+        const size_t b = LEE_QR_BLOCK;
+        const size_t sizes[] = {1, 5, b-1, b, b+1, 2*b+3, 100};
+        for(size_t n : sizes){
+            qr_residual(n, n);
+            qr_residual(n+37, n);
+            qr_residual(3*n, n);
+            qr_solve(n);
+        }
+
+        const Lee::Matrix<double, 4, 3> A = {1, 2, 3, 4, 5, 6, 7, 8, 10, 1, 0, 1};
+        Lee::Matrix<double, 4, 4> Q;
+        Lee::Matrix<double, 4, 3> R;
+        std::tie(Q, R) = Lee::QRHouseholderex(A);
+        assert(max_diff(Q*R, A) < 1e-12 && "full Q*R != A");
+        assert(max_diff(Lee::transpose(Q)*Q, Lee::eye<double, 4>()) < 1e-12 && "full Q not orthogonal");
+    }
+
+}
+
+void Factorization_Test(){
+    std::cout << "\nFactorization Test:\n";
+    det();
+    std::cout << "det, closed forms, Bareiss for integers and pivoted LU: ok\n";
+    lu();
+    std::cout << "LU across LEE_LU_BLOCKED, solve, inverse and singular: ok\n";
+    cholesky();
+    std::cout << "Cholesky across LEE_CHOL_BLOCKED, solve and indefinite: ok\n";
+    qr();
+    std::cout << "QR across LEE_QR_BLOCK, square and tall: ok\n";
+    least_squares();
+    std::cout << "least squares by QR and Cholesky, m > n: ok\n";
+}
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include "Parallel.hpp"
+
+/*
+** Packed, cache-blocked GEMM
+** | C = alpha*A*B + beta*C
+** | A: m x k, B: k x n, both addressed through (row stride, col stride),
+** |    so transposed operands need no copy
+** | C: m x n, row-major with leading dimension ldc
+** blocking (Goto/BLIS layout)
+** | NC columns of B, KC depth and MC rows of A are packed into contiguous
+** | panels sized for L3/L2/L1; an MR x NR register tile of C is
+** | accumulated by the micro-kernel
+** | gemm_parallel splits the rows of C over threads (Parallel.hpp)
+** | panels are packed along the unit stride of the source, so A^T*B and
+** | A*B^T read memory contiguously
+** GEMV and transpose
+** | gemv: y = alpha*A*x + beta*y, dot products or column updates depending
+** |       on the layout of A; products with a vector side use it
+** | transpose_copy: blocked out-of-place transpose
+*/
+
+// products with fewer multiply-adds than this stay on the element-wise path
+#ifndef LEE_GEMM_THRESHOLD
+#define LEE_GEMM_THRESHOLD 4096
+#endif
+
+namespace MatrixImpl{
+
+    template<typename T>
+    struct GemmBlock{
+        static const size_t MR = 4;
+        static const size_t NR = 32/sizeof(T) < 4 ? 4 : 32/sizeof(T);
+        static const size_t MC = 128;
+        static const size_t KC = 256;
+        static const size_t NC = 2048;
+    };
+
+    // W-wide panels of the w x kc block X, element (i, p) at X[i*rs+p*cs], zero padded, 
+    // laid out [p][i]; the source is walked along whichever of its strides is unit
+    template<typename T>
+    void gemm_pack_panel(size_t W, size_t w, size_t kc, const T *X, size_t rs, size_t cs, T *buf){
+        if(cs == 1 && rs != 1){
+            for(size_t i = 0; i < w; ++i)
+                for(size_t p = 0; p < kc; ++p)
+                    buf[p*W+i] = X[i*rs+p];
+        }
+        else{
+            for(size_t p = 0; p < kc; ++p)
+                for(size_t i = 0; i < w; ++i)
+                    buf[p*W+i] = X[i*rs+p*cs];
+        }
+        for(size_t p = 0; p < kc; ++p)
+            for(size_t i = w; i < W; ++i)
+                buf[p*W+i] = static_cast<T>(0);
+    }
+
+    // MR-row panels of A(0:mc, 0:kc), zero padded, laid out [panel][p][i]
+    template<typename T>
+    void gemm_pack_a(size_t mc, size_t kc, const T *A, size_t rs, size_t cs, T *buf){
+        const size_t MR = GemmBlock<T>::MR;
+
+        for(size_t ir = 0; ir < mc; ir += MR, buf += MR*kc)
+            gemm_pack_panel(MR, std::min(MR, mc-ir), kc, A+ir*rs, rs, cs, buf);
+    }
+
+    // NR-column panels of B(0:kc, 0:nc), zero padded, laid out [panel][p][j]
+    template<typename T>
+    void gemm_pack_b(size_t kc, size_t nc, const T *B, size_t rs, size_t cs, T *buf){
+        const size_t NR = GemmBlock<T>::NR;
+
+        // B^T is walked like A: element (j, p) at B[j*cs+p*rs]
+        for(size_t jr = 0; jr < nc; jr += NR, buf += NR*kc)
+            gemm_pack_panel(NR, std::min(NR, nc-jr), kc, B+jr*cs, cs, rs, buf);
+    }
+
+    // C(0:mr, 0:nr) += alpha*a*b, a and b packed panels of depth kc
+    template<typename T>
+    void gemm_micro(size_t kc, T alpha, const T *a, const T *b, T *C, size_t ldc, size_t mr, size_t nr){
+        const size_t MR = GemmBlock<T>::MR;
+        const size_t NR = GemmBlock<T>::NR;
+        T ab[MR][NR];
+
+        for(size_t i = 0; i < MR; ++i)
+            for(size_t j = 0; j < NR; ++j)
+                ab[i][j] = static_cast<T>(0);
+
+        for(size_t p = 0; p < kc; ++p){
+            for(size_t i = 0; i < MR; ++i){
+                const T ai = a[i];
+                for(size_t j = 0; j < NR; ++j)
+                    ab[i][j] += ai*b[j];
+            }
+            a += MR;
+            b += NR;
+        }
+
+        for(size_t i = 0; i < mr; ++i)
+            for(size_t j = 0; j < nr; ++j)
+                C[i*ldc+j] += alpha*ab[i][j];
+    }
+
+    template<typename T>
+    void gemm(size_t m, size_t n, size_t k, T alpha, const T *A, size_t rsa, size_t csa,
+              const T *B, size_t rsb, size_t csb, T beta, T *C, size_t ldc){
+        const size_t MR = GemmBlock<T>::MR, NR = GemmBlock<T>::NR;
+        const size_t MC = GemmBlock<T>::MC, KC = GemmBlock<T>::KC, NC = GemmBlock<T>::NC;
+
+        if(beta != static_cast<T>(1))
+            for(size_t i = 0; i < m; ++i)
+                for(size_t j = 0; j < n; ++j)
+                    C[i*ldc+j] = (beta == static_cast<T>(0)) ? static_cast<T>(0) : beta*C[i*ldc+j];
+        if(alpha == static_cast<T>(0) || k == 0) return;
+
+        std::vector<T> abuf(((std::min(MC, m)+MR-1)/MR)*MR*std::min(KC, k));
+        std::vector<T> bbuf(((std::min(NC, n)+NR-1)/NR)*NR*std::min(KC, k));
+
+        for(size_t jc = 0; jc < n; jc += NC){
+            const size_t nc = std::min(NC, n-jc);
+            for(size_t pc = 0; pc < k; pc += KC){
+                const size_t kc = std::min(KC, k-pc);
+                gemm_pack_b(kc, nc, B+pc*rsb+jc*csb, rsb, csb, bbuf.data());
+
+                for(size_t ic = 0; ic < m; ic += MC){
+                    const size_t mc = std::min(MC, m-ic);
+                    gemm_pack_a(mc, kc, A+ic*rsa+pc*csa, rsa, csa, abuf.data());
+
+                    for(size_t jr = 0; jr < nc; jr += NR)
+                        for(size_t ir = 0; ir < mc; ir += MR)
+                            gemm_micro(kc, alpha, abuf.data()+ir*kc, bbuf.data()+jr*kc,
+                                       C+(ic+ir)*ldc+jc+jr, ldc, std::min(MR, mc-ir), std::min(NR, nc-jr));
+                }
+            }
+        }
+    }
+
+    template<typename T>
+    void gemm_parallel(size_t m, size_t n, size_t k, T alpha, const T *A, size_t rsa, size_t csa,
+                       const T *B, size_t rsb, size_t csb, T beta, T *C, size_t ldc){
+        parallel_rows(m, m*n, [=](size_t r0, size_t r1){
+            gemm(r1-r0, n, k, alpha, A+r0*rsa, rsa, csa, B, rsb, csb, beta, C+r0*ldc, ldc);
+        });
+    }
+
+    // y = alpha*A*x + beta*y, A: m x k addressed through (rs, cs)
+    template<typename T>
+    void gemv(size_t m, size_t k, T alpha, const T *A, size_t rs, size_t cs,
+              const T *x, size_t incx, T beta, T *y, size_t incy){
+        for(size_t i = 0; i < m; ++i)
+            y[i*incy] = (beta == static_cast<T>(0)) ? static_cast<T>(0) : beta*y[i*incy];
+        if(alpha == static_cast<T>(0)) return;
+
+        // rows of A contiguous: one dot product per element of y
+        if(cs == 1 || rs != 1){
+            for(size_t i = 0; i < m; ++i){
+                const T *a = A+i*rs;
+                T acc = static_cast<T>(0);
+                for(size_t p = 0; p < k; ++p)
+                    acc += a[p*cs]*x[p*incx];
+                y[i*incy] += alpha*acc;
+            }
+        }
+        // columns of A contiguous (A^T of a row-major matrix): y += x[p]*A(:, p)
+        else{
+            for(size_t p = 0; p < k; ++p){
+                const T *a = A+p*cs;
+                const T xp = alpha*x[p*incx];
+                for(size_t i = 0; i < m; ++i)
+                    y[i*incy] += xp*a[i];
+            }
+        }
+    }
+
+    template<typename T>
+    void gemv_parallel(size_t m, size_t k, T alpha, const T *A, size_t rs, size_t cs,
+                       const T *x, size_t incx, T beta, T *y, size_t incy){
+        parallel_rows(m, m*k, [=](size_t r0, size_t r1){
+            gemv(r1-r0, k, alpha, A+r0*rs, rs, cs, x, incx, beta, y+r0*incy, incy);
+        });
+    }
+
+    // C = A*B, picking GEMV when either side is a vector
+    template<typename T>
+    void product_parallel(size_t m, size_t n, size_t k, const T *A, size_t rsa, size_t csa,
+                          const T *B, size_t rsb, size_t csb, T *C){
+        const T one = static_cast<T>(1), zero = static_cast<T>(0);
+
+        if(n == 1)      gemv_parallel(m, k, one, A, rsa, csa, B, rsb, zero, C, 1);
+        else if(m == 1) gemv_parallel(n, k, one, B, csb, rsb, A, csa, zero, C, 1);
+        else            gemm_parallel(m, n, k, one, A, rsa, csa, B, rsb, csb, zero, C, n);
+    }
+
+    // B(c x r) = A(r x c)^T, both row-major, in square tiles
+    template<typename T>
+    void transpose_copy(size_t r, size_t c, const T *A, T *B){
+        const size_t TB = 32;
+
+        parallel_rows(c, r*c, [=](size_t c0, size_t c1){
+            for(size_t ib = 0; ib < r; ib += TB)
+                for(size_t jb = c0; jb < c1; jb += TB)
+                    for(size_t j = jb; j < std::min(c1, jb+TB); ++j)
+                        for(size_t i = ib; i < std::min(r, ib+TB); ++i)
+                            B[j*r+i] = A[i*c+j];
+        });
+    }
+
+}   // MatrixImpl
@@ -0,0 +1,528 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <complex>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <tuple>
+#include "Matrix.hpp"
+#include "DynamicMatrix.hpp"
+#include "Gemm.hpp"
+#include "QR.hpp"
+#include "SymmetricEigen.hpp"
+#include "Monitor.hpp"
+
+/*
+** All eigenvalues (and eigenvectors) of a dense general matrix, conjugate pairs included
+** | eigen(A, result)         (w n x 1 complex, V n x n complex, column j the unit eigenvector of w(j))
+** | eigenvalues(A, result)   w alone: neither Q nor the Schur form off the active block is updated
+** | result (Monitor.hpp)     QR sweeps, and converged = false when a block needed more than 30 per row;
+** |                          residual: largest relative subdiagonal of that block
+** | hessenberg_reduce(n, a, lda, tau)
+** |                          Q^T*A*Q = H upper Hessenberg, reflectors below the subdiagonal
+** | hessenberg_form_q(n, a, lda, tau, q)
+** | real_schur(n, h, ldh, wantt, z, ldz, wr, wi, aed)
+** |                          Francis double-shift QR, H = Z*T*Z^T with T quasi-triangular when wantt;
+** |                          eigenvalues in diagonal order, a complex pair positive imaginary part first;
+** |                          returns the sweeps taken
+** aggressive early deflation
+** | active blocks of LEE_AED_MIN rows or more first look at a trailing window: its Schur form is
+** | computed separately and every bottom eigenvalue whose spike entry is negligible deflates at once,
+** | long before the subdiagonal would have converged; the window is reduced to Hessenberg form again
+** all matrices row-major
+*/
+
+#ifndef LEE_AED_MIN
+#define LEE_AED_MIN 75
+#endif
+
+namespace MatrixImpl{
+
+    template<typename T>
+    void hessenberg_reduce(size_t n, T *a, size_t lda, T *tau){
+        std::vector<T> v(n), w(n), y(n);
+        std::fill(tau, tau+n, static_cast<T>(0));
+
+        for(size_t c = 0; c+2 < n; ++c){
+            const size_t len = n-c-1;
+            T *x = a+(c+1)*lda+c;
+            const T beta = householder(len, x, lda, tau[c]);
+            if(tau[c] == static_cast<T>(0)) continue;
+            v[0] = static_cast<T>(1);
+            for(size_t j = 1; j < len; ++j)
+                v[j] = x[j*lda];
+
+            // A(c+1:n, c+1:n) -= tau*v*(v^T*A), A(0:n, c+1:n) -= tau*(A*v)*v^T
+            T *a22 = a+(c+1)*lda+c+1;
+            gemv(len, len, static_cast<T>(1), a22, 1, lda, v.data(), 1, static_cast<T>(0), w.data(), 1);
+            for(size_t r = 0; r < len; ++r){
+                const T s = tau[c]*v[r];
+                for(size_t j = 0; j < len; ++j)
+                    a22[r*lda+j] -= s*w[j];
+            }
+            gemv_parallel(n, len, static_cast<T>(1), a+c+1, lda, 1, v.data(), 1, static_cast<T>(0), y.data(), 1);
+            for(size_t r = 0; r < n; ++r){
+                const T s = tau[c]*y[r];
+                for(size_t j = 0; j < len; ++j)
+                    a[r*lda+c+1+j] -= s*v[j];
+            }
+            x[0] = beta;
+        }
+    }
+
+    template<typename T>
+    void hessenberg_form_q(size_t n, const T *a, size_t lda, const T *tau, T *q){
+        std::fill(q, q+n*n, static_cast<T>(0));
+        if(n == 0) return;
+        q[0] = static_cast<T>(1);
+        if(n == 1) return;
+
+        std::vector<T> q1((n-1)*(n-1));
+        qr_form_q(n-1, n-1, a+lda, lda, tau, q1.data(), n-1);
+        for(size_t i = 0; i+1 < n; ++i)
+            std::copy(q1.begin()+i*(n-1), q1.begin()+(i+1)*(n-1), q+(i+1)*n+1);
+    }
+
+    // the converged 2 x 2 block at rows p, p+1; with real eigenvalues it is rotated to upper triangular
+    template<typename T>
+    void schur_block(size_t n, T *h, size_t ldh, bool wantt, T *z, size_t ldz, size_t p, T *wr, T *wi){
+        const T a = h[p*ldh+p], b = h[p*ldh+p+1], c = h[(p+1)*ldh+p], d = h[(p+1)*ldh+p+1];
+        const T half = (a+d)/2, disc = (a-d)*(a-d)/4+b*c;
+        if(disc < static_cast<T>(0)){
+            wr[p] = wr[p+1] = half;
+            wi[p] = std::sqrt(-disc);
+            wi[p+1] = -wi[p];
+            return;
+        }
+
+        const T s = std::sqrt(disc), l1 = half+(half >= 0 ? s : -s);
+        wi[p] = wi[p+1] = static_cast<T>(0);
+        if(!wantt && !z){
+            wr[p] = l1;
+            wr[p+1] = l1 != static_cast<T>(0) ? (a*d-b*c)/l1 : half-s;
+            return;
+        }
+
+        // first column of the rotation: an eigenvector of l1
+        T v0 = b, v1 = l1-a;
+        if(std::abs(l1-d)+std::abs(c) > std::abs(v0)+std::abs(v1)) { v0 = l1-d; v1 = c; }
+        const T r = std::hypot(v0, v1);
+        const T cs = r != static_cast<T>(0) ? v0/r : static_cast<T>(1), sn = r != static_cast<T>(0) ? v1/r : static_cast<T>(0);
+        for(size_t j = p; j < (wantt ? n : p+2); ++j){
+            const T x = h[p*ldh+j], y = h[(p+1)*ldh+j];
+            h[p*ldh+j]     =  cs*x+sn*y;
+            h[(p+1)*ldh+j] = -sn*x+cs*y;
+        }
+        for(size_t i = wantt ? 0 : p; i < p+2; ++i){
+            const T x = h[i*ldh+p], y = h[i*ldh+p+1];
+            h[i*ldh+p]   =  cs*x+sn*y;
+            h[i*ldh+p+1] = -sn*x+cs*y;
+        }
+        if(z)
+            for(size_t i = 0; i < n; ++i){
+                const T x = z[i*ldz+p], y = z[i*ldz+p+1];
+                z[i*ldz+p]   =  cs*x+sn*y;
+                z[i*ldz+p+1] = -sn*x+cs*y;
+            }
+        h[(p+1)*ldh+p] = static_cast<T>(0);
+        wr[p] = h[p*ldh+p];
+        wr[p+1] = h[(p+1)*ldh+p+1];
+    }
+
+    template<typename T>
+    Lee::SolverResult<T> real_schur(size_t n, T *h, size_t ldh, bool wantt, T *z, size_t ldz, T *wr, T *wi, bool aed);
+
+    // rows and columns kw..i of H (and Z) by the window transformation u, rows above from lo
+    template<typename T>
+    void apply_window(size_t n, T *h, size_t ldh, bool wantt, T *z, size_t ldz, size_t lo, size_t kw, size_t nw, const T *u){
+        const T one = static_cast<T>(1), zero = static_cast<T>(0);
+        const size_t i1 = kw+nw, right = wantt ? n-i1 : 0;
+        std::vector<T> tmp(std::max(n*nw, nw*right));
+        if(kw > lo){
+            gemm_parallel(kw-lo, nw, nw, one, h+lo*ldh+kw, ldh, 1, u, nw, 1, zero, tmp.data(), nw);
+            for(size_t r = lo; r < kw; ++r)
+                std::copy(tmp.begin()+(r-lo)*nw, tmp.begin()+(r-lo+1)*nw, h+r*ldh+kw);
+        }
+        if(right){
+            gemm_parallel(nw, right, nw, one, u, 1, nw, h+kw*ldh+i1, ldh, 1, zero, tmp.data(), right);
+            for(size_t r = 0; r < nw; ++r)
+                std::copy(tmp.begin()+r*right, tmp.begin()+(r+1)*right, h+(kw+r)*ldh+i1);
+        }
+        if(z){
+            gemm_parallel(n, nw, nw, one, z+kw, ldz, 1, u, nw, 1, zero, tmp.data(), nw);
+            for(size_t r = 0; r < n; ++r)
+                std::copy(tmp.begin()+r*nw, tmp.begin()+(r+1)*nw, z+r*ldz+kw);
+        }
+    }
+
+    // aggressive early deflation on the active block l..i; returns the eigenvalues deflated and,
+    // when they are too few to be worth a new window, the undeflated Ritz values as shifts
+    template<typename T>
+    size_t aggressive_deflation(size_t n, T *h, size_t ldh, bool wantt, T *z, size_t ldz, size_t l, size_t i,
+                                std::vector<T> &shifts){
+        const T eps = std::numeric_limits<T>::epsilon(), tiny = std::numeric_limits<T>::min()/eps;
+        const size_t nw = std::min(i-l, std::max<size_t>(10, (i-l+1)/8)), kw = i+1-nw;
+        std::vector<T> t(nw*nw, static_cast<T>(0)), u(nw*nw, static_cast<T>(0)), wr(nw), wi(nw), s(nw);
+        for(size_t r = 0; r < nw; ++r){
+            for(size_t c = r ? r-1 : 0; c < nw; ++c)
+                t[r*nw+c] = h[(kw+r)*ldh+kw+c];
+            u[r*nw+r] = static_cast<T>(1);
+        }
+        if(!real_schur(nw, t.data(), nw, true, u.data(), nw, wr.data(), wi.data(), false).converged) return 0;
+
+        // spike H(kw, kw-1)*U(0, :)^T, negligible entries deflate from the bottom up
+        for(size_t j = 0; j < nw; ++j)
+            s[j] = h[kw*ldh+kw-1]*u[j];
+        size_t ns = nw;
+        while(ns > 0){
+            const size_t bs = (ns >= 2 && t[(ns-1)*nw+ns-2] != static_cast<T>(0)) ? 2 : 1;
+            const T mag = std::hypot(wr[ns-1], wi[ns-1]);
+            T sp = std::abs(s[ns-1]);
+            if(bs == 2) sp = std::max(sp, std::abs(s[ns-2]));
+            if(sp > std::max(eps*mag, tiny)) break;
+            ns -= bs;
+        }
+        // pairs of Ritz values, conjugate or real, bottom first, for double-shift sweeps
+        if(7*(nw-ns) < nw){
+            T real = 0;
+            bool odd = false;
+            for(size_t k = 0; k < ns; ++k){
+                if(wi[k] != static_cast<T>(0)){
+                    shifts.push_back(wr[k]);
+                    shifts.push_back(wr[k]);
+                    shifts.push_back(-wi[k]*wi[k]);
+                    ++k;
+                }
+                else if(odd){
+                    shifts.push_back(real);
+                    shifts.push_back(wr[k]);
+                    shifts.push_back(static_cast<T>(0));
+                    odd = false;
+                }
+                else { real = wr[k]; odd = true; }
+            }
+        }
+        if(ns == nw) return 0;
+        std::fill(s.begin()+ns, s.end(), static_cast<T>(0));
+
+        // the spike back to a multiple of e_0 and the undeflated part back to Hessenberg form
+        if(ns > 1){
+            T tau;
+            const T beta = householder(ns, s.data(), 1, tau);
+            s[0] = static_cast<T>(1);
+            if(tau != static_cast<T>(0)){
+                for(size_t c = 0; c < nw; ++c){
+                    T w = 0;
+                    for(size_t r = 0; r < ns; ++r)
+                        w += s[r]*t[r*nw+c];
+                    for(size_t r = 0; r < ns; ++r)
+                        t[r*nw+c] -= tau*w*s[r];
+                }
+                for(size_t r = 0; r < nw; ++r){
+                    T w = 0, x = 0;
+                    for(size_t c = 0; c < ns; ++c){
+                        w += t[r*nw+c]*s[c];
+                        x += u[r*nw+c]*s[c];
+                    }
+                    for(size_t c = 0; c < ns; ++c){
+                        t[r*nw+c] -= tau*w*s[c];
+                        u[r*nw+c] -= tau*x*s[c];
+                    }
+                }
+            }
+            std::fill(s.begin(), s.end(), static_cast<T>(0));
+            s[0] = beta;
+
+            std::vector<T> tq(ns), q(ns*ns), tmp(nw*std::max(ns, nw));
+            hessenberg_reduce(ns, t.data(), nw, tq.data());
+            hessenberg_form_q(ns, t.data(), nw, tq.data(), q.data());
+            for(size_t r = 2; r < ns; ++r)
+                std::fill(t.begin()+r*nw, t.begin()+r*nw+r-1, static_cast<T>(0));
+            const T one = static_cast<T>(1), zero = static_cast<T>(0);
+            if(nw > ns){
+                gemm(ns, nw-ns, ns, one, q.data(), 1, ns, t.data()+ns, nw, 1, zero, tmp.data(), nw-ns);
+                for(size_t r = 0; r < ns; ++r)
+                    std::copy(tmp.begin()+r*(nw-ns), tmp.begin()+(r+1)*(nw-ns), t.begin()+r*nw+ns);
+            }
+            gemm(nw, ns, ns, one, u.data(), nw, 1, q.data(), ns, 1, zero, tmp.data(), ns);
+            for(size_t r = 0; r < nw; ++r)
+                std::copy(tmp.begin()+r*ns, tmp.begin()+(r+1)*ns, u.begin()+r*nw);
+        }
+
+        for(size_t r = 0; r < nw; ++r){
+            std::copy(t.begin()+r*nw, t.begin()+(r+1)*nw, h+(kw+r)*ldh+kw);
+            h[(kw+r)*ldh+kw-1] = s[r];
+        }
+        apply_window(n, h, ldh, wantt, z, ldz, wantt ? 0 : l, kw, nw, u.data());
+        return nw-ns;
+    }
+
+    // one Francis double-shift sweep on the active block l..i, shifts the roots of x^2-(a+b)*x+a*b-w
+    template<typename T>
+    void francis_sweep(size_t n, T *h, size_t ldh, bool wantt, T *z, size_t ldz, size_t l, size_t i, T a, T b, T w){
+        const T eps = std::numeric_limits<T>::epsilon();
+
+        // start the bulge where two consecutive subdiagonal entries are small
+        size_t m = i-2;
+        T p, q, r, x, y;
+        for(;;){
+            const T zz = h[m*ldh+m], rr = a-zz, ss = b-zz;
+            p = (rr*ss-w)/h[(m+1)*ldh+m]+h[m*ldh+m+1];
+            q = h[(m+1)*ldh+m+1]-zz-rr-ss;
+            r = h[(m+2)*ldh+m+1];
+            const T s = std::abs(p)+std::abs(q)+std::abs(r);
+            if(s == static_cast<T>(0)) return;
+            p /= s; q /= s; r /= s;
+            if(m == l) break;
+            const T u = std::abs(h[m*ldh+m-1])*(std::abs(q)+std::abs(r));
+            const T v = std::abs(p)*(std::abs(h[(m-1)*ldh+m-1])+std::abs(zz)+std::abs(h[(m+1)*ldh+m+1]));
+            if(u <= eps*v) break;
+            --m;
+        }
+
+        // chase the bulge with 3 x 3 reflectors
+        const size_t jend = wantt ? n : i+1, istart = wantt ? 0 : l;
+        for(size_t k = m; k < i; ++k){
+            const bool last = k+1 == i;
+            if(k != m){
+                p = h[k*ldh+k-1];
+                q = h[(k+1)*ldh+k-1];
+                r = last ? static_cast<T>(0) : h[(k+2)*ldh+k-1];
+                x = std::abs(p)+std::abs(q)+std::abs(r);
+                if(x == static_cast<T>(0)) continue;
+                p /= x; q /= x; r /= x;
+            }
+            T s = std::sqrt(p*p+q*q+r*r);
+            if(p < 0) s = -s;
+            if(k == m){
+                if(l != m) h[k*ldh+k-1] = -h[k*ldh+k-1];
+            }
+            else{
+                h[k*ldh+k-1] = -s*x;
+                h[(k+1)*ldh+k-1] = static_cast<T>(0);
+                if(!last) h[(k+2)*ldh+k-1] = static_cast<T>(0);
+            }
+            p += s;
+            x = p/s;
+            y = q/s;
+            const T zz = r/s;
+            q /= p;
+            r /= p;
+            for(size_t j = k; j < jend; ++j){
+                T t = h[k*ldh+j]+q*h[(k+1)*ldh+j];
+                if(!last) { t += r*h[(k+2)*ldh+j]; h[(k+2)*ldh+j] -= t*zz; }
+                h[(k+1)*ldh+j] -= t*y;
+                h[k*ldh+j] -= t*x;
+            }
+            for(size_t ii = istart; ii <= std::min(i, k+3); ++ii){
+                T t = x*h[ii*ldh+k]+y*h[ii*ldh+k+1];
+                if(!last) { t += zz*h[ii*ldh+k+2]; h[ii*ldh+k+2] -= t*r; }
+                h[ii*ldh+k+1] -= t*q;
+                h[ii*ldh+k] -= t;
+            }
+            if(z)
+                for(size_t ii = 0; ii < n; ++ii){
+                    T t = x*z[ii*ldz+k]+y*z[ii*ldz+k+1];
+                    if(!last) { t += zz*z[ii*ldz+k+2]; z[ii*ldz+k+2] -= t*r; }
+                    z[ii*ldz+k+1] -= t*q;
+                    z[ii*ldz+k] -= t;
+                }
+        }
+    }
+
+    template<typename T>
+    Lee::SolverResult<T> real_schur(size_t n, T *h, size_t ldh, bool wantt, T *z, size_t ldz, T *wr, T *wi, bool aed){
+        const T eps = std::numeric_limits<T>::epsilon();
+        Lee::SolverResult<T> res{true, 0, static_cast<T>(0)};
+        T anorm = 0;
+        for(size_t r = 0; r < n; ++r)
+            for(size_t c = r ? r-1 : 0; c < n; ++c)
+                anorm = std::max(anorm, std::abs(h[r*ldh+c]));
+
+        // shifts left over from the last deflation window, (a, b, w) as for francis_sweep
+        std::vector<T> shifts;
+        size_t e = n, its = 0;
+        while(e > 0){
+            const size_t i = e-1;
+            size_t l = i;
+            for(; l > 0; --l){
+                T s = std::abs(h[(l-1)*ldh+l-1])+std::abs(h[l*ldh+l]);
+                if(s == static_cast<T>(0)) s = anorm;
+                if(std::abs(h[l*ldh+l-1]) <= eps*s) { h[l*ldh+l-1] = static_cast<T>(0); break; }
+            }
+            if(l == i) { wr[i] = h[i*ldh+i]; wi[i] = static_cast<T>(0); e = i; its = 0; continue; }
+            if(l+1 == i) { schur_block(n, h, ldh, wantt, z, ldz, l, wr, wi); e = l; its = 0; continue; }
+            if(++its > 30*std::max<size_t>(10, i-l+1)){
+                res.converged = false;
+                for(size_t r = l+1; r <= i; ++r){
+                    const T s = std::abs(h[(r-1)*ldh+r-1])+std::abs(h[r*ldh+r]);
+                    res.residual = std::max(res.residual, std::abs(h[r*ldh+r-1])/(s == static_cast<T>(0) ? anorm : s));
+                }
+                return res;
+            }
+            ++res.iterations;
+
+            // an exceptional shift every tenth step breaks cycles the others fall into
+            if(its%10 == 0){
+                const T s = std::abs(h[i*ldh+i-1])+std::abs(h[(i-1)*ldh+i-2]);
+                shifts.clear();
+                francis_sweep(n, h, ldh, wantt, z, ldz, l, i, h[i*ldh+i]+static_cast<T>(0.75)*s,
+                              h[i*ldh+i]+static_cast<T>(0.75)*s, static_cast<T>(-0.4375)*s*s);
+                continue;
+            }
+            if(shifts.empty() && aed && i-l+1 >= LEE_AED_MIN && aggressive_deflation(n, h, ldh, wantt, z, ldz, l, i, shifts)){
+                its = 0;
+                continue;
+            }
+            if(!shifts.empty()){
+                const size_t k = shifts.size()-3;
+                francis_sweep(n, h, ldh, wantt, z, ldz, l, i, shifts[k], shifts[k+1], shifts[k+2]);
+                shifts.resize(k);
+                continue;
+            }
+
+            // the eigenvalues of the trailing 2 x 2
+            const T a = h[i*ldh+i], b = h[(i-1)*ldh+i-1], w = h[i*ldh+i-1]*h[(i-1)*ldh+i];
+            francis_sweep(n, h, ldh, wantt, z, ldz, l, i, a, b, w);
+        }
+        return res;
+    }
+
+    // v (n x n): column k the unit eigenvector of wr[k]+i*wi[k], from the real Schur form t and its vectors z
+    template<typename T>
+    void schur_eigenvectors(size_t n, const T *t, const T *z, const T *wr, const T *wi, std::complex<T> *v){
+        typedef std::complex<T> C;
+        const T eps = std::numeric_limits<T>::epsilon();
+        T tnorm = 0;
+        for(size_t i = 0; i < n*n; ++i)
+            tnorm = std::max(tnorm, std::abs(t[i]));
+        const T small = std::max(eps*tnorm, std::numeric_limits<T>::min());
+        std::vector<T> xr(n*n, static_cast<T>(0)), xi(n*n, static_cast<T>(0));
+        std::vector<C> x(n);
+
+        for(size_t k = 0; k < n; ++k){
+            if(wi[k] < static_cast<T>(0)) continue;
+            const C lambda(wr[k], wi[k]);
+            std::fill(x.begin(), x.end(), C(0));
+            size_t end = k;
+            if(wi[k] == static_cast<T>(0)) x[k] = C(1);
+            else{
+                // null vector of the 2 x 2 block at rows k, k+1
+                end = k+1;
+                x[k] = C(t[k*n+k+1]);
+                x[k+1] = lambda-t[k*n+k];
+                if(std::abs(x[k])+std::abs(x[k+1]) < small) { x[k] = lambda-t[(k+1)*n+k+1]; x[k+1] = C(t[(k+1)*n+k]); }
+            }
+
+            for(size_t r = k; r-- > 0; ){
+                C b1 = 0;
+                for(size_t j = r+1; j <= end; ++j)
+                    b1 -= t[r*n+j]*x[j];
+                if(r > 0 && t[r*n+r-1] != static_cast<T>(0)){
+                    C b0 = 0;
+                    for(size_t j = r+1; j <= end; ++j)
+                        b0 -= t[(r-1)*n+j]*x[j];
+                    const C a00 = t[(r-1)*n+r-1]-lambda, a01 = t[(r-1)*n+r], a10 = t[r*n+r-1], a11 = t[r*n+r]-lambda;
+                    C det = a00*a11-a01*a10;
+                    if(std::abs(det) < small*small) det = C(small*small);
+                    x[r-1] = (b0*a11-a01*b1)/det;
+                    x[r] = (a00*b1-a10*b0)/det;
+                    --r;
+                }
+                else{
+                    C den = t[r*n+r]-lambda;
+                    if(std::abs(den) < small) den = C(small);
+                    x[r] = b1/den;
+                }
+            }
+            for(size_t r = 0; r <= end; ++r){
+                xr[r*n+k] = x[r].real();
+                xi[r*n+k] = x[r].imag();
+            }
+        }
+
+        std::vector<T> vr(n*n), vi(n*n);
+        gemm_parallel(n, n, n, static_cast<T>(1), z, n, 1, xr.data(), n, 1, static_cast<T>(0), vr.data(), n);
+        gemm_parallel(n, n, n, static_cast<T>(1), z, n, 1, xi.data(), n, 1, static_cast<T>(0), vi.data(), n);
+        for(size_t k = 0; k < n; ++k){
+            const size_t src = wi[k] < static_cast<T>(0) ? k-1 : k;
+            const T sign = wi[k] < static_cast<T>(0) ? static_cast<T>(-1) : static_cast<T>(1);
+            T len = 0;
+            for(size_t r = 0; r < n; ++r)
+                len += vr[r*n+src]*vr[r*n+src]+vi[r*n+src]*vi[r*n+src];
+            len = std::sqrt(len);
+            for(size_t r = 0; r < n; ++r)
+                v[r*n+k] = C(vr[r*n+src], sign*vi[r*n+src])/len;
+        }
+    }
+
+    // w eigenvalues; v (n x n) the eigenvectors as columns unless nullptr; a destroyed
+    template<typename T>
+    Lee::SolverResult<T> general_eigen(size_t n, T *a, size_t lda, std::complex<T> *w, std::complex<T> *v){
+        std::vector<T> tau(n), wr(n), wi(n), z(v ? n*n : 0);
+        hessenberg_reduce(n, a, lda, tau.data());
+        if(v) hessenberg_form_q(n, a, lda, tau.data(), z.data());
+        for(size_t r = 2; r < n; ++r)
+            std::fill(a+r*lda, a+r*lda+r-1, static_cast<T>(0));
+
+        const Lee::SolverResult<T> res = real_schur(n, a, lda, v != nullptr, v ? z.data() : static_cast<T*>(nullptr), n, wr.data(), wi.data(), true);
+        for(size_t k = 0; k < n; ++k)
+            w[k] = std::complex<T>(wr[k], wi[k]);
+        if(v){
+            std::vector<T> t(n*n);
+            for(size_t r = 0; r < n; ++r)
+                for(size_t c = 0; c < n; ++c)
+                    t[r*n+c] = c+1 >= r ? a[r*lda+c] : static_cast<T>(0);
+            schur_eigenvectors(n, t.data(), z.data(), wr.data(), wi.data(), v);
+        }
+        return res;
+    }
+
+}   // MatrixImpl
+
+namespace Lee{
+
+    template<typename T, size_t N, typename V>
+    std::tuple<Matrix<std::complex<T>, N, 1>, Matrix<std::complex<T>, N, N>> eigen(const Matrix<T, N, N, V> &A,
+                                                                                    SolverResult<T> *result = nullptr){
+        Matrix<T, N, N> a(A);
+        Matrix<std::complex<T>, N, 1> w;
+        Matrix<std::complex<T>, N, N> v;
+        MatrixImpl::solver_result(result, MatrixImpl::general_eigen(N, &a(0, 0), N, &w(0, 0), &v(0, 0)));
+        return std::make_tuple(w, v);
+    }
+
+    template<typename T, typename V>
+    std::tuple<DynamicMatrix<std::complex<T>>, DynamicMatrix<std::complex<T>>> eigen(const DynamicMatrix<T, V> &A,
+                                                                                     SolverResult<T> *result = nullptr){
+        assert(A.rows() == A.cols() && "matrix is not square");
+        const size_t n = A.rows();
+        DynamicMatrix<T> a(A);
+        DynamicMatrix<std::complex<T>> w(n, 1), v(n, n);
+        MatrixImpl::solver_result(result, n ? MatrixImpl::general_eigen(n, &a(0, 0), n, &w(0, 0), &v(0, 0))
+                                            : SolverResult<T>{true, 0, static_cast<T>(0)});
+        return std::make_tuple(w, v);
+    }
+
+    template<typename T, size_t N, typename V>
+    Matrix<std::complex<T>, N, 1> eigenvalues(const Matrix<T, N, N, V> &A, SolverResult<T> *result = nullptr){
+        Matrix<T, N, N> a(A);
+        Matrix<std::complex<T>, N, 1> w;
+        MatrixImpl::solver_result(result, MatrixImpl::general_eigen(N, &a(0, 0), N, &w(0, 0), static_cast<std::complex<T>*>(nullptr)));
+        return w;
+    }
+
+    template<typename T, typename V>
+    DynamicMatrix<std::complex<T>> eigenvalues(const DynamicMatrix<T, V> &A, SolverResult<T> *result = nullptr){
+        assert(A.rows() == A.cols() && "matrix is not square");
+        const size_t n = A.rows();
+        DynamicMatrix<T> a(A);
+        DynamicMatrix<std::complex<T>> w(n, 1);
+        MatrixImpl::solver_result(result, n ? MatrixImpl::general_eigen(n, &a(0, 0), n, &w(0, 0), static_cast<std::complex<T>*>(nullptr))
+                                            : SolverResult<T>{true, 0, static_cast<T>(0)});
+        return w;
+    }
+
+}   // Lee
@@ -0,0 +1,370 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <cassert>
+#include "Matrix.hpp"
+#include "DynamicMatrix.hpp"
+#include "Sparse.hpp"
+#include "LinearOperator.hpp"
+#include "Monitor.hpp"
+
+/*
+** Preconditioned Krylov solvers for A*x = b
+** | conjugate_gradient(A, b, x0, tol, max_iter, M, result, monitor)     A symmetric positive definite
+** | bicgstab(A, b, x0, tol, max_iter, M, result, monitor)               A general
+** | gmres(A, b, x0, tol, restart, max_iter, M, result, monitor)         A general, restarted every restart steps
+** A: any operator of LinearOperator.hpp; b, x0: Matrix<T, N, 1> or DynamicMatrix<T>
+** iterations stop once ||b-A*x||_2 <= tol, as for DirectJacobi; result and monitor as in Monitor.hpp
+** preconditioners, M ~ A^-1 applied by M.apply(n, r, z)
+** | IdentityPreconditioner<T>()          the default
+** | JacobiPreconditioner<T>(A)           inverse of diag(A)
+** | ILU0Preconditioner<T>(A)             incomplete LU on the sparsity of A
+** | IC0Preconditioner<T>(A)              incomplete Cholesky on the lower triangle of A
+** all work vectors are allocated before the first iteration
+*/
+
+namespace MatrixImpl{
+
+    template<typename T>
+    inline T krylov_dot(size_t n, const T *x, const T *y){
+        T s = 0;
+        for(size_t i = 0; i < n; ++i)
+            s += x[i]*y[i];
+        return s;
+    }
+
+    // y += a*x
+    template<typename T>
+    inline void krylov_axpy(size_t n, T a, const T *x, T *y){
+        for(size_t i = 0; i < n; ++i)
+            y[i] += a*x[i];
+    }
+
+    template<typename T, typename Op, typename P, typename Mon>
+    Lee::SolverResult<T> conjugate_gradient(size_t n, const Op &A, const T *b, T *x, T tol, size_t max_iter, const P &M, Mon &monitor){
+        SolverClockFor<Mon> clock;
+        std::vector<T> r(n), z(n), p(n), q(n);
+        T res = operator_residual(n, A, b, x, r.data());
+        M.apply(n, r.data(), z.data());
+        std::copy(z.begin(), z.end(), p.begin());
+        T rz = krylov_dot(n, r.data(), z.data());
+
+        size_t k = 0;
+        for(; k < max_iter && res > tol; ++k){
+            operator_apply(A, p.data(), q.data());
+            const T alpha = rz/krylov_dot(n, p.data(), q.data());
+            krylov_axpy(n, alpha, p.data(), x);
+            krylov_axpy(n, -alpha, q.data(), r.data());
+            res = std::sqrt(krylov_dot(n, r.data(), r.data()));
+
+            M.apply(n, r.data(), z.data());
+            const T rz1 = krylov_dot(n, r.data(), z.data());
+            const T beta = rz1/rz;
+            for(size_t i = 0; i < n; ++i)
+                p[i] = z[i]+beta*p[i];
+            rz = rz1;
+            monitor(k+1, res, clock.elapsed());
+        }
+        return Lee::SolverResult<T>{res <= tol, k, res};
+    }
+
+    // right preconditioned: A*M*y = b, x = M*y
+    template<typename T, typename Op, typename P, typename Mon>
+    Lee::SolverResult<T> bicgstab(size_t n, const Op &A, const T *b, T *x, T tol, size_t max_iter, const P &M, Mon &monitor){
+        SolverClockFor<Mon> clock;
+        std::vector<T> r(n), rh(n), p(n), v(n), ph(n), s(n), sh(n), t(n);
+        T res, rho, alpha, omega;
+        // from the true residual b-A*x, which the updated r drifts away from
+        auto restart = [&](){
+            res = operator_residual(n, A, b, x, r.data());
+            std::copy(r.begin(), r.end(), rh.begin());
+            std::fill(p.begin(), p.end(), static_cast<T>(0));
+            std::fill(v.begin(), v.end(), static_cast<T>(0));
+            rho = alpha = omega = static_cast<T>(1);
+        };
+        restart();
+
+        size_t k = 0;
+        for(; k < max_iter && res > tol; ++k, monitor(k, res, clock.elapsed())){
+            const T rho1 = krylov_dot(n, rh.data(), r.data());
+            if(rho1 == static_cast<T>(0)) { restart(); continue; }     // r orthogonal to the shadow residual
+            const T beta = (rho1/rho)*(alpha/omega);
+            for(size_t i = 0; i < n; ++i)
+                p[i] = r[i]+beta*(p[i]-omega*v[i]);
+
+            M.apply(n, p.data(), ph.data());
+            operator_apply(A, ph.data(), v.data());
+            alpha = rho1/krylov_dot(n, rh.data(), v.data());
+            for(size_t i = 0; i < n; ++i)
+                s[i] = r[i]-alpha*v[i];
+            krylov_axpy(n, alpha, ph.data(), x);
+            if(std::sqrt(krylov_dot(n, s.data(), s.data())) <= tol) { restart(); continue; }
+
+            M.apply(n, s.data(), sh.data());
+            operator_apply(A, sh.data(), t.data());
+            const T tt = krylov_dot(n, t.data(), t.data());
+            omega = tt == static_cast<T>(0) ? static_cast<T>(0) : krylov_dot(n, t.data(), s.data())/tt;
+            krylov_axpy(n, omega, sh.data(), x);
+            for(size_t i = 0; i < n; ++i)
+                r[i] = s[i]-omega*t[i];
+            rho = rho1;
+            res = std::sqrt(krylov_dot(n, r.data(), r.data()));
+            if(omega == static_cast<T>(0) || res <= tol) restart();
+        }
+        return Lee::SolverResult<T>{res <= tol, k, res};
+    }
+
+    // GMRES(m), right preconditioned, Arnoldi by modified Gram-Schmidt and Givens rotations on H
+    template<typename T, typename Op, typename P, typename Mon>
+    Lee::SolverResult<T> gmres(size_t n, const Op &A, const T *b, T *x, T tol, size_t m, size_t max_iter, const P &M, Mon &monitor){
+        SolverClockFor<Mon> clock;
+        m = std::max<size_t>(1, std::min(m, n));
+        std::vector<T> V((m+1)*n), H((m+1)*m), cs(m), sn(m), g(m+1), y(m), w(n), z(n);
+        T res = operator_residual(n, A, b, x, V.data());
+
+        size_t k = 0;
+        while(k < max_iter && res > tol){
+            const T beta = res;
+            for(size_t i = 0; i < n; ++i)
+                V[i] /= beta;
+            std::fill(g.begin(), g.end(), static_cast<T>(0));
+            g[0] = beta;
+
+            size_t j = 0;
+            for(; j < m && k < max_iter && res > tol; ++j, ++k){
+                T *vj1 = V.data()+(j+1)*n;
+                M.apply(n, V.data()+j*n, z.data());
+                operator_apply(A, z.data(), vj1);
+                for(size_t i = 0; i <= j; ++i){
+                    const T h = krylov_dot(n, V.data()+i*n, vj1);
+                    H[i*m+j] = h;
+                    krylov_axpy(n, -h, V.data()+i*n, vj1);
+                }
+                const T h1 = std::sqrt(krylov_dot(n, vj1, vj1));
+                if(h1 != static_cast<T>(0))
+                    for(size_t i = 0; i < n; ++i)
+                        vj1[i] /= h1;
+
+                // earlier rotations on the new column, then the one that zeroes h1
+                for(size_t i = 0; i < j; ++i){
+                    const T a = H[i*m+j], c = H[(i+1)*m+j];
+                    H[i*m+j]     =  cs[i]*a+sn[i]*c;
+                    H[(i+1)*m+j] = -sn[i]*a+cs[i]*c;
+                }
+                const T a = H[j*m+j], r = std::sqrt(a*a+h1*h1);
+                cs[j] = r == static_cast<T>(0) ? static_cast<T>(1) : a/r;
+                sn[j] = r == static_cast<T>(0) ? static_cast<T>(0) : h1/r;
+                H[j*m+j] = r;
+                g[j+1] = -sn[j]*g[j];
+                g[j] = cs[j]*g[j];
+                res = std::abs(g[j+1]);
+                monitor(k+1, res, clock.elapsed());
+                if(h1 == static_cast<T>(0)) { ++j; ++k; break; }   // lucky breakdown, exact in this space
+            }
+
+            // H(0:j, 0:j)*y = g, then x += M*(V*y)
+            for(size_t i = j; i-- > 0; ){
+                T s = g[i];
+                for(size_t p = i+1; p < j; ++p)
+                    s -= H[i*m+p]*y[p];
+                y[i] = s/H[i*m+i];
+            }
+            std::fill(w.begin(), w.end(), static_cast<T>(0));
+            for(size_t i = 0; i < j; ++i)
+                krylov_axpy(n, y[i], V.data()+i*n, w.data());
+            M.apply(n, w.data(), z.data());
+            krylov_axpy(n, static_cast<T>(1), z.data(), x);
+
+            // the true residual starts the next cycle
+            res = operator_residual(n, A, b, x, V.data());
+        }
+        return Lee::SolverResult<T>{res <= tol, k, res};
+    }
+
+    template<typename T>
+    std::vector<T> inverse_diagonal(const std::vector<T> &d){
+        std::vector<T> inv(d.size());
+        for(size_t i = 0; i < d.size(); ++i){
+            assert(d[i] != static_cast<T>(0) && "Jacobi preconditioner with a zero on the diagonal");
+            inv[i] = static_cast<T>(1)/d[i];
+        }
+        return inv;
+    }
+
+}   // MatrixImpl
+
+namespace Lee{
+
+    template<typename T>
+    class IdentityPreconditioner{
+    public:
+        void apply(size_t n, const T *r, T *z) const { std::copy(r, r+n, z); }
+    };
+
+    template<typename T>
+    class JacobiPreconditioner{
+    public:
+        // any operator with a diagonal (LinearOperator.hpp)
+        template<typename Op>
+        explicit JacobiPreconditioner(const Op &A) : inv(MatrixImpl::inverse_diagonal(MatrixImpl::operator_diagonal(A))) {}
+
+        void apply(size_t n, const T *r, T *z) const{
+            for(size_t i = 0; i < n; ++i)
+                z[i] = inv[i]*r[i];
+        }
+
+    private:
+        std::vector<T> inv;
+    };
+
+    // L\U with unit L stored on the pattern of A, fill-in dropped
+    template<typename T>
+    class ILU0Preconditioner{
+    public:
+        template<SparseOrder O>
+        explicit ILU0Preconditioner(const SparseMatrix<T, O> &A) : LU(to_csr(A)), diag(A.rows()) {
+            assert(A.rows() == A.cols() && "ILU(0) needs a square matrix");
+            const size_t n = LU.rows();
+            const std::vector<size_t> &ptr = LU.outer_index(), &idx = LU.inner_index();
+            std::vector<T> &val = LU.values();
+            const size_t none = static_cast<size_t>(-1);
+            std::vector<size_t> pos(n, none);
+
+            for(size_t i = 0; i < n; ++i){
+                for(size_t p = ptr[i]; p < ptr[i+1]; ++p)
+                    pos[idx[p]] = p;
+                assert(pos[i] != none && "ILU(0) needs every diagonal entry stored");
+                diag[i] = pos[i];
+
+                // row i -= l_ik * row k for the stored k < i, only where row i has an entry
+                for(size_t p = ptr[i]; p < ptr[i+1] && idx[p] < i; ++p){
+                    const size_t k = idx[p];
+                    val[p] /= val[diag[k]];
+                    for(size_t q = diag[k]+1; q < ptr[k+1]; ++q)
+                        if(pos[idx[q]] != none) val[pos[idx[q]]] -= val[p]*val[q];
+                }
+                for(size_t p = ptr[i]; p < ptr[i+1]; ++p)
+                    pos[idx[p]] = none;
+            }
+        }
+
+        void apply(size_t n, const T *r, T *z) const{
+            const size_t *ptr = LU.outer_index().data(), *idx = LU.inner_index().data();
+            const T *val = LU.values().data();
+            for(size_t i = 0; i < n; ++i){
+                T s = r[i];
+                for(size_t p = ptr[i]; p < diag[i]; ++p)
+                    s -= val[p]*z[idx[p]];
+                z[i] = s;
+            }
+            for(size_t i = n; i-- > 0; ){
+                T s = z[i];
+                for(size_t p = diag[i]+1; p < ptr[i+1]; ++p)
+                    s -= val[p]*z[idx[p]];
+                z[i] = s/val[diag[i]];
+            }
+        }
+
+    private:
+        CSRMatrix<T> LU;
+        std::vector<size_t> diag;       // position of (i, i) in the arrays of LU
+    };
+
+    // L*L^T ~ A with L on the lower triangle pattern of A
+    template<typename T>
+    class IC0Preconditioner{
+    public:
+        template<SparseOrder O>
+        explicit IC0Preconditioner(const SparseMatrix<T, O> &A){
+            assert(A.rows() == A.cols() && "incomplete Cholesky needs a square matrix");
+            const CSRMatrix<T> C = to_csr(A);
+            const size_t n = C.rows();
+            const std::vector<size_t> &cptr = C.outer_index(), &cidx = C.inner_index();
+            const std::vector<T> &cval = C.values();
+
+            std::vector<size_t> ptr(n+1, 0), idx;
+            std::vector<T> val;
+            for(size_t i = 0; i < n; ++i){
+                for(size_t p = cptr[i]; p < cptr[i+1] && cidx[p] <= i; ++p){
+                    idx.push_back(cidx[p]);
+                    val.push_back(cval[p]);
+                }
+                ptr[i+1] = idx.size();
+                assert(ptr[i+1] > ptr[i] && idx.back() == i && "incomplete Cholesky needs every diagonal entry stored");
+            }
+
+            // row by row: l_ik = (a_ik - sum_p l_ip*l_kp)/l_kk over the shared pattern, l_ii last
+            for(size_t i = 0; i < n; ++i){
+                for(size_t p = ptr[i]; p < ptr[i+1]; ++p){
+                    const size_t k = idx[p];
+                    T s = val[p];
+                    for(size_t a = ptr[i], b = ptr[k]; a < p && b < ptr[k+1]-1; ){
+                        if(idx[a] < idx[b]) ++a;
+                        else if(idx[a] > idx[b]) ++b;
+                        else s -= val[a++]*val[b++];
+                    }
+                    if(k < i) val[p] = s/val[ptr[k+1]-1];
+                    // a breakdown keeps the original diagonal instead of a nonpositive pivot
+                    else val[p] = std::sqrt(s > static_cast<T>(0) ? s : val[p]);
+                }
+            }
+            L = CSRMatrix<T>(n, n, std::move(ptr), std::move(idx), std::move(val));
+        }
+
+        // L*y = r, then L^T*z = y with the rows of L read as columns of L^T
+        void apply(size_t n, const T *r, T *z) const{
+            const size_t *ptr = L.outer_index().data(), *idx = L.inner_index().data();
+            const T *val = L.values().data();
+            for(size_t i = 0; i < n; ++i){
+                T s = r[i];
+                for(size_t p = ptr[i]; p < ptr[i+1]-1; ++p)
+                    s -= val[p]*z[idx[p]];
+                z[i] = s/val[ptr[i+1]-1];
+            }
+            for(size_t i = n; i-- > 0; ){
+                z[i] /= val[ptr[i+1]-1];
+                for(size_t p = ptr[i]; p < ptr[i+1]-1; ++p)
+                    z[idx[p]] -= val[p]*z[i];
+            }
+        }
+
+    private:
+        CSRMatrix<T> L;
+    };
+
+    template<typename Op, typename Vec, typename P = IdentityPreconditioner<typename Vec::value_type>, typename Mon = NullMonitor>
+    Vec conjugate_gradient(const Op &A, const Vec &b, Vec x0, typename Vec::value_type tol, size_t max_iter = 1000, const P &M = P(),
+                           SolverResult<typename Vec::value_type> *result = nullptr, Mon monitor = Mon()){
+        assert(A.rows() == A.cols() && A.rows() == b.rows() && b.rows() == x0.rows() && "dimensions do not match");
+        typedef typename Vec::value_type T;
+        SolverResult<T> res{true, 0, static_cast<T>(0)};
+        if(b.rows()) res = MatrixImpl::conjugate_gradient(b.rows(), A, b.data().data(), &x0(0, 0), tol, max_iter, M, monitor);
+        MatrixImpl::solver_result(result, res);
+        return x0;
+    }
+
+    template<typename Op, typename Vec, typename P = IdentityPreconditioner<typename Vec::value_type>, typename Mon = NullMonitor>
+    Vec bicgstab(const Op &A, const Vec &b, Vec x0, typename Vec::value_type tol, size_t max_iter = 1000, const P &M = P(),
+                 SolverResult<typename Vec::value_type> *result = nullptr, Mon monitor = Mon()){
+        assert(A.rows() == A.cols() && A.rows() == b.rows() && b.rows() == x0.rows() && "dimensions do not match");
+        typedef typename Vec::value_type T;
+        SolverResult<T> res{true, 0, static_cast<T>(0)};
+        if(b.rows()) res = MatrixImpl::bicgstab(b.rows(), A, b.data().data(), &x0(0, 0), tol, max_iter, M, monitor);
+        MatrixImpl::solver_result(result, res);
+        return x0;
+    }
+
+    template<typename Op, typename Vec, typename P = IdentityPreconditioner<typename Vec::value_type>, typename Mon = NullMonitor>
+    Vec gmres(const Op &A, const Vec &b, Vec x0, typename Vec::value_type tol, size_t restart = 30, size_t max_iter = 1000, const P &M = P(),
+              SolverResult<typename Vec::value_type> *result = nullptr, Mon monitor = Mon()){
+        assert(A.rows() == A.cols() && A.rows() == b.rows() && b.rows() == x0.rows() && "dimensions do not match");
+        typedef typename Vec::value_type T;
+        SolverResult<T> res{true, 0, static_cast<T>(0)};
+        if(b.rows()) res = MatrixImpl::gmres(b.rows(), A, b.data().data(), &x0(0, 0), tol, restart, max_iter, M, monitor);
+        MatrixImpl::solver_result(result, res);
+        return x0;
+    }
+
+}   // Lee
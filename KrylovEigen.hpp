@@ -0,0 +1,699 @@
+#pragma once
+
+#include <vector>
+#include <complex>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <algorithm>
+#include <tuple>
+#include "DynamicMatrix.hpp"
+#include "LinearOperator.hpp"
+#include "Krylov.hpp"
+#include "Monitor.hpp"
+#include "LU.hpp"
+#include "Gemm.hpp"
+#include "EigenvalueEstimate.hpp"
+
+/*
+** A few eigenpairs of a large operator (LinearOperator.hpp) from a restarted Krylov basis of ncv vectors
+** | lanczos_eigs(A, k, target, shift, tol, max_restarts, ncv, result)     A symmetric, thick-restart Lanczos
+** |                                                                       returns (values k x 1, vectors n x k)
+** | arnoldi_eigs(A, k, target, shift, tol, max_restarts, ncv, result)     A general, implicitly restarted Arnoldi
+** |                                                                       complex values and vectors
+** target
+** | EigenTarget::Largest        largest algebraic (Lanczos) or largest magnitude (Arnoldi)
+** | EigenTarget::Smallest       smallest algebraic (Lanczos) or smallest magnitude (Arnoldi)
+** | EigenTarget::NearestShift   nearest to shift, through (A-shift*I)^-1: LU for dense A, GMRES otherwise;
+** |                            the pairs are mapped back and their residual recomputed on A
+** a pair is converged once its residual ||A*x-lambda*x|| <= tol*|lambda|; ncv = 0 picks max(2k+1, 20)
+** the basis is kept orthogonal by two Gram-Schmidt passes done as GEMV; restarts combine it by GEMM
+*/
+
+// restart length of the GMRES solves with A-shift*I for a matrix-free NearestShift target
+#ifndef LEE_SHIFT_GMRES_RESTART
+#define LEE_SHIFT_GMRES_RESTART 100
+#endif
+
+namespace Lee{
+
+    enum class EigenTarget { Largest, Smallest, NearestShift };
+
+}   // Lee
+
+namespace MatrixImpl{
+
+    // x filled from a linear congruential sequence, components along every eigenvector
+    template<typename T>
+    void krylov_random(size_t n, T *x, unsigned &seed){
+        for(size_t i = 0; i < n; ++i){
+            seed = seed*1103515245u+12345u;
+            x[i] = static_cast<T>(seed >> 8)/static_cast<T>(1u << 24)-static_cast<T>(0.5);
+        }
+    }
+
+    // w -= B^T*(B*w) twice for the first j rows of B (n each); h += the coefficients; returns ||w||
+    template<typename T>
+    T krylov_orthogonalize(size_t n, size_t j, const T *B, T *w, T *h, T *tmp){
+        const T one = static_cast<T>(1), zero = static_cast<T>(0);
+        for(int pass = 0; pass < 2; ++pass){
+            gemv_parallel(j, n, one, B, n, 1, w, 1, zero, tmp, 1);
+            gemv(n, j, -one, B, 1, n, tmp, 1, one, w, 1);
+            for(size_t i = 0; i < j; ++i)
+                h[i] += tmp[i];
+        }
+        return std::sqrt(krylov_dot(n, w, w));
+    }
+
+    // row j of B from w = A*v_{j-1} after orthogonalization; an invariant subspace restarts from a random vector
+    template<typename T>
+    T krylov_next(size_t n, size_t j, T *B, T *w, T beta, T scale, T *h, T *tmp, unsigned &seed){
+        T *v = B+j*n;
+        if(beta > std::numeric_limits<T>::epsilon()*scale){
+            for(size_t i = 0; i < n; ++i)
+                v[i] = w[i]/beta;
+            return beta;
+        }
+        krylov_random(n, v, seed);
+        std::fill(h, h+j, static_cast<T>(0));
+        normalize(n, v);
+        krylov_orthogonalize(n, j, B, v, h, tmp);
+        normalize(n, v);
+        return static_cast<T>(0);
+    }
+
+    // eigenvalues d and eigenvectors (columns of v) of the m x m symmetric a by cyclic Jacobi rotations
+    template<typename T>
+    void sym_jacobi_eig(size_t m, std::vector<T> a, T *d, T *v){
+        for(size_t i = 0; i < m; ++i)
+            for(size_t j = 0; j < m; ++j)
+                v[i*m+j] = (i == j) ? static_cast<T>(1) : static_cast<T>(0);
+
+        for(int sweep = 0; sweep < 100; ++sweep){
+            T off = 0, diag = 0;
+            for(size_t i = 0; i < m; ++i){
+                diag += a[i*m+i]*a[i*m+i];
+                for(size_t j = i+1; j < m; ++j)
+                    off += a[i*m+j]*a[i*m+j];
+            }
+            if(off <= std::numeric_limits<T>::epsilon()*std::numeric_limits<T>::epsilon()*diag) break;
+
+            for(size_t p = 0; p < m; ++p)
+                for(size_t q = p+1; q < m; ++q){
+                    const T apq = a[p*m+q];
+                    if(apq == static_cast<T>(0)) continue;
+                    const T tau = (a[q*m+q]-a[p*m+p])/(2*apq);
+                    const T t = (tau >= 0 ? 1 : -1)/(std::abs(tau)+std::sqrt(1+tau*tau));
+                    const T c = 1/std::sqrt(1+t*t), s = t*c;
+                    for(size_t r = 0; r < m; ++r){
+                        const T arp = a[r*m+p], arq = a[r*m+q];
+                        a[r*m+p] = c*arp-s*arq;
+                        a[r*m+q] = s*arp+c*arq;
+                    }
+                    for(size_t r = 0; r < m; ++r){
+                        const T apr = a[p*m+r], aqr = a[q*m+r];
+                        a[p*m+r] = c*apr-s*aqr;
+                        a[q*m+r] = s*apr+c*aqr;
+                    }
+                    for(size_t r = 0; r < m; ++r){
+                        const T vrp = v[r*m+p], vrq = v[r*m+q];
+                        v[r*m+p] = c*vrp-s*vrq;
+                        v[r*m+q] = s*vrp+c*vrq;
+                    }
+                }
+        }
+        for(size_t i = 0; i < m; ++i)
+            d[i] = a[i*m+i];
+    }
+
+    // eigenvalues mu and unit eigenvectors (columns of y) of the m x m upper Hessenberg h,
+    // by complex single-shift QR to Schur form T = Z^H*H*Z and back substitution on T
+    template<typename T>
+    void hessenberg_eig_complex(size_t m, const T *h, std::complex<T> *mu, std::complex<T> *y){
+        typedef std::complex<T> C;
+        const T eps = std::numeric_limits<T>::epsilon();
+        std::vector<C> t(m*m), z(m*m, C(0)), gc(m), gs(m);
+        for(size_t i = 0; i < m; ++i){
+            for(size_t j = 0; j < m; ++j)
+                t[i*m+j] = (i <= j+1) ? C(h[i*m+j]) : C(0);
+            z[i*m+i] = C(1);
+        }
+
+        size_t hi = m-1, iter = 0;
+        while(hi > 0 && iter < 100*m){
+            size_t lo = hi;
+            while(lo > 0 && std::abs(t[lo*m+lo-1]) > eps*(std::abs(t[lo*m+lo])+std::abs(t[(lo-1)*m+lo-1])))
+                --lo;
+            if(lo > 0) t[lo*m+lo-1] = C(0);
+            if(lo == hi) { --hi; iter = 0; continue; }
+            ++iter;
+
+            // Wilkinson shift from the trailing 2 x 2, an exceptional one now and then
+            const C a = t[(hi-1)*m+hi-1], b = t[(hi-1)*m+hi], c = t[hi*m+hi-1], d = t[hi*m+hi];
+            const C tr = (a+d)/T(2), disc = std::sqrt((a-d)*(a-d)/T(4)+b*c);
+            C shift = std::abs(tr+disc-d) < std::abs(tr-disc-d) ? tr+disc : tr-disc;
+            if(iter%11 == 10) shift = d+C(std::abs(c));
+
+            for(size_t k = lo; k <= hi; ++k)
+                t[k*m+k] -= shift;
+            for(size_t k = lo; k < hi; ++k){
+                const C x = t[k*m+k], w = t[(k+1)*m+k];
+                const T r = std::sqrt(std::norm(x)+std::norm(w));
+                gc[k] = r == T(0) ? C(1) : x/r;
+                gs[k] = r == T(0) ? C(0) : w/r;
+                for(size_t j = k; j < m; ++j){
+                    const C u = t[k*m+j], v = t[(k+1)*m+j];
+                    t[k*m+j]     =  std::conj(gc[k])*u+std::conj(gs[k])*v;
+                    t[(k+1)*m+j] = -gs[k]*u+gc[k]*v;
+                }
+            }
+            for(size_t k = lo; k < hi; ++k){
+                for(size_t i = 0; i <= std::min(k+1, hi); ++i){
+                    const C u = t[i*m+k], v = t[i*m+k+1];
+                    t[i*m+k]   = u*gc[k]+v*gs[k];
+                    t[i*m+k+1] = -u*std::conj(gs[k])+v*std::conj(gc[k]);
+                }
+                for(size_t i = 0; i < m; ++i){
+                    const C u = z[i*m+k], v = z[i*m+k+1];
+                    z[i*m+k]   = u*gc[k]+v*gs[k];
+                    z[i*m+k+1] = -u*std::conj(gs[k])+v*std::conj(gc[k]);
+                }
+            }
+            for(size_t k = lo; k <= hi; ++k)
+                t[k*m+k] += shift;
+        }
+
+        T nrm = 0;
+        for(size_t i = 0; i < m*m; ++i)
+            nrm = std::max(nrm, std::abs(t[i]));
+        std::vector<C> x(m);
+        for(size_t i = 0; i < m; ++i){
+            mu[i] = t[i*m+i];
+            std::fill(x.begin(), x.end(), C(0));
+            x[i] = C(1);
+            for(size_t r = i; r-- > 0; ){
+                C s = 0;
+                for(size_t c = r+1; c <= i; ++c)
+                    s += t[r*m+c]*x[c];
+                C den = t[r*m+r]-mu[i];
+                if(std::abs(den) < eps*nrm) den = C(eps*nrm);
+                x[r] = -s/den;
+            }
+            T len = 0;
+            for(size_t r = 0; r < m; ++r){
+                C s = 0;
+                for(size_t c = 0; c <= i; ++c)
+                    s += z[r*m+c]*x[c];
+                y[r*m+i] = s;
+                len += std::norm(s);
+            }
+            len = std::sqrt(len);
+            for(size_t r = 0; r < m; ++r)
+                y[r*m+i] /= len;
+        }
+    }
+
+    // the eigenvalues of a real matrix come out of complex QR only nearly in conjugate pairs: make them exact
+    template<typename T>
+    void ritz_conjugates(size_t m, std::complex<T> *mu){
+        const T tol = std::sqrt(std::numeric_limits<T>::epsilon());
+        std::vector<bool> paired(m, false);
+        for(size_t i = 0; i < m; ++i){
+            if(paired[i]) continue;
+            if(std::abs(mu[i].imag()) <= tol*std::abs(mu[i])) { mu[i].imag(0); continue; }
+            size_t best = m;
+            for(size_t j = i+1; j < m; ++j)
+                if(!paired[j] && (best == m || std::abs(mu[j]-std::conj(mu[i])) < std::abs(mu[best]-std::conj(mu[i]))))
+                    best = j;
+            if(best == m) continue;
+            paired[i] = paired[best] = true;
+            mu[best] = std::conj(mu[i]);
+        }
+    }
+
+    // index of the conjugate of mu[c], m if mu[c] is real or unpaired
+    template<typename T>
+    size_t conjugate_of(size_t m, const std::complex<T> *mu, size_t c){
+        if(mu[c].imag() == T(0)) return m;
+        for(size_t j = 0; j < m; ++j)
+            if(j != c && mu[j] == std::conj(mu[c])) return j;
+        return m;
+    }
+
+    // Householder QR of the m x m a, q = Q (row-major)
+    template<typename T>
+    void small_qr_q(size_t m, std::vector<T> a, T *q){
+        std::vector<T> v(m);
+        for(size_t i = 0; i < m; ++i)
+            for(size_t j = 0; j < m; ++j)
+                q[i*m+j] = (i == j) ? static_cast<T>(1) : static_cast<T>(0);
+        for(size_t k = 0; k+1 < m; ++k){
+            T alpha = 0;
+            for(size_t i = k; i < m; ++i)
+                alpha += a[i*m+k]*a[i*m+k];
+            alpha = std::sqrt(alpha);
+            if(alpha == static_cast<T>(0)) continue;
+            if(a[k*m+k] > 0) alpha = -alpha;
+            T vv = 0;
+            for(size_t i = k; i < m; ++i){
+                v[i] = a[i*m+k]-(i == k ? alpha : static_cast<T>(0));
+                vv += v[i]*v[i];
+            }
+            if(vv == static_cast<T>(0)) continue;
+            // a = (I-2vv^T/v^Tv)*a, q = q*(I-2vv^T/v^Tv)
+            for(size_t j = 0; j < m; ++j){
+                T s = 0;
+                for(size_t i = k; i < m; ++i)
+                    s += v[i]*a[i*m+j];
+                s *= 2/vv;
+                for(size_t i = k; i < m; ++i)
+                    a[i*m+j] -= s*v[i];
+            }
+            for(size_t i = 0; i < m; ++i){
+                T s = 0;
+                for(size_t j = k; j < m; ++j)
+                    s += q[i*m+j]*v[j];
+                s *= 2/vv;
+                for(size_t j = k; j < m; ++j)
+                    q[i*m+j] -= s*v[j];
+            }
+        }
+    }
+
+    // h = qs^T*h*qs, q = q*qs for the m x m qs
+    template<typename T>
+    void small_similarity(size_t m, const T *qs, T *h, T *q){
+        std::vector<T> tmp(m*m);
+        gemm(m, m, m, static_cast<T>(1), qs, 1, m, h, m, 1, static_cast<T>(0), tmp.data(), m);
+        gemm(m, m, m, static_cast<T>(1), tmp.data(), m, 1, qs, m, 1, static_cast<T>(0), h, m);
+        std::copy(q, q+m*m, tmp.begin());
+        gemm(m, m, m, static_cast<T>(1), tmp.data(), m, 1, qs, m, 1, static_cast<T>(0), q, m);
+    }
+
+    // rows [0, l) of B become sel^T*B, sel: m x l column selection, row-major
+    template<typename T>
+    void krylov_combine(size_t n, size_t m, size_t l, const T *sel, T *B){
+        std::vector<T> out(l*n);
+        gemm_parallel(l, n, m, static_cast<T>(1), sel, 1, l, B, n, 1, static_cast<T>(0), out.data(), n);
+        std::copy(out.begin(), out.end(), B);
+    }
+
+    // op: 0 largest, 1 smallest algebraic, 2 largest magnitude; values and vectors (k rows of n) of the wanted pairs
+    template<typename T, typename Apply>
+    Lee::SolverResult<T> lanczos(size_t n, Apply apply, size_t k, size_t m, int op, T tol, size_t max_restarts,
+                                 T *values, T *vectors){
+        std::vector<T> B((m+1)*n), Tm(m*m, 0), w(n), h(m+1), tmp(m+1), theta(m), S(m*m), sel(m*m), res(m);
+        std::vector<size_t> order(m);
+        unsigned seed = 1;
+        krylov_random(n, B.data(), seed);
+        normalize(n, B.data());
+
+        Lee::SolverResult<T> out{false, 0, static_cast<T>(0)};
+        T betam = 0, scale = 0;
+        size_t j0 = 0;
+        for(; ; ++out.iterations){
+            for(size_t j = j0; j < m; ++j){
+                apply(B.data()+j*n, w.data());
+                std::fill(h.begin(), h.end(), static_cast<T>(0));
+                T beta = krylov_orthogonalize(n, j+1, B.data(), w.data(), h.data(), tmp.data());
+                scale = std::max(scale, std::abs(h[j]));
+                for(size_t i = 0; i <= j; ++i)
+                    Tm[i*m+j] = Tm[j*m+i] = (i+1 < j && i >= j0) ? static_cast<T>(0) : h[i];
+                beta = krylov_next(n, j+1, B.data(), w.data(), beta, scale, h.data(), tmp.data(), seed);
+                if(j+1 < m) Tm[(j+1)*m+j] = Tm[j*m+j+1] = beta;
+                else betam = beta;
+            }
+
+            sym_jacobi_eig(m, Tm, theta.data(), S.data());
+            std::iota(order.begin(), order.end(), 0);
+            std::sort(order.begin(), order.end(), [&](size_t a, size_t b){
+                if(op == 0) return theta[a] > theta[b];
+                if(op == 1) return theta[a] < theta[b];
+                return std::abs(theta[a]) > std::abs(theta[b]);
+            });
+            out.residual = 0;
+            for(size_t i = 0; i < k; ++i){
+                const size_t c = order[i];
+                res[i] = std::abs(betam*S[(m-1)*m+c])/std::max(std::abs(theta[c]), std::numeric_limits<T>::min());
+                out.residual = std::max(out.residual, res[i]);
+            }
+            out.converged = out.residual <= tol;
+
+            // thick restart: the best l Ritz vectors, then the residual direction
+            const size_t l = (out.converged || out.iterations+1 >= max_restarts) ? k : std::min(m-1, k+(m-k)/2);
+            for(size_t p = 0; p < m; ++p)
+                for(size_t i = 0; i < l; ++i)
+                    sel[p*l+i] = S[p*m+order[i]];
+            krylov_combine(n, m, l, sel.data(), B.data());
+            if(out.converged || out.iterations+1 >= max_restarts){
+                for(size_t i = 0; i < k; ++i)
+                    values[i] = theta[order[i]];
+                std::copy(B.begin(), B.begin()+k*n, vectors);
+                ++out.iterations;
+                return out;
+            }
+
+            std::copy(B.begin()+m*n, B.begin()+(m+1)*n, B.begin()+l*n);
+            std::fill(Tm.begin(), Tm.end(), static_cast<T>(0));
+            for(size_t i = 0; i < l; ++i){
+                Tm[i*m+i] = theta[order[i]];
+                Tm[i*m+l] = Tm[l*m+i] = betam*S[(m-1)*m+order[i]];
+            }
+            j0 = l;
+        }
+    }
+
+    // op: 0 largest, 1 smallest magnitude; mu and x (k rows of n) the wanted Ritz pairs
+    template<typename T, typename Apply>
+    Lee::SolverResult<T> arnoldi(size_t n, Apply apply, size_t k, size_t m, int op, T tol, size_t max_restarts,
+                                 std::complex<T> *values, std::complex<T> *vectors){
+        typedef std::complex<T> C;
+        std::vector<T> B((m+1)*n), H(m*m, 0), w(n), h(m+1), tmp(m+1), Q(m*m), Qs(m*m), M(m*m), sel(m*(m+1));
+        std::vector<C> mu(m), Y(m*m);
+        std::vector<size_t> order(m);
+        std::vector<bool> used(m);
+        unsigned seed = 1;
+        krylov_random(n, B.data(), seed);
+        normalize(n, B.data());
+
+        Lee::SolverResult<T> out{false, 0, static_cast<T>(0)};
+        T betam = 0, scale = 0;
+        size_t j0 = 0;
+        for(; ; ++out.iterations){
+            for(size_t j = j0; j < m; ++j){
+                apply(B.data()+j*n, w.data());
+                std::fill(h.begin(), h.end(), static_cast<T>(0));
+                T beta = krylov_orthogonalize(n, j+1, B.data(), w.data(), h.data(), tmp.data());
+                scale = std::max(scale, std::abs(h[j]));
+                for(size_t i = 0; i <= j; ++i)
+                    H[i*m+j] = h[i];
+                beta = krylov_next(n, j+1, B.data(), w.data(), beta, scale, h.data(), tmp.data(), seed);
+                if(j+1 < m) H[(j+1)*m+j] = beta;
+                else betam = beta;
+            }
+
+            hessenberg_eig_complex(m, H.data(), mu.data(), Y.data());
+            ritz_conjugates(m, mu.data());
+            std::iota(order.begin(), order.end(), 0);
+            std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b){
+                return op == 1 ? std::abs(mu[a]) < std::abs(mu[b]) : std::abs(mu[a]) > std::abs(mu[b]);
+            });
+            out.residual = 0;
+            for(size_t i = 0; i < k; ++i){
+                const size_t c = order[i];
+                const T r = std::abs(betam*Y[(m-1)*m+c])/std::max(std::abs(mu[c]), std::numeric_limits<T>::min());
+                out.residual = std::max(out.residual, r);
+            }
+            out.converged = out.residual <= tol;
+
+            if(out.converged || out.iterations+1 >= max_restarts){
+                // x = B^T*y, real and imaginary parts by GEMM
+                for(int part = 0; part < 2; ++part){
+                    for(size_t p = 0; p < m; ++p)
+                        for(size_t i = 0; i < k; ++i)
+                            sel[p*k+i] = part ? Y[p*m+order[i]].imag() : Y[p*m+order[i]].real();
+                    std::vector<T> x(k*n);
+                    gemm_parallel(k, n, m, static_cast<T>(1), sel.data(), 1, k, B.data(), n, 1, static_cast<T>(0), x.data(), n);
+                    for(size_t e = 0; e < k*n; ++e)
+                        vectors[e] = part ? C(vectors[e].real(), x[e]) : C(x[e], 0);
+                }
+                for(size_t i = 0; i < k; ++i)
+                    values[i] = mu[order[i]];
+                ++out.iterations;
+                return out;
+            }
+
+            // keep kk Ritz values, a conjugate pair is never split; the rest are exact shifts
+            size_t kk = k;
+            if(kk < m-1 && mu[order[kk-1]].imag() != T(0)){
+                const size_t t = std::find(order.begin()+kk, order.end(), conjugate_of(m, mu.data(), order[kk-1]))-order.begin();
+                if(t < m) { std::swap(order[kk], order[t]); ++kk; }
+            }
+            for(size_t i = 0; i < m; ++i)
+                for(size_t j = 0; j < m; ++j)
+                    Q[i*m+j] = (i == j) ? static_cast<T>(1) : static_cast<T>(0);
+            std::fill(used.begin(), used.end(), false);
+            for(size_t s = kk; s < m; ++s){
+                const size_t c = order[s];
+                if(used[c]) continue;
+                used[c] = true;
+                const C sh = mu[c];
+                // a complex shift goes with its conjugate: (H-sh)(H-conj(sh)) = H^2-2Re(sh)H+|sh|^2
+                const size_t t = std::find(order.begin()+s+1, order.end(), conjugate_of(m, mu.data(), c))-order.begin();
+                if(t < m && !used[order[t]]){
+                    used[order[t]] = true;
+                    gemm(m, m, m, static_cast<T>(1), H.data(), m, 1, H.data(), m, 1, static_cast<T>(0), M.data(), m);
+                    for(size_t e = 0; e < m*m; ++e)
+                        M[e] -= 2*sh.real()*H[e];
+                    for(size_t i = 0; i < m; ++i)
+                        M[i*m+i] += std::norm(sh);
+                }
+                else{
+                    M = H;
+                    for(size_t i = 0; i < m; ++i)
+                        M[i*m+i] -= sh.real();
+                }
+                small_qr_q(m, M, Qs.data());
+                small_similarity(m, Qs.data(), H.data(), Q.data());
+                for(size_t i = 0; i < m; ++i)
+                    for(size_t j = 0; j+1 < i; ++j)
+                        H[i*m+j] = 0;
+            }
+
+            // A*(V*Q)_kk = (V*Q)_kk*H_kk + f*e_kk^T with f = (V*Q)_kk+1*H(kk, kk-1) + f_m*Q(m-1, kk-1)
+            for(size_t p = 0; p < m; ++p)
+                for(size_t i = 0; i <= kk; ++i)
+                    sel[p*(kk+1)+i] = Q[p*m+i];
+            const T fm = betam*Q[(m-1)*m+kk-1], hk = H[kk*m+kk-1];
+            std::copy(B.begin()+m*n, B.end(), w.begin());
+            krylov_combine(n, m, kk+1, sel.data(), B.data());
+            T *f = B.data()+kk*n;
+            for(size_t i = 0; i < n; ++i)
+                f[i] = f[i]*hk+w[i]*fm;
+            std::fill(h.begin(), h.end(), static_cast<T>(0));
+            T beta = krylov_orthogonalize(n, kk, B.data(), f, h.data(), tmp.data());
+            std::copy(f, f+n, w.begin());
+            beta = krylov_next(n, kk, B.data(), w.data(), beta, scale, h.data(), tmp.data(), seed);
+            for(size_t i = 0; i < m; ++i)
+                for(size_t j = 0; j < m; ++j)
+                    if(i >= kk+1 || j >= kk) H[i*m+j] = 0;
+            H[kk*m+kk-1] = beta;
+            j0 = kk;
+        }
+    }
+
+    // y = (A-s*I)^-1*x for the NearestShift target; s an eigenvalue is nudged (shifted_lu_factor)
+    template<typename T>
+    class DenseShiftSolve{
+    public:
+        DenseShiftSolve(size_t n, const T *a, T s) : m(n), lu(n*n), perm(n), sigma(shifted_lu_factor(n, a, s, lu.data(), perm.data())) {}
+
+        void operator()(const T *x, T *y) const{
+            std::copy(x, x+m, y);
+            lu_solve(m, lu.data(), m, perm.data(), y, 1, 1);
+        }
+
+        T shift() const { return sigma; }
+
+    private:
+        size_t m;
+        std::vector<T> lu;
+        std::vector<size_t> perm;
+        T sigma;
+    };
+
+    template<typename T, typename Op>
+    class ShiftedOperator{
+    public:
+        ShiftedOperator(const Op &a, T s) : A(&a), shift(s) {}
+
+        size_t rows() const { return A->rows(); }
+
+        size_t cols() const { return A->cols(); }
+
+        void apply(const T *x, T *y) const{
+            operator_apply(*A, x, y);
+            for(size_t i = 0; i < A->rows(); ++i)
+                y[i] -= shift*x[i];
+        }
+
+    private:
+        const Op *A;
+        T shift;
+    };
+
+    // GMRES with a long restart, since A-s*I is indefinite for an interior shift; a solve that still stalls
+    // leaves the operator inexact, so the pairs found through it are checked on A (eigenpair_residual)
+    template<typename T, typename Op>
+    class OperatorShiftSolve{
+    public:
+        OperatorShiftSolve(const Op &a, T s, T t) : shifted(a, s), sigma(s), tol(t) {}
+
+        void operator()(const T *x, T *y) const{
+            const size_t n = shifted.rows();
+            Lee::NullMonitor monitor;
+            std::fill(y, y+n, static_cast<T>(0));
+            const T nrm = std::sqrt(krylov_dot(n, x, x));
+            gmres(n, shifted, x, y, tol*nrm, LEE_SHIFT_GMRES_RESTART, n, Lee::IdentityPreconditioner<T>(), monitor);
+        }
+
+        T shift() const { return sigma; }
+
+    private:
+        ShiftedOperator<T, Op> shifted;
+        T sigma;
+        T tol;
+    };
+
+    template<typename T, size_t N>
+    DenseShiftSolve<T> shift_solver(const Lee::Matrix<T, N, N> &A, T s, T) { return DenseShiftSolve<T>(N, A.data().data(), s); }
+
+    template<typename T>
+    DenseShiftSolve<T> shift_solver(const Lee::DynamicMatrix<T> &A, T s, T) { return DenseShiftSolve<T>(A.rows(), A.data().data(), s); }
+
+    template<typename Op, typename T>
+    OperatorShiftSolve<T, Op> shift_solver(const Op &A, T s, T tol) { return OperatorShiftSolve<T, Op>(A, s, tol); }
+
+    // max over k pairs of ||A*x-lambda*x||/(|lambda|*||x||), x row j of vectors (n), evaluated on A itself
+    template<typename T, typename Op>
+    T eigenpair_residual(const Op &A, size_t k, const T *values, const T *vectors){
+        const size_t n = A.rows();
+        std::vector<T> ax(n);
+        T worst = 0;
+        for(size_t j = 0; j < k; ++j){
+            const T *x = vectors+j*n;
+            operator_apply(A, x, ax.data());
+            T r = 0;
+            for(size_t i = 0; i < n; ++i)
+                r += (ax[i]-values[j]*x[i])*(ax[i]-values[j]*x[i]);
+            const T scale = std::max(std::abs(values[j]), std::numeric_limits<T>::min())*std::sqrt(krylov_dot(n, x, x));
+            worst = std::max(worst, std::sqrt(r)/scale);
+        }
+        return worst;
+    }
+
+    template<typename T, typename Op>
+    T eigenpair_residual(const Op &A, size_t k, const std::complex<T> *values, const std::complex<T> *vectors){
+        const size_t n = A.rows();
+        std::vector<T> xr(n), xi(n), ar(n), ai(n);
+        T worst = 0;
+        for(size_t j = 0; j < k; ++j){
+            for(size_t i = 0; i < n; ++i){
+                xr[i] = vectors[j*n+i].real();
+                xi[i] = vectors[j*n+i].imag();
+            }
+            operator_apply(A, xr.data(), ar.data());
+            operator_apply(A, xi.data(), ai.data());
+            const T lr = values[j].real(), li = values[j].imag();
+            T r = 0;
+            for(size_t i = 0; i < n; ++i){
+                const T er = ar[i]-(lr*xr[i]-li*xi[i]), ei = ai[i]-(lr*xi[i]+li*xr[i]);
+                r += er*er+ei*ei;
+            }
+            const T nx = std::sqrt(krylov_dot(n, xr.data(), xr.data())+krylov_dot(n, xi.data(), xi.data()));
+            worst = std::max(worst, std::sqrt(r)/(std::max(std::abs(values[j]), std::numeric_limits<T>::min())*nx));
+        }
+        return worst;
+    }
+
+    // a NearestShift run whose pairs miss tol on A (the inverse converged, but |lambda| is small next to
+    // ||A-shift*I||, or the inner solves were inexact) is repeated with the inner tolerance tightened
+    // by the shortfall, at most twice and never below machine precision
+    template<typename T>
+    bool shift_refine(const Lee::SolverResult<T> &res, T tol, size_t pass, T &inner){
+        if(res.converged || pass == 2 || !(res.residual > tol)) return false;
+        const T next = inner*tol/(2*res.residual);
+        if(next < 10*std::numeric_limits<T>::epsilon()) return false;
+        inner = next;
+        return true;
+    }
+
+    template<typename T, typename Op>
+    size_t krylov_dimension(const Op &A, size_t k, size_t ncv){
+        assert(A.rows() == A.cols() && k > 0 && k < A.rows() && "need 0 < k < n");
+        return std::min(A.rows(), std::max(ncv ? ncv : std::max<size_t>(2*k+1, 20), k+2));
+    }
+
+}   // MatrixImpl
+
+namespace Lee{
+
+    template<typename Op>
+    std::tuple<DynamicMatrix<typename Op::value_type>, DynamicMatrix<typename Op::value_type>>
+    lanczos_eigs(const Op &A, size_t k, EigenTarget target = EigenTarget::Largest, typename Op::value_type shift = 0,
+                 typename Op::value_type tol = 1e-10, size_t max_restarts = 300, size_t ncv = 0,
+                 SolverResult<typename Op::value_type> *result = nullptr){
+        typedef typename Op::value_type T;
+        const size_t n = A.rows(), m = MatrixImpl::krylov_dimension<T>(A, k, ncv);
+        std::vector<T> values(k), vectors(k*n);
+        SolverResult<T> res;
+
+        if(target == EigenTarget::NearestShift){
+            // largest |theta| of (A-shift*I)^-1, lambda = shift+1/theta; converged only if the pairs hold on A
+            T inner = tol;
+            for(size_t pass = 0, its = 0; ; ++pass){
+                auto solve = MatrixImpl::shift_solver(A, shift, inner*static_cast<T>(1e-2));
+                res = MatrixImpl::lanczos(n, solve, k, m, 2, inner, max_restarts, values.data(), vectors.data());
+                for(auto &v : values)
+                    v = solve.shift()+1/v;
+                res.iterations = its += res.iterations;
+                res.residual = MatrixImpl::eigenpair_residual(A, k, values.data(), vectors.data());
+                res.converged = res.residual <= tol;
+                if(!MatrixImpl::shift_refine(res, tol, pass, inner)) break;
+            }
+        }
+        else{
+            auto apply = [&A](const T *x, T *y) { MatrixImpl::operator_apply(A, x, y); };
+            res = MatrixImpl::lanczos(n, apply, k, m, target == EigenTarget::Largest ? 0 : 1, tol, max_restarts, values.data(), vectors.data());
+        }
+        MatrixImpl::solver_result(result, res);
+
+        DynamicMatrix<T> vals(k, 1), vecs(n, k);
+        for(size_t j = 0; j < k; ++j){
+            vals(j, 0) = values[j];
+            for(size_t i = 0; i < n; ++i)
+                vecs(i, j) = vectors[j*n+i];
+        }
+        return std::make_tuple(vals, vecs);
+    }
+
+    template<typename Op>
+    std::tuple<DynamicMatrix<std::complex<typename Op::value_type>>, DynamicMatrix<std::complex<typename Op::value_type>>>
+    arnoldi_eigs(const Op &A, size_t k, EigenTarget target = EigenTarget::Largest, typename Op::value_type shift = 0,
+                 typename Op::value_type tol = 1e-10, size_t max_restarts = 300, size_t ncv = 0,
+                 SolverResult<typename Op::value_type> *result = nullptr){
+        typedef typename Op::value_type T;
+        typedef std::complex<T> C;
+        const size_t n = A.rows(), m = MatrixImpl::krylov_dimension<T>(A, k, ncv);
+        std::vector<C> values(k), vectors(k*n);
+        SolverResult<T> res;
+
+        if(target == EigenTarget::NearestShift){
+            T inner = tol;
+            for(size_t pass = 0, its = 0; ; ++pass){
+                auto solve = MatrixImpl::shift_solver(A, shift, inner*static_cast<T>(1e-2));
+                res = MatrixImpl::arnoldi(n, solve, k, m, 0, inner, max_restarts, values.data(), vectors.data());
+                for(auto &v : values)
+                    v = C(solve.shift())+C(1)/v;
+                res.iterations = its += res.iterations;
+                res.residual = MatrixImpl::eigenpair_residual(A, k, values.data(), vectors.data());
+                res.converged = res.residual <= tol;
+                if(!MatrixImpl::shift_refine(res, tol, pass, inner)) break;
+            }
+        }
+        else{
+            auto apply = [&A](const T *x, T *y) { MatrixImpl::operator_apply(A, x, y); };
+            res = MatrixImpl::arnoldi(n, apply, k, m, target == EigenTarget::Largest ? 0 : 1, tol, max_restarts, values.data(), vectors.data());
+        }
+        MatrixImpl::solver_result(result, res);
+
+        DynamicMatrix<C> vals(k, 1), vecs(n, k);
+        for(size_t j = 0; j < k; ++j){
+            vals(j, 0) = values[j];
+            for(size_t i = 0; i < n; ++i)
+                vecs(i, j) = vectors[j*n+i];
+        }
+        return std::make_tuple(vals, vecs);
+    }
+
+}   // Lee
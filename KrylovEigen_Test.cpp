@@ -0,0 +1,91 @@
+#include <iostream>
+#include <cmath>
+#include <cassert>
+#include <vector>
+#include <complex>
+#include "Sparse.hpp"
+#include "KrylovEigen.hpp"
+
+namespace{
+
+    // 1-D Laplacian, 4 on the diagonal and -1 off it: eigenvalues 4-2cos(j*pi/(n+1))
+    Lee::CSRMatrix<double> laplacian(size_t n){
+        std::vector<Lee::Triplet<double>> t;
+        for(size_t i = 0; i < n; ++i){
+            t.push_back({i, i, 4.0});
+            if(i) t.push_back({i, i-1, -1.0});
+            if(i+1 < n) t.push_back({i, i+1, -1.0});
+        }
+        return Lee::CSRMatrix<double>(n, n, t);
+    }
+
+    // distance from lambda to the nearest eigenvalue of laplacian(n)
+    double laplacian_error(size_t n, double lambda){
+        const double pi = std::acos(-1.0);
+        double err = 1e300;
+        for(size_t j = 1; j <= n; ++j)
+            err = std::min(err, std::abs(lambda-(4-2*std::cos(j*pi/(n+1)))));
+        return err;
+    }
+
+    // ||A*x-lambda*x||/(|lambda|*||x||) computed here, not taken from the solver
+    template<typename T>
+    double true_residual(const Lee::CSRMatrix<double> &A, std::complex<double> lambda, const Lee::DynamicMatrix<T> &V, size_t j){
+        const size_t n = A.rows();
+        double r = 0, nx = 0;
+        for(size_t i = 0; i < n; ++i){
+            std::complex<double> ax = 0;
+            for(size_t p = (i ? i-1 : 0); p < std::min(n, i+2); ++p)
+                ax += A(i, p)*std::complex<double>(V(p, j));
+            r += std::norm(ax-lambda*std::complex<double>(V(i, j)));
+            nx += std::norm(std::complex<double>(V(i, j)));
+        }
+        return std::sqrt(r/nx)/std::abs(lambda);
+    }
+
+    // interior shift: A-shift*I is indefinite and the inner GMRES solves are the weak point
+    void interior_shift(){
+        const size_t n = 100;
+        const double shift = 3.3, tol = 1e-10;
+        Lee::CSRMatrix<double> A = laplacian(n);
+
+        Lee::SolverResult<double> res;
+        auto a = Lee::arnoldi_eigs(A, 3, Lee::EigenTarget::NearestShift, shift, tol, 300, 0, &res);
+        assert(res.converged && "arnoldi, interior shift");
+        for(size_t j = 0; j < 3; ++j){
+            const std::complex<double> l = std::get<0>(a)(j, 0);
+            assert(true_residual(A, l, std::get<1>(a), j) <= tol && "arnoldi residual on A");
+            assert(laplacian_error(n, l.real()) < 1e-8 && std::abs(l.imag()) < 1e-8 && "arnoldi eigenvalue");
+            assert(std::abs(l.real()-shift) < 0.2 && "arnoldi, nearest to the shift");
+        }
+
+        auto s = Lee::lanczos_eigs(A, 3, Lee::EigenTarget::NearestShift, shift, tol, 300, 0, &res);
+        assert(res.converged && "lanczos, interior shift");
+        for(size_t j = 0; j < 3; ++j){
+            const double l = std::get<0>(s)(j, 0);
+            assert(true_residual(A, l, std::get<1>(s), j) <= tol && "lanczos residual on A");
+            assert(laplacian_error(n, l) < 1e-8 && "lanczos eigenvalue");
+        }
+    }
+
+    // a result reported converged must hold on A, whatever the inner solves did
+    void reported_residual(){
+        const size_t n = 400;
+        Lee::CSRMatrix<double> A = laplacian(n);
+        for(double shift : {2.5, 3.3, 4.0, 5.1}){
+            Lee::SolverResult<double> res;
+            auto s = Lee::lanczos_eigs(A, 2, Lee::EigenTarget::NearestShift, shift, 1e-10, 50, 0, &res);
+            for(size_t j = 0; j < 2; ++j)
+                assert((!res.converged || true_residual(A, std::get<0>(s)(j, 0), std::get<1>(s), j) <= 1e-10) &&
+                       "converged pair does not hold on A");
+        }
+    }
+
+}
+
+void KrylovEigen_Test(){
+    std::cout << "\nKrylov eigensolver Test:\n";
+    interior_shift();
+    reported_residual();
+    std::cout << "shift-invert Lanczos and Arnoldi on a sparse interior shift: ok\n";
+}
@@ -0,0 +1,165 @@
+#include <iostream>
+#include <cmath>
+#include <cassert>
+#include <vector>
+#include "Sparse.hpp"
+#include "Krylov.hpp"
+#include "LinearOperator.hpp"
+
+namespace{
+
+    // 1-D Laplacian, 4 on the diagonal and -1 off it; with upwind != 0 the two off-diagonals differ
+    Lee::CSRMatrix<double> laplacian(size_t n, double upwind = 0){
+        std::vector<Lee::Triplet<double>> t;
+        for(size_t i = 0; i < n; ++i){
+            t.push_back({i, i, 4.0});
+            if(i) t.push_back({i, i-1, -1.0-upwind});
+            if(i+1 < n) t.push_back({i, i+1, -1.0+upwind});
+        }
+        return Lee::CSRMatrix<double>(n, n, t);
+    }
+
+    // 5-point Laplacian on a k x k grid: ILU(0) and IC(0) drop fill-in here
+    Lee::CSRMatrix<double> laplacian2d(size_t k){
+        std::vector<Lee::Triplet<double>> t;
+        for(size_t i = 0; i < k; ++i)
+            for(size_t j = 0; j < k; ++j){
+                const size_t r = i*k+j;
+                t.push_back({r, r, 4.0});
+                if(i) t.push_back({r, r-k, -1.0});
+                if(i+1 < k) t.push_back({r, r+k, -1.0});
+                if(j) t.push_back({r, r-1, -1.0});
+                if(j+1 < k) t.push_back({r, r+1, -1.0});
+            }
+        return Lee::CSRMatrix<double>(k*k, k*k, t);
+    }
+
+    Lee::DynamicMatrix<double> rhs(size_t n){
+        Lee::DynamicMatrix<double> b(n, 1);
+        for(size_t i = 0; i < n; ++i)
+            b(i, 0) = std::sin(0.1*i)+1;
+        return b;
+    }
+
+    // ||b-A*x||_2 computed here, not taken from the solver
+    double true_residual(const Lee::CSRMatrix<double> &A, const Lee::DynamicMatrix<double> &b, const Lee::DynamicMatrix<double> &x){
+        const Lee::DynamicMatrix<double> ax = A*x;
+        double r = 0;
+        for(size_t i = 0; i < b.rows(); ++i)
+            r += (b(i, 0)-ax(i, 0))*(b(i, 0)-ax(i, 0));
+        return std::sqrt(r);
+    }
+
+    enum class Method { CG, BiCGSTAB, GMRES };
+
+    // solves to tol, checks the reported and the true residual, returns the iterations
+    template<typename P>
+    size_t solve(Method method, const Lee::CSRMatrix<double> &A, const P &M){
+        const double tol = 1e-10;
+        const size_t n = A.rows();
+        const Lee::DynamicMatrix<double> b = rhs(n), x0(n, 1, 0.0);
+        Lee::SolverResult<double> res = {false, 0, -1};
+        Lee::DynamicMatrix<double> x;
+        switch(method){
+            case Method::CG:       x = Lee::conjugate_gradient(A, b, x0, tol, 1000, M, &res); break;
+            case Method::BiCGSTAB: x = Lee::bicgstab(A, b, x0, tol, 1000, M, &res); break;
+            case Method::GMRES:    x = Lee::gmres(A, b, x0, tol, 30, 1000, M, &res); break;
+        }
+        assert(res.converged && res.residual <= tol && "Krylov solver did not converge");
+        assert(true_residual(A, b, x) <= 10*tol && "reported residual does not hold on A");
+        return res.iterations;
+    }
+
+    void solvers(){
+        const Lee::CSRMatrix<double> S = laplacian(300), N = laplacian(300, 0.5), G = laplacian2d(20);
+        const Lee::IdentityPreconditioner<double> I;
+
+        // CG on SPD; IC(0) of a tridiagonal matrix is exact, so one step is enough
+        for(const Lee::CSRMatrix<double> *A : {&S, &G}){
+            const size_t plain = solve(Method::CG, *A, I);
+            assert(solve(Method::CG, *A, Lee::JacobiPreconditioner<double>(*A)) <= plain+1 && "CG with Jacobi");
+            const size_t ic = solve(Method::CG, *A, Lee::IC0Preconditioner<double>(*A));
+            assert(ic < plain && (A != &S || ic <= 1) && "CG with IC(0)");
+        }
+
+        // BiCGSTAB and GMRES on the nonsymmetric matrix too; ILU(0) of a tridiagonal matrix is exact
+        for(const Lee::CSRMatrix<double> *A : {&S, &N, &G}){
+            for(Method method : {Method::BiCGSTAB, Method::GMRES}){
+                const size_t plain = solve(method, *A, I);
+                solve(method, *A, Lee::JacobiPreconditioner<double>(*A));
+                const size_t ilu = solve(method, *A, Lee::ILU0Preconditioner<double>(*A));
+                assert(ilu < plain && (A == &G || ilu <= 1) && "ILU(0) preconditioning");
+            }
+        }
+
+        // x0 already the solution: no iterations
+        const Lee::DynamicMatrix<double> b = rhs(S.rows());
+        const Lee::DynamicMatrix<double> x = Lee::conjugate_gradient(S, b, Lee::DynamicMatrix<double>(S.rows(), 1, 0.0), 1e-12);
+        Lee::SolverResult<double> res = {false, 1, -1};
+        Lee::gmres(S, b, x, 1e-10, 30, 1000, I, &res);
+        assert(res.converged && res.iterations == 0 && "solved start took iterations");
+    }
+
+    // the tridiagonal of laplacian(n, upwind) without storing it; every slot of make_operator filled
+    void operators(){
+        const size_t n = 300;
+        const double upwind = 0.5;
+        const Lee::CSRMatrix<double> N = laplacian(n, upwind);
+        auto apply = [=](const double *x, double *y){
+            for(size_t i = 0; i < n; ++i)
+                y[i] = 4*x[i]-(i ? (1+upwind)*x[i-1] : 0)-(i+1 < n ? (1-upwind)*x[i+1] : 0);
+        };
+        auto apply_t = [=](const double *x, double *y){
+            for(size_t i = 0; i < n; ++i)
+                y[i] = 4*x[i]-(i ? (1-upwind)*x[i-1] : 0)-(i+1 < n ? (1+upwind)*x[i+1] : 0);
+        };
+        auto diagonal = [=](){ return std::vector<double>(n, 4.0); };
+        const auto A = Lee::make_operator<double>(n, apply, apply_t, diagonal);
+        assert(A.rows() == n && A.cols() == n && "operator shape");
+
+        const Lee::DynamicMatrix<double> b = rhs(n), x0(n, 1, 0.0);
+        std::vector<double> y(n);
+        Lee::DynamicMatrix<double> ref = Lee::transpose_multiply(N, b);
+        MatrixImpl::operator_apply_transpose(A, b.data().data(), y.data());
+        for(size_t i = 0; i < n; ++i)
+            assert(std::abs(y[i]-ref(i, 0)) < 1e-12 && "operator apply_transpose");
+        const Lee::DynamicMatrix<double> ax = A*b, nx = N*b;
+        for(size_t i = 0; i < n; ++i)
+            assert(std::abs(ax(i, 0)-nx(i, 0)) < 1e-12 && "operator times a vector");
+
+        // the same solutions as with the stored matrix, the Jacobi preconditioner built from diagonal()
+        Lee::SolverResult<double> res = {false, 0, -1};
+        const Lee::DynamicMatrix<double> x = Lee::gmres(A, b, x0, 1e-10, 30, 1000, Lee::JacobiPreconditioner<double>(A), &res);
+        assert(res.converged && true_residual(N, b, x) <= 1e-9 && "GMRES on a matrix-free operator");
+        const Lee::DynamicMatrix<double> z = Lee::bicgstab(Lee::make_operator<double>(n, apply), b, x0, 1e-10, 1000,
+                                                           Lee::IdentityPreconditioner<double>(), &res);
+        assert(res.converged && true_residual(N, b, z) <= 1e-9 && "BiCGSTAB on an apply-only operator");
+
+        // dense models: a fixed-size and a dynamic matrix as the operator
+        Lee::Matrix<double, 8, 8> F;
+        Lee::Matrix<double, 8, 1> fb, fx0;
+        const Lee::CSRMatrix<double> S = laplacian(8);
+        for(size_t i = 0; i < 8; ++i){
+            for(size_t j = 0; j < 8; ++j) F(i, j) = S(i, j);
+            fb(i, 0) = i+1.0;
+            fx0(i, 0) = 0;
+        }
+        const Lee::Matrix<double, 8, 1> fx = Lee::conjugate_gradient(F, fb, fx0, 1e-12, 100, Lee::JacobiPreconditioner<double>(F), &res);
+        const Lee::Matrix<double, 8, 1> fr = F*fx-fb;
+        for(size_t i = 0; i < 8; ++i)
+            assert(res.converged && std::abs(fr(i, 0)) < 1e-11 && "CG on a fixed-size matrix");
+        const Lee::DynamicMatrix<double> D(F);
+        const Lee::DynamicMatrix<double> dx = Lee::conjugate_gradient(D, Lee::DynamicMatrix<double>(fb), Lee::DynamicMatrix<double>(8, 1, 0.0), 1e-12);
+        for(size_t i = 0; i < 8; ++i)
+            assert(std::abs(dx(i, 0)-fx(i, 0)) < 1e-10 && "CG on a dynamic matrix");
+    }
+
+}
+
+void Krylov_Test(){
+    std::cout << "\nKrylov Test:\n";
+    solvers();
+    std::cout << "CG, BiCGSTAB and GMRES with Jacobi, ILU(0) and IC(0): ok\n";
+    operators();
+    std::cout << "make_operator, fixed and dynamic dense matrices as operators: ok\n";
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <cstddef>
+#include "Gemm.hpp"
+
+/*
+** Compact LU factorization with partial pivoting
+** | lu_factor(n, a, lda, perm)     a = L\U in place, row i of L*U is row perm[i] of a;
+** |                                L unit lower (diagonal not stored), U upper
+** |                                returns the sign of the permutation, 0 when singular
+** | lu_solve(n, a, lda, perm, b, nrhs, ldb)
+** |                                b (n x nrhs) = A^-1 * b, O(n^2) per column
+** pivoting
+** | the candidate with the largest magnitude in the column
+** blocking
+** | n >= LEE_LU_BLOCKED: right-looking, LEE_LU_BLOCK columns per panel; the
+** | trailing update A22 -= L21*U12 is a GEMM call (Gemm.hpp)
+** all matrices row-major
+*/
+
+#ifndef LEE_LU_BLOCK
+#define LEE_LU_BLOCK 64
+#endif
+
+#ifndef LEE_LU_BLOCKED
+#define LEE_LU_BLOCKED 128
+#endif
+
+namespace MatrixImpl{
+
+    // columns [k0, k1) of rows [k0, n), rows swapped in full; returns 0 on a zero pivot
+    template<typename T>
+    int lu_panel(size_t n, T *a, size_t lda, size_t *perm, size_t k0, size_t k1){
+        int sign = 1;
+
+        for(size_t k = k0; k < k1; ++k){
+            size_t p = k;
+            T big = std::abs(a[k*lda+k]);
+            for(size_t i = k+1; i < n; ++i)
+                if(std::abs(a[i*lda+k]) > big) { big = std::abs(a[i*lda+k]); p = i; }
+
+            if(p != k){
+                std::swap_ranges(a+k*lda, a+k*lda+n, a+p*lda);
+                std::swap(perm[k], perm[p]);
+                sign = -sign;
+            }
+            if(big == static_cast<T>(0)) { sign = 0; continue; }
+
+            const T *uk = a+k*lda;
+            for(size_t i = k+1; i < n; ++i){
+                T *ai = a+i*lda;
+                const T l = ai[k] /= uk[k];
+                for(size_t j = k+1; j < k1; ++j)
+                    ai[j] -= l*uk[j];
+            }
+        }
+        return sign;
+    }
+
+    template<typename T>
+    int lu_factor(size_t n, T *a, size_t lda, size_t *perm){
+        for(size_t i = 0; i < n; ++i) perm[i] = i;
+        if(n < LEE_LU_BLOCKED) return lu_panel(n, a, lda, perm, 0, n);
+
+        int sign = 1;
+        for(size_t k0 = 0; k0 < n; k0 += LEE_LU_BLOCK){
+            const size_t k1 = std::min(n, k0+LEE_LU_BLOCK);
+            sign *= lu_panel(n, a, lda, perm, k0, k1);
+            if(k1 == n) break;
+
+            // U12 = L11^-1 * A12
+            for(size_t i = k0+1; i < k1; ++i){
+                T *ai = a+i*lda;
+                for(size_t p = k0; p < i; ++p){
+                    const T l = ai[p];
+                    const T *up = a+p*lda;
+                    for(size_t j = k1; j < n; ++j)
+                        ai[j] -= l*up[j];
+                }
+            }
+
+            // A22 -= L21*U12
+            gemm_parallel(n-k1, n-k1, k1-k0, static_cast<T>(-1), a+k1*lda+k0, lda, static_cast<size_t>(1),
+                          a+k0*lda+k1, lda, static_cast<size_t>(1), static_cast<T>(1), a+k1*lda+k1, lda);
+        }
+        return sign;
+    }
+
+    template<typename T>
+    void lu_solve(size_t n, const T *a, size_t lda, const size_t *perm, T *b, size_t nrhs, size_t ldb){
+        std::vector<T> x(n*nrhs);
+        for(size_t i = 0; i < n; ++i)
+            std::copy(b+perm[i]*ldb, b+perm[i]*ldb+nrhs, x.begin()+i*nrhs);
+
+        // L y = P b
+        for(size_t i = 0; i < n; ++i){
+            T *xi = x.data()+i*nrhs;
+            for(size_t p = 0; p < i; ++p){
+                const T l = a[i*lda+p];
+                const T *xp = x.data()+p*nrhs;
+                for(size_t j = 0; j < nrhs; ++j)
+                    xi[j] -= l*xp[j];
+            }
+        }
+
+        // U x = y
+        for(size_t i = n; i-- > 0; ){
+            T *xi = x.data()+i*nrhs;
+            for(size_t p = i+1; p < n; ++p){
+                const T u = a[i*lda+p];
+                const T *xp = x.data()+p*nrhs;
+                for(size_t j = 0; j < nrhs; ++j)
+                    xi[j] -= u*xp[j];
+            }
+            for(size_t j = 0; j < nrhs; ++j)
+                xi[j] /= a[i*lda+i];
+        }
+
+        for(size_t i = 0; i < n; ++i)
+            std::copy(x.begin()+i*nrhs, x.begin()+(i+1)*nrhs, b+i*ldb);
+    }
+
+}   // MatrixImpl
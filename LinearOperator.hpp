@@ -0,0 +1,161 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <cassert>
+#include <type_traits>
+#include "Matrix.hpp"
+#include "DynamicMatrix.hpp"
+#include "Sparse.hpp"
+#include "Gemm.hpp"
+
+/*
+** Operators the iterative algorithms accept in place of a matrix
+** concept, any type with
+** | rows(), cols()
+** | apply(x, y)                  y = A*x, x and y T* of cols() and rows() elements
+** | apply_transpose(x, y)        y = A^T*x, only for algorithms that need it
+** | diagonal()                   std::vector<T>, only for Jacobi iterations and preconditioners
+** models
+** | Matrix<T, N, N>, DynamicMatrix<T>, SparseMatrix<T, O>
+** | make_operator<T>(n, apply)                        apply(x, y) any callable, square n x n
+** | make_operator<T>(n, apply, apply_transpose)
+** | make_operator<T>(n, apply, apply_transpose, diagonal)
+** every call is resolved at compile time, lambdas are inlined into the solvers
+*/
+
+namespace Lee{
+
+    // a slot make_operator was not given
+    struct NoOperator{
+        template<typename... Args>
+        void operator()(Args&&...) const {}
+    };
+
+    template<typename T, typename Apply, typename ApplyT = NoOperator, typename Diagonal = NoOperator>
+    class LinearOperator{
+    public:
+        using value_type = T;
+
+        LinearOperator(size_t m, size_t n, Apply a, ApplyT at = ApplyT(), Diagonal d = Diagonal())
+            : nrows{m}, ncols{n}, fa(a), fat(at), fd(d) {}
+
+        size_t rows() const { return nrows; }
+
+        size_t cols() const { return ncols; }
+
+        void apply(const T *x, T *y) const { fa(x, y); }
+
+        void apply_transpose(const T *x, T *y) const{
+            static_assert(!std::is_same<ApplyT, NoOperator>::value, "operator made without apply_transpose");
+            fat(x, y);
+        }
+
+        std::vector<T> diagonal() const{
+            static_assert(!std::is_same<Diagonal, NoOperator>::value, "operator made without diagonal");
+            return fd();
+        }
+
+    private:
+        size_t nrows;
+        size_t ncols;
+        Apply fa;
+        ApplyT fat;
+        Diagonal fd;
+    };
+
+    template<typename T, typename Apply>
+    LinearOperator<T, Apply> make_operator(size_t n, Apply a){
+        return LinearOperator<T, Apply>(n, n, a);
+    }
+
+    template<typename T, typename Apply, typename ApplyT>
+    LinearOperator<T, Apply, ApplyT> make_operator(size_t n, Apply a, ApplyT at){
+        return LinearOperator<T, Apply, ApplyT>(n, n, a, at);
+    }
+
+    template<typename T, typename Apply, typename ApplyT, typename Diagonal>
+    LinearOperator<T, Apply, ApplyT, Diagonal> make_operator(size_t n, Apply a, ApplyT at, Diagonal d){
+        return LinearOperator<T, Apply, ApplyT, Diagonal>(n, n, a, at, d);
+    }
+
+    template<typename T, typename Apply, typename ApplyT, typename Diagonal, typename V>
+    DynamicMatrix<T> operator*(const LinearOperator<T, Apply, ApplyT, Diagonal> &A, const DynamicMatrix<T, V> &x){
+        assert(A.cols() == x.rows() && x.cols() == 1 && "dimensions do not match");
+        DynamicMatrix<T> tmp, y(A.rows(), 1);
+        if(y.rows()) A.apply(MatrixImpl::sparse_operand(x, tmp), &y(0, 0));
+        return y;
+    }
+
+}   // Lee
+
+namespace MatrixImpl{
+
+    // y = A*x
+    template<typename Op, typename T>
+    void operator_apply(const Op &A, const T *x, T *y) { A.apply(x, y); }
+
+    template<typename T, size_t N>
+    void operator_apply(const Lee::Matrix<T, N, N> &A, const T *x, T *y){
+        gemv_parallel(N, N, static_cast<T>(1), A.data().data(), N, 1, x, 1, static_cast<T>(0), y, 1);
+    }
+
+    template<typename T>
+    void operator_apply(const Lee::DynamicMatrix<T> &A, const T *x, T *y){
+        gemv_parallel(A.rows(), A.cols(), static_cast<T>(1), A.data().data(), A.cols(), 1, x, 1, static_cast<T>(0), y, 1);
+    }
+
+    template<typename T, Lee::SparseOrder O>
+    void operator_apply(const Lee::SparseMatrix<T, O> &A, const T *x, T *y){
+        sparse_multiply(A, false, x, y, 1);
+    }
+
+    // y = A^T*x
+    template<typename Op, typename T>
+    void operator_apply_transpose(const Op &A, const T *x, T *y) { A.apply_transpose(x, y); }
+
+    template<typename T, size_t N>
+    void operator_apply_transpose(const Lee::Matrix<T, N, N> &A, const T *x, T *y){
+        gemv_parallel(N, N, static_cast<T>(1), A.data().data(), 1, N, x, 1, static_cast<T>(0), y, 1);
+    }
+
+    template<typename T>
+    void operator_apply_transpose(const Lee::DynamicMatrix<T> &A, const T *x, T *y){
+        gemv_parallel(A.cols(), A.rows(), static_cast<T>(1), A.data().data(), 1, A.cols(), x, 1, static_cast<T>(0), y, 1);
+    }
+
+    template<typename T, Lee::SparseOrder O>
+    void operator_apply_transpose(const Lee::SparseMatrix<T, O> &A, const T *x, T *y){
+        sparse_multiply(A, true, x, y, 1);
+    }
+
+    template<typename Mat>
+    std::vector<typename Mat::value_type> dense_diagonal(const Mat &A){
+        std::vector<typename Mat::value_type> d(std::min(A.rows(), A.cols()));
+        for(size_t i = 0; i < d.size(); ++i)
+            d[i] = A(i, i);
+        return d;
+    }
+
+    template<typename Op>
+    auto operator_diagonal(const Op &A) -> decltype(A.diagonal()) { return A.diagonal(); }
+
+    template<typename T, size_t N, typename V>
+    std::vector<T> operator_diagonal(const Lee::Matrix<T, N, N, V> &A) { return dense_diagonal(A); }
+
+    template<typename T, typename V>
+    std::vector<T> operator_diagonal(const Lee::DynamicMatrix<T, V> &A) { return dense_diagonal(A); }
+
+    // r = b-A*x, returns ||r||
+    template<typename T, typename Op>
+    T operator_residual(size_t n, const Op &A, const T *b, const T *x, T *r){
+        operator_apply(A, x, r);
+        T s = 0;
+        for(size_t i = 0; i < n; ++i){
+            r[i] = b[i]-r[i];
+            s += r[i]*r[i];
+        }
+        return std::sqrt(s);
+    }
+
+}   // MatrixImpl
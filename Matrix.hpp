@@ -8,6 +8,14 @@
 #include <algorithm>
 #include <type_traits>
 #include <functional>
+#include <stdexcept>
+#include <memory>
+#include <mutex>
+
+// matrices with at most this many elements keep their elements inline
+#ifndef LEE_INLINE_STORAGE_MAX
+#define LEE_INLINE_STORAGE_MAX 16
+#endif
 
 /*
 ** Operation define:
@@ -25,6 +33,9 @@
 ** | Matrix a = {...}
 ** | Matrix a(b)
 ** | Matrix a = Matrix b
+** storage
+** | M*N <= LEE_INLINE_STORAGE_MAX: inlineStorage<T, M*N> (no heap allocation)
+** | otherwise: std::vector<T>
 ** visit
 ** | a(...)
 ** | a.row(i)
@@ -50,6 +61,30 @@ namespace MatrixImpl{
 
     template<typename T>
     struct abs;    
+
+    template<typename T, size_t S>
+    struct StorageSelect;
+
+    template<typename V>
+    struct Evaluator;
+
+    template<typename T>
+    struct BufferPool;
+
+    template<typename V>
+    struct IsExpensive;
+
+    template<typename V>
+    struct OperandHold;
+
+    template<typename T, typename V>
+    struct ProductOperand;
+
+    template<typename T, size_t M, size_t N, size_t N1, typename V1, typename V2>
+    struct ProductResult;
+
+    template<typename T, typename Chain>
+    void evaluate_chain(std::vector<T> &res, const Chain &c);
 }
 
 namespace Lee{
@@ -78,7 +113,67 @@ namespace Lee{
     template<typename T, size_t M, size_t N>
     class sliceMatrix;
 
-    template<typename T, size_t M, size_t N, typename V = std::vector<T>>
+    // fixed-size storage kept inside the matrix object: no heap allocation on
+    // construction, copy or materialization of small temporaries
+    template<typename T, size_t S>
+    class inlineStorage{
+    public:
+        using value_type     = T;
+        using iterator       = T*;
+        using const_iterator = const T*;
+
+        static constexpr size_t size() { return S; }
+
+        void resize(size_t n) { assert(n == S && "inline storage is fixed-size"); }
+
+        T& operator[](size_t i) { return elems[i]; }
+
+        const T& operator[](size_t i) const { return elems[i]; }
+
+        T* data() { return elems; }
+
+        const T* data() const { return elems; }
+
+        iterator begin() { return elems; }
+
+        const_iterator begin() const { return elems; }
+
+        iterator end() { return elems+S; }
+
+        const_iterator end() const { return elems+S; }
+
+    private:
+        alignas(alignof(T) > 16 ? alignof(T) : 16) T elems[S ? S : 1];
+    };
+
+    // a product operand evaluated once into a pooled buffer; copies share the buffer
+    template<typename T>
+    class tempStorage{
+    public:
+        using value_type     = T;
+        using iterator       = typename std::vector<T>::const_iterator;
+        using const_iterator = typename std::vector<T>::const_iterator;
+
+        explicit tempStorage(size_t n) 
+            : buf{MatrixImpl::BufferPool<T>::acquire(n), MatrixImpl::BufferPool<T>::release} {}
+
+        size_t size() const { return buf->size(); }
+
+        const T& operator[](size_t i) const { return (*buf)[i]; }
+
+        const T* data() const { return buf->data(); }
+
+        std::vector<T>& buffer() { return *buf; }
+
+        const_iterator begin() const { return buf->begin(); }
+
+        const_iterator end() const { return buf->end(); }
+
+    private:
+        std::shared_ptr<std::vector<T>> buf;
+    };
+
+    template<typename T, size_t M, size_t N, typename V = typename MatrixImpl::StorageSelect<T, M*N>::type>
     class Matrix{
     public:
         using value_type     = T;
@@ -106,8 +201,8 @@ namespace Lee{
         {
             assert(il.size() <= size() && "overinput");            
             
-            elems.assign(il);
-            elems.insert(elems.end(), size()-elems.size(), static_cast<T>(0));
+            elems.resize(M*N);
+            std::fill(std::copy(il.begin(), il.end(), elems.begin()), elems.end(), static_cast<T>(0));
 
             assert(elems.size() == M*N && "construction fail");            
         }
@@ -115,13 +210,15 @@ namespace Lee{
         Matrix(NestedInitializerListN<T, 2> il){
             assert(il.size() <= M && "rows overinput");
 
+            elems.resize(M*N);
+            std::fill(elems.begin(), elems.end(), static_cast<T>(0));
+            auto row = elems.begin();
             for(auto i : il){
                 assert(i.size() <= N && "cols overinput");
                 
-                std::copy(i.begin(), i.end(), std::back_inserter(elems));
-                elems.insert(elems.end(), N-i.size(), static_cast<T>(0));
+                std::copy(i.begin(), i.end(), row);
+                row += N;
             }
-            elems.insert(elems.end(), size()-elems.size(), static_cast<T>(0));
 
             assert(elems.size() == M*N && "construction fail");                
         }        
@@ -134,9 +231,7 @@ namespace Lee{
             MatrixImpl::matrix_valid(rhs);
 
             elems.resize(size());
-            for(size_t i = 0; i < M; ++i)
-                for(size_t j = 0; j < N; ++j)
-                    (*this)(i, j) = rhs(i, j); 
+            MatrixImpl::Evaluator<V1>::run(*this, rhs);
 
             assert(elems.size() == M*N && "assignment fail");                                          
         }
@@ -153,6 +248,8 @@ namespace Lee{
             assert(elems.size() == M*N && "assignment fail");                      
         }
 
+        Matrix(const Matrix &rhs) = default;
+
         Matrix(Matrix &&rhs) = default;      
 
         ~Matrix() = default;
@@ -173,8 +270,7 @@ namespace Lee{
         Matrix& operator=(NestedInitializerListN<T, 1> il){
             assert(il.size() <= size() && "overassign");            
             
-            elems.assign(il);
-            elems.insert(elems.end(), size()-elems.size(), static_cast<T>(0));
+            std::fill(std::copy(il.begin(), il.end(), elems.begin()), elems.end(), static_cast<T>(0));
 
             assert(elems.size() == M*N && "assignment fail");                       
             return *this;         
@@ -183,17 +279,15 @@ namespace Lee{
         Matrix& operator=(NestedInitializerListN<T, 2> il){
             assert(il.size() <= M && "rows overassign");
 
-            elems.clear();
-            
+            std::fill(elems.begin(), elems.end(), static_cast<T>(0));
+            auto row = elems.begin();
             for(auto i : il){
                 assert(i.size() <= N && "cols overassign");
                 
-                std::copy(i.begin(), i.end(), std::back_inserter(elems));
-                elems.insert(elems.end(), N-i.size(), static_cast<T>(0));
+                std::copy(i.begin(), i.end(), row);
+                row += N;
             }
 
-            elems.insert(elems.end(), size()-elems.size(), static_cast<T>(0));
-
             assert(elems.size() == M*N && "assignment fail");  
             return *this;                              
         }        
@@ -202,9 +296,7 @@ namespace Lee{
         Matrix& operator=(const Matrix<T, M, N, V1> &rhs){
             MatrixImpl::matrix_valid(rhs);
 
-            for(size_t i = 0; i < M; ++i)
-                for(size_t j = 0; j < N; ++j)
-                    (*this)(i, j) = rhs(i, j);
+            MatrixImpl::Evaluator<V1>::run(*this, rhs);
                     
             assert(elems.size() == M*N && "assignment fail");                      
             return *this;
@@ -230,13 +322,13 @@ namespace Lee{
         static constexpr size_t size() { return M*N; }
 
         template<typename F>
-        Matrix<T, M, N, applyProxy<T, V, F>> apply(F f){
+        Matrix<T, M, N, applyProxy<T, V, F>> apply(F f) const{
             return applyProxy<T, V, F>(data(), f);
         }
         
         // element access
         template<typename Q = V>
-        typename std::enable_if<MatrixImpl::IsParenType<Q>::value, T&>::type
+        typename std::enable_if<MatrixImpl::IsParenType<Q>::value, T>::type
         operator()(size_t i, size_t j){
             MatrixImpl::index_bounds_check(*this, i, j);   
             
@@ -297,18 +389,18 @@ namespace Lee{
         }
 
         // unary operations
-        Matrix<T, M, N, applyProxy<T, V, std::negate<T>>> operator-(){
+        Matrix<T, M, N, applyProxy<T, V, std::negate<T>>> operator-() const{
             return apply(std::negate<T>());
         }
 
         // binary operations
         template<typename V1>
-        Matrix<T, M, N, binaryProxy<T, V, V1, std::plus<T>>> operator+(const Matrix<T, M, N, V1> &rhs){
+        Matrix<T, M, N, binaryProxy<T, V, V1, std::plus<T>>> operator+(const Matrix<T, M, N, V1> &rhs) const{
             return binaryProxy<T, V, V1, std::plus<T>>(elems, rhs.data(), std::plus<T>());
         }
 
         template<typename V1>
-        Matrix<T, M, N, binaryProxy<T, V, V1, std::minus<T>>> operator-(const Matrix<T, M, N, V1> &rhs){
+        Matrix<T, M, N, binaryProxy<T, V, V1, std::minus<T>>> operator-(const Matrix<T, M, N, V1> &rhs) const{
             return binaryProxy<T, V, V1, std::minus<T>>(elems, rhs.data(), std::minus<T>());
         }
 
@@ -372,6 +464,12 @@ namespace Lee{
                     (*this)(i, j) = 0;            
         }
 
+        void permute(size_t r1, size_t r2){
+            if(r1 >= M || r2 >= M) throw std::out_of_range("Matrix index");
+            for(size_t j = 0; j != N; ++j)
+                std::swap((*this)(r1, j), (*this)(r2, j));
+        }
+
         bool is_diagonal(){
             MatrixImpl::matrix_valid(*this);       
             
@@ -531,6 +629,8 @@ namespace Lee{
             return func(lhs[i]);
         }
 
+        const V& left() const { return lhs; }
+
         size_t size() const{
             return lhs.size();
         }
@@ -577,6 +677,13 @@ namespace Lee{
             return vec[j*M+i];
         }
 
+        T operator[](size_t i) const{
+            size_t n = size()/M;
+            return vec[(i%n)*M+i/n];
+        }
+
+        const V& left() const { return vec; }
+
         iterator begin(){
             return iterator(*this, 0);
         }
@@ -627,6 +734,10 @@ namespace Lee{
             return func(lhs[i], rhs[i]);
         }
 
+        const V1& left() const { return lhs; }
+
+        const V2& right() const { return rhs; }
+
         size_t size() const { return lhs.size(); }
 
         iterator begin(){
@@ -665,6 +776,10 @@ namespace Lee{
             return func(lhs[i], rhs[i]);
         }
 
+        const V& left() const { return lhs; }
+
+        const Scalar<T>& right() const { return rhs; }
+
         size_t size() const { return lhs.size(); }
 
         iterator begin(){
@@ -703,6 +818,10 @@ namespace Lee{
             return func(lhs[i], rhs[i]);
         }
 
+        const Scalar<T>& left() const { return lhs; }
+
+        const V& right() const { return rhs; }
+
         size_t size() const { return rhs.size(); }
 
         iterator begin(){
@@ -761,6 +880,14 @@ namespace Lee{
             return res;
         }        
 
+        T operator[](size_t i) const{
+            return (*this)(i/N1, i%N1);
+        }
+
+        const V1& left() const { return lhs; }
+
+        const V2& right() const { return rhs; }
+
         iterator begin(){
             return iterator(*this, 0);
         }
@@ -778,8 +905,68 @@ namespace Lee{
         }
 
     private:
-        const V1 &lhs;
-        const V2 &rhs;
+        typename MatrixImpl::OperandHold<V1>::type lhs;
+        typename MatrixImpl::OperandHold<V2>::type rhs;
+    };
+
+    // A*B*C*...: multiplied in the cheapest order, worked out from Dims at compile time
+    template<typename T, typename Dims, typename... Vs>
+    class matrixChainProxy{
+    public:
+        using value_type     = T;
+        using iterator       = Iterator<T, matrixChainProxy>;
+        using const_iterator = ConstIterator<T, matrixChainProxy>;
+        using dims           = Dims;
+        using operand_tuple  = std::tuple<typename MatrixImpl::OperandHold<Vs>::type...>;
+
+        static const size_t M  = Dims::value[0];
+        static const size_t N1 = Dims::value[sizeof...(Vs)];
+
+        explicit matrixChainProxy(const operand_tuple &ops) 
+            : opds(ops), cache{std::make_shared<Cache>()} {}
+
+        size_t size() const { return M*N1; }
+
+        // element access evaluates the whole chain once
+        T operator()(size_t r, size_t c) const{
+            return evaluated()[r*N1+c];
+        }
+
+        T operator[](size_t i) const{
+            return evaluated()[i];
+        }
+
+        const operand_tuple& operands() const { return opds; }
+
+        iterator begin(){
+            return iterator(*this, 0);
+        }
+
+        const_iterator begin() const{
+            return const_iterator(*this, 0);
+        }
+
+        iterator end(){
+            return iterator(*this, size());
+        }
+
+        const_iterator end() const{
+            return const_iterator(*this, size());
+        }
+
+    private:
+        struct Cache{
+            std::once_flag once;
+            std::vector<T> elems;
+        };
+
+        const std::vector<T>& evaluated() const{
+            std::call_once(cache->once, [this]{ MatrixImpl::evaluate_chain(cache->elems, *this); });
+            return cache->elems;
+        }
+
+        operand_tuple opds;
+        std::shared_ptr<Cache> cache;
     };
 
     /* binary operations */
@@ -871,10 +1058,12 @@ namespace Lee{
     }
 
     // matrix multiplication 
+    // products of products become one matrixChainProxy; any other operand that 
+    // contains a product is evaluated once instead of per element
     template<typename T, size_t M1, size_t N, size_t N1, typename V1, typename V2>
-    Matrix<T, M1, N1, matrixMultiProxy<T, M1, N, N1, V1, V2>>
+    Matrix<T, M1, N1, typename MatrixImpl::ProductResult<T, M1, N, N1, V1, V2>::type>
     operator*(const Matrix<T, M1, N, V1> &lhs, const Matrix<T, N, N1, V2> &rhs){
-        return matrixMultiProxy<T, M1, N, N1, V1, V2>(lhs.data(), rhs.data());
+        return MatrixImpl::ProductResult<T, M1, N, N1, V1, V2>::get(lhs, rhs);
     }
     
     template<typename T, size_t M, size_t N>
@@ -958,3 +1147,6 @@ namespace Lee{
     }
 
 }   // Lee
+
+#include "Matrix_Impl.hpp"
+#include "Evaluator.hpp"
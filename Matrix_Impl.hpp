@@ -3,8 +3,31 @@
 #include <type_traits>
 #include <algorithm>
 #include <functional>
+#include <vector>
+#include <tuple>
 
 namespace Lee{
+    template<typename T, size_t S>
+    class inlineStorage;
+
+    template<typename T>
+    class tempStorage;
+
+    template<typename T>
+    class Scalar;
+
+    template<typename T, typename V, typename F>
+    class applyProxy;
+
+    template<typename T, typename V1, typename V2, typename F>
+    class binaryProxy;
+
+    template<typename T, typename V, typename F>
+    class binaryProxyRScalar;
+
+    template<typename T, typename V, typename F>
+    class binaryProxyLScalar;
+
     template<typename T, size_t M, size_t N, typename V>
     class Matrix;    
 
@@ -14,6 +37,18 @@ namespace Lee{
     template<typename T, size_t M, size_t N, size_t N1, typename V1, typename V2>
     class matrixMultiProxy;    
 
+    template<typename T, typename Dims, typename... Vs>
+    class matrixChainProxy;
+
+    template<typename T, typename V>
+    class DynamicMatrix;
+
+    template<typename T, typename V>
+    class dynamicTransProxy;
+
+    template<typename T, typename V1, typename V2>
+    class dynamicMultiProxy;
+
 }
 
 namespace MatrixImpl{
@@ -34,6 +69,13 @@ namespace MatrixImpl{
     template<typename T, size_t N>
     using NestedInitializerListN = typename NestedInitializerList<T, N>::type;
 
+    // small matrices live inline, large ones on the heap
+    template<typename T, size_t S>
+    struct StorageSelect{
+        using type = typename std::conditional<(S <= LEE_INLINE_STORAGE_MAX), 
+                                               Lee::inlineStorage<T, S>, std::vector<T>>::type;
+    };
+
     template<typename T>
     struct IsMatrixType{
         static const bool value = false;
@@ -44,6 +86,11 @@ namespace MatrixImpl{
         static const bool value = true;
     }; 
 
+    template<typename T, typename V>
+    struct IsMatrixType<Lee::DynamicMatrix<T, V>>{
+        static const bool value = true;
+    };
+
     template<typename T>
     struct IsParenType{
         static const bool value = false;
@@ -59,6 +106,216 @@ namespace MatrixImpl{
         static const bool value = true;
     };
 
+    template<typename T, typename V>
+    struct IsParenType<Lee::dynamicTransProxy<T, V>>{
+        static const bool value = true;
+    };
+
+    template<typename T, typename V1, typename V2>
+    struct IsParenType<Lee::dynamicMultiProxy<T, V1, V2>>{
+        static const bool value = true;
+    };
+
+    template<typename T, typename Dims, typename... Vs>
+    struct IsParenType<Lee::matrixChainProxy<T, Dims, Vs...>>{
+        static const bool value = true;
+    };
+
+    // proxies whose elements cost more than O(1): anything containing a product
+    template<typename V>
+    struct IsExpensive{
+        static const bool value = false;
+    };
+
+    template<typename T, size_t M, size_t N, size_t N1, typename V1, typename V2>
+    struct IsExpensive<Lee::matrixMultiProxy<T, M, N, N1, V1, V2>>{
+        static const bool value = true;
+    };
+
+    template<typename T, typename V1, typename V2>
+    struct IsExpensive<Lee::dynamicMultiProxy<T, V1, V2>>{
+        static const bool value = true;
+    };
+
+    template<typename T, typename Dims, typename... Vs>
+    struct IsExpensive<Lee::matrixChainProxy<T, Dims, Vs...>>{
+        static const bool value = true;
+    };
+
+    template<typename T, size_t M, typename V>
+    struct IsExpensive<Lee::transProxy<T, M, V>>{
+        static const bool value = IsExpensive<V>::value;
+    };
+
+    template<typename T, typename V>
+    struct IsExpensive<Lee::dynamicTransProxy<T, V>>{
+        static const bool value = IsExpensive<V>::value;
+    };
+
+    template<typename T, typename V, typename F>
+    struct IsExpensive<Lee::applyProxy<T, V, F>>{
+        static const bool value = IsExpensive<V>::value;
+    };
+
+    template<typename T, typename V1, typename V2, typename F>
+    struct IsExpensive<Lee::binaryProxy<T, V1, V2, F>>{
+        static const bool value = IsExpensive<V1>::value || IsExpensive<V2>::value;
+    };
+
+    template<typename T, typename V, typename F>
+    struct IsExpensive<Lee::binaryProxyRScalar<T, V, F>>{
+        static const bool value = IsExpensive<V>::value;
+    };
+
+    template<typename T, typename V, typename F>
+    struct IsExpensive<Lee::binaryProxyLScalar<T, V, F>>{
+        static const bool value = IsExpensive<V>::value;
+    };
+
+    // proxies refer to their operands, but own the temporaries they evaluated
+    template<typename V>
+    struct OperandHold{
+        using type = const V&;
+    };
+
+    template<typename T>
+    struct OperandHold<Lee::tempStorage<T>>{
+        using type = Lee::tempStorage<T>;
+    };
+
+    template<typename T, typename Mat>
+    Lee::tempStorage<T> materialize(const Mat &m);
+
+    // what a product keeps of an operand with storage V
+    template<typename T, typename V, bool = IsExpensive<V>::value>
+    struct ProductOperandImpl{
+        using type = V;
+
+        template<typename Mat>
+        static const V& get(const Mat &m) { return m.data(); }
+    };
+
+    template<typename T, typename V>
+    struct ProductOperandImpl<T, V, true>{
+        using type = Lee::tempStorage<T>;
+
+        template<typename Mat>
+        static Lee::tempStorage<T> get(const Mat &m) { return materialize<T>(m); }
+    };
+
+    template<typename T, typename V>
+    struct ProductOperand : ProductOperandImpl<T, V> {};
+
+    // d0 x d1, d1 x d2, ...: dimensions of the operands of a product chain
+    template<size_t... D>
+    struct ChainDims{
+        static constexpr size_t value[sizeof...(D)] = {D...};
+    };
+
+    template<size_t... D>
+    constexpr size_t ChainDims<D...>::value[sizeof...(D)];
+
+    template<typename D1, typename D2>
+    struct ChainDimsJoin;
+
+    template<size_t... D1, size_t K, size_t... D2>
+    struct ChainDimsJoin<ChainDims<D1...>, ChainDims<K, D2...>>{
+        using type = ChainDims<D1..., D2...>;
+    };
+
+    template<typename T, typename Dims, typename Ops>
+    struct ChainMake;
+
+    template<typename T, typename Dims, typename... Vs>
+    struct ChainMake<T, Dims, std::tuple<Vs...>>{
+        using type = Lee::matrixChainProxy<T, Dims, Vs...>;
+    };
+
+    template<typename O1, typename O2>
+    struct ChainOpsJoin;
+
+    template<typename... V1, typename... V2>
+    struct ChainOpsJoin<std::tuple<V1...>, std::tuple<V2...>>{
+        using type = std::tuple<V1..., V2...>;
+    };
+
+    // an R x C operand V as a list of chain operands
+    template<typename T, size_t R, size_t C, typename V>
+    struct ChainOf{
+        using dims = ChainDims<R, C>;
+        using ops  = std::tuple<typename ProductOperand<T, V>::type>;
+
+        template<typename Mat>
+        static std::tuple<typename OperandHold<typename ProductOperand<T, V>::type>::type> get(const Mat &m){
+            return std::tuple<typename OperandHold<typename ProductOperand<T, V>::type>::type>(ProductOperand<T, V>::get(m));
+        }
+    };
+
+    template<typename T, size_t R, size_t K, size_t C, typename V1, typename V2>
+    struct ChainOf<T, R, C, Lee::matrixMultiProxy<T, R, K, C, V1, V2>>{
+        using dims = ChainDims<R, K, C>;
+        using ops  = std::tuple<V1, V2>;
+
+        template<typename Mat>
+        static std::tuple<typename OperandHold<V1>::type, typename OperandHold<V2>::type> get(const Mat &m){
+            return std::tuple<typename OperandHold<V1>::type, typename OperandHold<V2>::type>(m.data().left(), m.data().right());
+        }
+    };
+
+    template<typename T, size_t R, size_t C, typename Dims, typename... Vs>
+    struct ChainOf<T, R, C, Lee::matrixChainProxy<T, Dims, Vs...>>{
+        using dims = Dims;
+        using ops  = std::tuple<Vs...>;
+
+        template<typename Mat>
+        static std::tuple<typename OperandHold<Vs>::type...> get(const Mat &m){
+            return m.data().operands();
+        }
+    };
+
+    template<typename V>
+    struct IsProduct{
+        static const bool value = false;
+    };
+
+    template<typename T, size_t M, size_t N, size_t N1, typename V1, typename V2>
+    struct IsProduct<Lee::matrixMultiProxy<T, M, N, N1, V1, V2>>{
+        static const bool value = true;
+    };
+
+    template<typename T, typename Dims, typename... Vs>
+    struct IsProduct<Lee::matrixChainProxy<T, Dims, Vs...>>{
+        static const bool value = true;
+    };
+
+    // storage of lhs*rhs: a plain product of two operands, or a chain of three or more
+    template<typename T, size_t M, size_t N, size_t N1, typename V1, typename V2, 
+             bool = IsProduct<V1>::value || IsProduct<V2>::value>
+    struct ProductResultImpl{
+        using type = Lee::matrixMultiProxy<T, M, N, N1, typename ProductOperand<T, V1>::type, 
+                                                        typename ProductOperand<T, V2>::type>;
+
+        template<typename Mat1, typename Mat2>
+        static type get(const Mat1 &lhs, const Mat2 &rhs){
+            return type(ProductOperand<T, V1>::get(lhs), ProductOperand<T, V2>::get(rhs));
+        }
+    };
+
+    template<typename T, size_t M, size_t N, size_t N1, typename V1, typename V2>
+    struct ProductResultImpl<T, M, N, N1, V1, V2, true>{
+        using type = typename ChainMake<T, 
+            typename ChainDimsJoin<typename ChainOf<T, M, N, V1>::dims, typename ChainOf<T, N, N1, V2>::dims>::type,
+            typename ChainOpsJoin<typename ChainOf<T, M, N, V1>::ops, typename ChainOf<T, N, N1, V2>::ops>::type>::type;
+
+        template<typename Mat1, typename Mat2>
+        static type get(const Mat1 &lhs, const Mat2 &rhs){
+            return type(std::tuple_cat(ChainOf<T, M, N, V1>::get(lhs), ChainOf<T, N, N1, V2>::get(rhs)));
+        }
+    };
+
+    template<typename T, size_t M, size_t N, size_t N1, typename V1, typename V2>
+    struct ProductResult : ProductResultImpl<T, M, N, N1, V1, V2> {};
+
     template<typename M>
     void index_bounds_check(const M &m, size_t r, size_t c){
         if(IsMatrixType<M>::value) assert(r<m.rows() && c<m.cols() && "index out of range");
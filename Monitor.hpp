@@ -0,0 +1,79 @@
+#pragma once
+
+#include <chrono>
+#include <ostream>
+#include <type_traits>
+
+/*
+** Progress and outcome of the iterative solvers
+** | SolverResult<T>          converged, iterations, residual = ||b-A*x||_2 at the end
+** | monitor(k, r, t)         called after iteration k with its residual and the seconds
+** |                          since the solver started; any callable, lambdas included
+** | NullMonitor              the default, inlines to nothing and the clock is never read
+** | StreamMonitor(os)        one line per iteration on os
+*/
+
+namespace Lee{
+
+    template<typename T>
+    struct SolverResult{
+        bool converged;
+        size_t iterations;
+        T residual;
+    };
+
+    struct NullMonitor{
+        template<typename T>
+        void operator()(size_t, T, double) const {}
+    };
+
+    class StreamMonitor{
+    public:
+        explicit StreamMonitor(std::ostream &o) : os(&o) {}
+
+        template<typename T>
+        void operator()(size_t k, T residual, double seconds) const{
+            *os << "iteration " << k << ": residual " << residual << ", " << seconds << " s\n";
+        }
+
+    private:
+        std::ostream *os;
+    };
+
+}   // Lee
+
+namespace MatrixImpl{
+
+    template<typename Mon>
+    struct MonitorEnabled : std::true_type {};
+
+    template<>
+    struct MonitorEnabled<Lee::NullMonitor> : std::false_type {};
+
+    // seconds since construction, read only for a monitor that wants it
+    template<bool Enabled>
+    class SolverClock{
+    public:
+        SolverClock() : start(std::chrono::steady_clock::now()) {}
+
+        double elapsed() const { return std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count(); }
+
+    private:
+        std::chrono::steady_clock::time_point start;
+    };
+
+    template<>
+    class SolverClock<false>{
+    public:
+        constexpr double elapsed() const { return 0; }
+    };
+
+    template<typename Mon>
+    using SolverClockFor = SolverClock<MonitorEnabled<Mon>::value>;
+
+    template<typename T>
+    inline void solver_result(Lee::SolverResult<T> *out, const Lee::SolverResult<T> &res){
+        if(out) *out = res;
+    }
+
+}   // MatrixImpl
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+
+/*
+** Row-block parallelism for materializing large expressions
+** | set_num_threads(n)           threads used, 0: one per hardware thread
+** | set_parallel_threshold(n)    results with fewer elements stay on the calling thread;
+** |                              above it every thread gets at least n/4 elements
+** workers
+** | one process-wide pool, started on first use and grown up to num_threads()-1; the calling
+** | thread takes row blocks too, so a busy pool only means fewer helpers
+** | calls from inside a pool thread run serially; an exception thrown by f on any thread
+** | is rethrown on the calling thread once every block has stopped
+** link with -pthread
+*/
+
+#ifndef LEE_PARALLEL_THRESHOLD
+#define LEE_PARALLEL_THRESHOLD (1 << 16)
+#endif
+
+namespace MatrixImpl{
+
+    struct ParallelConfig{
+        static size_t& threads(){
+            static size_t n = 0;
+            return n;
+        }
+
+        static size_t& threshold(){
+            static size_t n = LEE_PARALLEL_THRESHOLD;
+            return n;
+        }
+    };
+
+}   // MatrixImpl
+
+namespace Lee{
+
+    inline void set_num_threads(size_t n) { MatrixImpl::ParallelConfig::threads() = n; }
+
+    inline size_t num_threads(){
+        size_t n = MatrixImpl::ParallelConfig::threads();
+        if(n == 0) n = std::thread::hardware_concurrency();
+        return n ? n : 1;
+    }
+
+    inline void set_parallel_threshold(size_t n) { MatrixImpl::ParallelConfig::threshold() = n; }
+
+    inline size_t parallel_threshold() { return MatrixImpl::ParallelConfig::threshold(); }
+
+}   // Lee
+
+namespace MatrixImpl{
+
+    class ThreadPool{
+    public:
+        // blocks [0, blocks) of one parallel call, claimed through next
+        struct Job{
+            Job(void (*c)(const void*, size_t), const void *x, size_t n) 
+                : call{c}, ctx{x}, blocks{n}, next{0}, running{0} {}
+
+            void (*call)(const void*, size_t);
+            const void *ctx;
+            size_t blocks;
+            std::atomic<size_t> next;
+            size_t running;             // pool threads working on it, guarded by the pool mutex
+            std::exception_ptr error;
+        };
+
+        static ThreadPool& instance(){
+            static ThreadPool pool;
+            return pool;
+        }
+
+        static bool& worker(){
+            static thread_local bool w = false;
+            return w;
+        }
+
+        ~ThreadPool(){
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                stop = true;
+            }
+            wake.notify_all();
+            for(auto &t : threads) t.join();
+        }
+
+        // job on the calling thread and up to helpers pool threads; returns when no thread is left in it
+        void run(Job &job, size_t helpers){
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                grow(helpers);
+                helpers = std::min(helpers, threads.size());
+                for(size_t i = 0; i < helpers; ++i) queue.push_back(&job);
+            }
+            wake.notify_all();
+            work(job);
+
+            std::unique_lock<std::mutex> lock(mtx);
+            queue.erase(std::remove(queue.begin(), queue.end(), &job), queue.end());
+            done.wait(lock, [&job]{ return job.running == 0; });
+            if(job.error) std::rethrow_exception(job.error);
+        }
+
+    private:
+        ThreadPool() = default;
+
+        // a thread that fails to start only means one helper less
+        void grow(size_t n){
+            try{
+                while(threads.size() < n)
+                    threads.emplace_back(&ThreadPool::loop, this);
+            }
+            catch(...) {}
+        }
+
+        void work(Job &job){
+            for(size_t b; (b = job.next++) < job.blocks; ){
+                try{
+                    job.call(job.ctx, b);
+                }
+                catch(...){
+                    std::lock_guard<std::mutex> lock(mtx);
+                    if(!job.error) job.error = std::current_exception();
+                    job.next = job.blocks;
+                }
+            }
+        }
+
+        void loop(){
+            worker() = true;
+            std::unique_lock<std::mutex> lock(mtx);
+            for(;;){
+                wake.wait(lock, [this]{ return stop || !queue.empty(); });
+                if(stop) return;
+                Job *job = queue.front();
+                queue.pop_front();
+                ++job->running;
+                lock.unlock();
+                work(*job);
+                lock.lock();
+                if(--job->running == 0) done.notify_all();
+            }
+        }
+
+        std::mutex mtx;
+        std::condition_variable wake, done;
+        std::deque<Job*> queue;
+        std::vector<std::thread> threads;
+        bool stop = false;
+    };
+
+    template<typename F>
+    struct RowBlocks{
+        F &f;
+        size_t rows, block;
+
+        static void call(const void *p, size_t b){
+            const RowBlocks &r = *static_cast<const RowBlocks*>(p);
+            r.f(b*r.block, std::min(r.rows, (b+1)*r.block));
+        }
+    };
+
+    // f(r0, r1) over row blocks of [0, rows); work: elements the whole call touches
+    template<typename F>
+    void parallel_rows(size_t rows, size_t work, F f){
+        const size_t grain = std::max<size_t>(Lee::parallel_threshold()/4, 1);
+        const size_t nthreads = std::min(std::min(Lee::num_threads(), rows), work/grain);
+        if(work < Lee::parallel_threshold() || nthreads <= 1 || ThreadPool::worker()) { f(0, rows); return; }
+
+        const size_t block = (rows+nthreads-1)/nthreads;
+        const RowBlocks<F> blocks{f, rows, block};
+        ThreadPool::Job job(&RowBlocks<F>::call, &blocks, (rows+block-1)/block);
+        ThreadPool::instance().run(job, job.blocks-1);
+    }
+
+}   // MatrixImpl
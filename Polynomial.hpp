@@ -3,7 +3,25 @@
 
 #include <iostream>
 #include <set>
+#include <vector>
+#include <initializer_list>
+#include <algorithm>
+#include <type_traits>
+#include <cstddef>
 #include <cmath>    // pow
+#include "Simd.hpp"
+#include "Parallel.hpp"
+
+/*
+** Poly: sparse integer terms kept in a std::set
+** Polynomial<T>: dense floating-point coefficients, c[i] the coefficient of x^i
+** | p(x)                     Horner
+** | p.evaluate(x, y, n)      y[i] = p(x[i]), a SIMD packet of points per Horner step,
+** |                          four packets in flight to hide the multiply-add latency;
+** |                          large batches are split over threads (Parallel.hpp)
+** | p(xs)                    the same on a std::vector
+** | +, -, *, derivative()    coefficient-vector arithmetic, trailing zeros trimmed
+*/
 
 namespace{
     struct Term{
@@ -102,4 +120,203 @@ namespace{
         return sum;
     }
 }
+
+namespace MatrixImpl{
+
+    // y[i] = sum_k c[k]*x[i]^k for i in [first, last), c of length nc > 0
+    template<typename T>
+    inline void horner_scalar(const T *c, size_t nc, const T *x, T *y, size_t first, size_t last){
+        for(size_t i = first; i < last; ++i){
+            const T t = x[i];
+            T acc = c[nc-1];
+            for(size_t k = nc-1; k-- > 0; )
+                acc = acc*t+c[k];
+            y[i] = acc;
+        }
+    }
+
+#if defined(__GNUC__)
+    template<typename T, size_t B>
+    inline void horner_n(const T *c, size_t nc, const T *x, T *y, size_t first, size_t last){
+        typedef typename PacketType<T, B>::type P;
+        const size_t W = B/sizeof(T);
+
+        size_t i = first;
+        for(; i+4*W <= last; i += 4*W){
+            P t0, t1, t2, t3, a0, a1, a2, a3;
+            std::memcpy(&t0, x+i, B);
+            std::memcpy(&t1, x+i+W, B);
+            std::memcpy(&t2, x+i+2*W, B);
+            std::memcpy(&t3, x+i+3*W, B);
+            packet_broadcast(a0, c[nc-1]);
+            a1 = a2 = a3 = a0;
+            for(size_t k = nc-1; k-- > 0; ){
+                P ck;
+                packet_broadcast(ck, c[k]);
+                a0 = a0*t0+ck;
+                a1 = a1*t1+ck;
+                a2 = a2*t2+ck;
+                a3 = a3*t3+ck;
+            }
+            std::memcpy(y+i, &a0, B);
+            std::memcpy(y+i+W, &a1, B);
+            std::memcpy(y+i+2*W, &a2, B);
+            std::memcpy(y+i+3*W, &a3, B);
+        }
+        for(; i+W <= last; i += W){
+            P t, a;
+            std::memcpy(&t, x+i, B);
+            packet_broadcast(a, c[nc-1]);
+            for(size_t k = nc-1; k-- > 0; ){
+                P ck;
+                packet_broadcast(ck, c[k]);
+                a = a*t+ck;
+            }
+            std::memcpy(y+i, &a, B);
+        }
+        horner_scalar(c, nc, x, y, i, last);
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    template<typename T>
+    __attribute__((target("avx512f,fma"), flatten))
+    void horner_avx512(const T *c, size_t nc, const T *x, T *y, size_t first, size_t last){
+        horner_n<T, 64>(c, nc, x, y, first, last);
+    }
+
+    template<typename T>
+    __attribute__((target("avx2,fma"), flatten))
+    void horner_avx2(const T *c, size_t nc, const T *x, T *y, size_t first, size_t last){
+        horner_n<T, 32>(c, nc, x, y, first, last);
+    }
+#endif
+
+    template<typename T>
+    void horner_packet(const T *c, size_t nc, const T *x, T *y, size_t first, size_t last){
+#if defined(__x86_64__) || defined(__i386__)
+        static const bool fma = __builtin_cpu_supports("fma");
+        switch(fma ? simd_level() : 0){
+            case 2:  horner_avx512(c, nc, x, y, first, last); return;
+            case 1:  horner_avx2(c, nc, x, y, first, last); return;
+            default: break;
+        }
+#endif
+        horner_n<T, 16>(c, nc, x, y, first, last);
+    }
+#else
+    template<typename T>
+    void horner_packet(const T *c, size_t nc, const T *x, T *y, size_t first, size_t last){
+        horner_scalar(c, nc, x, y, first, last);
+    }
+#endif
+
+}   // MatrixImpl
+
+namespace Lee{
+
+    template<typename T = double>
+    class Polynomial{
+        static_assert(std::is_floating_point<T>::value, "polynomial coefficients must be floating-point");
+    public:
+        Polynomial() : c{} {}
+        Polynomial(std::initializer_list<T> il) : c(il) { trim(); }
+        explicit Polynomial(std::vector<T> coefficients) : c(std::move(coefficients)) { trim(); }
+
+        // degree of the zero polynomial: 0
+        size_t degree() const { return c.empty() ? 0 : c.size()-1; }
+        T operator[](size_t k) const { return k < c.size() ? c[k] : static_cast<T>(0); }
+        const std::vector<T>& coefficients() const { return c; }
+
+        T operator()(T x) const{
+            if(c.empty()) return static_cast<T>(0);
+            T y;
+            MatrixImpl::horner_scalar(c.data(), c.size(), &x, &y, 0, 1);
+            return y;
+        }
+
+        // y[i] = p(x[i]), i < n; x and y may be the same array
+        void evaluate(const T *x, T *y, size_t n) const{
+            if(c.empty()) { std::fill(y, y+n, static_cast<T>(0)); return; }
+            const T *cp = c.data();
+            const size_t nc = c.size();
+            MatrixImpl::parallel_rows(n, n*nc, [=](size_t i0, size_t i1){
+                MatrixImpl::horner_packet(cp, nc, x, y, i0, i1);
+            });
+        }
+
+        std::vector<T> operator()(const std::vector<T> &x) const{
+            std::vector<T> y(x.size());
+            evaluate(x.data(), y.data(), x.size());
+            return y;
+        }
+
+        Polynomial operator-() const{
+            Polynomial res(*this);
+            for(auto &a : res.c) a = -a;
+            return res;
+        }
+
+        Polynomial operator+(const Polynomial &p) const{
+            std::vector<T> r(std::max(c.size(), p.c.size()), static_cast<T>(0));
+            for(size_t k = 0; k < c.size(); ++k) r[k] += c[k];
+            for(size_t k = 0; k < p.c.size(); ++k) r[k] += p.c[k];
+            return Polynomial(std::move(r));
+        }
+
+        Polynomial operator-(const Polynomial &p) const { return (*this)+(-p); }
+
+        Polynomial operator*(const Polynomial &p) const{
+            if(c.empty() || p.c.empty()) return Polynomial();
+            std::vector<T> r(c.size()+p.c.size()-1, static_cast<T>(0));
+            for(size_t i = 0; i < c.size(); ++i)
+                for(size_t j = 0; j < p.c.size(); ++j)
+                    r[i+j] += c[i]*p.c[j];
+            return Polynomial(std::move(r));
+        }
+
+        Polynomial operator*(T a) const{
+            std::vector<T> r(c);
+            for(auto &x : r) x *= a;
+            return Polynomial(std::move(r));
+        }
+
+        Polynomial derivative() const{
+            if(c.size() < 2) return Polynomial();
+            std::vector<T> r(c.size()-1);
+            for(size_t k = 1; k < c.size(); ++k)
+                r[k-1] = static_cast<T>(k)*c[k];
+            return Polynomial(std::move(r));
+        }
+
+    private:
+        std::vector<T> c;
+
+        void trim(){
+            while(!c.empty() && c.back() == static_cast<T>(0)) c.pop_back();
+        }
+    };
+
+    template<typename T>
+    Polynomial<T> operator*(T a, const Polynomial<T> &p) { return p*a; }
+
+    template<typename T>
+    std::ostream& operator<<(std::ostream &os, const Polynomial<T> &p){
+        const auto &c = p.coefficients();
+        os << "y = ";
+        if(c.empty()) os << 0;
+        bool first = true;
+        for(size_t k = c.size(); k-- > 0; ){
+            if(c[k] == static_cast<T>(0)) continue;
+            if(!first && c[k] > 0) os << "+";
+            if((c[k] != 1 && c[k] != -1) || k == 0) os << c[k];
+            else if(c[k] == -1) os << "-";
+            if(k != 0) os << "x";
+            if(k > 1) os << "^" << k;
+            first = false;
+        }
+        os << "\n";
+        return os;
+    }
+
+}   // Lee
 #endif
\ No newline at end of file
@@ -0,0 +1,71 @@
+#include <iostream>
+#include <cmath>
+#include <cassert>
+#include <vector>
+#include "Polynomial.hpp"
+#include "Parallel.hpp"
+
+namespace{
+
+    // coefficients in [-1, 1) from a fixed seed
+    template<typename T>
+    Lee::Polynomial<T> random_polynomial(size_t degree, unsigned seed){
+        std::vector<T> c(degree+1);
+        for(auto &a : c){
+            seed = seed*1103515245u+12345u;
+            a = static_cast<T>((seed >> 8)%1000)/500-1;
+        }
+        c.back() = 1;
+        return Lee::Polynomial<T>(c);
+    }
+
+    // evaluate() against the scalar Horner of p(x) at every point, out of place and with x == y;
+    // the packet loop may contract to fused multiply-adds, so the two agree to rounding only
+    template<typename T>
+    void evaluate_case(const Lee::Polynomial<T> &p, size_t n, T tol){
+        std::vector<T> x(n), y(n, static_cast<T>(-7));
+        for(size_t i = 0; i < n; ++i)
+            x[i] = static_cast<T>(std::sin(0.37*i));
+        p.evaluate(x.data(), y.data(), n);
+
+        std::vector<T> z = x;
+        p.evaluate(z.data(), z.data(), n);
+        for(size_t i = 0; i < n; ++i){
+            const T ref = p(x[i]);
+            assert(std::abs(y[i]-ref) <= tol*(1+std::abs(ref)) && "evaluate differs from scalar Horner");
+            assert(z[i] == y[i] && "in-place evaluate differs");
+        }
+        assert(p(x) == y && "evaluate on a std::vector");
+    }
+
+    template<typename T>
+    void evaluate(T tol){
+        // every count up to past four packets of the widest SIMD width, so each tail length runs
+        const size_t degrees[] = {0, 1, 2, 7, 20};
+        for(size_t d : degrees)
+            for(size_t n = 0; n <= 70; ++n)
+                evaluate_case(random_polynomial<T>(d, static_cast<unsigned>(d+1)), n, tol);
+
+        // a batch split over threads, block edges in the middle of packets
+        const size_t threshold = Lee::parallel_threshold();
+        Lee::set_parallel_threshold(64);
+        Lee::set_num_threads(3);
+        evaluate_case(random_polynomial<T>(9, 5), 1001, tol);
+        Lee::set_parallel_threshold(threshold);
+        Lee::set_num_threads(0);
+
+        // the zero polynomial writes zeros
+        std::vector<T> x(9, static_cast<T>(2));
+        Lee::Polynomial<T>().evaluate(x.data(), x.data(), x.size());
+        for(T v : x)
+            assert(v == 0 && "zero polynomial");
+    }
+
+}
+
+void Polynomial_Test(){
+    std::cout << "\nPolynomial Test:\n";
+    evaluate<double>(1e-14);
+    evaluate<float>(1e-5f);
+    std::cout << "batched Horner against scalar, tails, in place and threaded: ok\n";
+}
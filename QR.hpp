@@ -0,0 +1,196 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+#include "Gemm.hpp"
+
+/*
+** Householder QR factorization A = Q*R, A: m x n
+** | qr_factor(m, n, a, lda, tau)          upper triangle of a = R, below the diagonal the
+** |                                       Householder vectors v_k (v_k[k] = 1 not stored);
+** |                                       Q = H_0*H_1*..., H_k = I - tau[k]*v_k*v_k^T
+** | qr_apply_qt(m, k, a, lda, tau, b, nrhs, ldb)
+** |                                       b (m x nrhs) = Q^T * b, first k reflectors
+** | qr_solve(m, n, a, lda, tau, b, nrhs, ldb)
+** |                                       least-squares solution (m >= n, full rank) in
+** |                                       the first n rows of b
+** | qr_form_q(m, k, a, lda, tau, q, nq)   q (m x nq) = first nq columns of Q
+** blocking (compact WY)
+** | n > LEE_QR_BLOCK: panels of LEE_QR_BLOCK reflectors are factored unblocked, then
+** | H_k0*...*H_k1-1 = I - V*T*V^T (T upper triangular) is applied to the trailing
+** | columns, and when forming Q, with three GEMM calls
+** all matrices row-major
+*/
+
+#ifndef LEE_QR_BLOCK
+#define LEE_QR_BLOCK 32
+#endif
+
+namespace MatrixImpl{
+
+    template<typename T>
+    void qr_factor_unblocked(size_t m, size_t n, T *a, size_t lda, T *tau){
+        const size_t kn = std::min(m, n);
+        std::vector<T> w(n);
+
+        for(size_t k = 0; k < kn; ++k){
+            const T alpha = a[k*lda+k];
+            T sigma = static_cast<T>(0);
+            for(size_t i = k+1; i < m; ++i)
+                sigma += a[i*lda+k]*a[i*lda+k];
+            if(sigma == static_cast<T>(0)) { tau[k] = static_cast<T>(0); continue; }
+
+            // H_k maps column k to beta*e_k, beta of the opposite sign to alpha
+            const T norm = std::sqrt(alpha*alpha+sigma);
+            const T beta = alpha > static_cast<T>(0) ? -norm : norm;
+            const T scale = 1/(alpha-beta);
+            tau[k] = (beta-alpha)/beta;
+            for(size_t i = k+1; i < m; ++i)
+                a[i*lda+k] *= scale;
+            a[k*lda+k] = beta;
+
+            // A(k:m, k+1:n) -= tau*v*(v^T*A(k:m, k+1:n)), by rows
+            for(size_t j = k+1; j < n; ++j)
+                w[j] = a[k*lda+j];
+            for(size_t i = k+1; i < m; ++i){
+                const T v = a[i*lda+k];
+                for(size_t j = k+1; j < n; ++j)
+                    w[j] += v*a[i*lda+j];
+            }
+            for(size_t j = k+1; j < n; ++j)
+                a[k*lda+j] -= tau[k]*w[j];
+            for(size_t i = k+1; i < m; ++i){
+                const T v = tau[k]*a[i*lda+k];
+                for(size_t j = k+1; j < n; ++j)
+                    a[i*lda+j] -= v*w[j];
+            }
+        }
+    }
+
+    // V (m x nb): reflectors k0 .. k0+nb-1 of a, unit diagonal and zeros above made explicit
+    template<typename T>
+    void qr_block_v(size_t m, size_t nb, const T *a, size_t lda, T *v){
+        for(size_t i = 0; i < m; ++i)
+            for(size_t j = 0; j < nb; ++j)
+                v[i*nb+j] = i > j ? a[i*lda+j] : (i == j ? static_cast<T>(1) : static_cast<T>(0));
+    }
+
+    // T (nb x nb) with H_0*...*H_nb-1 = I - V*T*V^T
+    template<typename T>
+    void qr_block_t(size_t m, size_t nb, const T *v, const T *tau, T *t){
+        std::vector<T> w(nb);
+        std::fill(t, t+nb*nb, static_cast<T>(0));
+
+        for(size_t j = 0; j < nb; ++j){
+            // w = -tau_j * V(:, 0:j)^T * v_j
+            std::fill(w.begin(), w.end(), static_cast<T>(0));
+            for(size_t i = j; i < m; ++i){
+                const T vij = v[i*nb+j];
+                for(size_t p = 0; p < j; ++p)
+                    w[p] += v[i*nb+p]*vij;
+            }
+            // T(0:j, j) = T(0:j, 0:j) * w
+            for(size_t p = 0; p < j; ++p){
+                T acc = static_cast<T>(0);
+                for(size_t q = p; q < j; ++q)
+                    acc += t[p*nb+q]*w[q];
+                t[p*nb+j] = -tau[j]*acc;
+            }
+            t[j*nb+j] = tau[j];
+        }
+    }
+
+    // C (m x n) = (I - V*op(T)*V^T) * C, op(T) = T^T applies Q^T, T applies Q
+    template<typename T>
+    void qr_block_apply(size_t m, size_t nb, const T *v, const T *t, bool trans, T *c, size_t n, size_t ldc){
+        std::vector<T> w(nb*n), tw(nb*n);
+        const T one = static_cast<T>(1), zero = static_cast<T>(0);
+
+        gemm_parallel(nb, n, m, one, v, static_cast<size_t>(1), nb, c, ldc, static_cast<size_t>(1), zero, w.data(), n);
+        gemm(nb, n, nb, one, t, trans ? static_cast<size_t>(1) : nb, trans ? nb : static_cast<size_t>(1), 
+             w.data(), n, static_cast<size_t>(1), zero, tw.data(), n);
+        gemm_parallel(m, n, nb, static_cast<T>(-1), v, nb, static_cast<size_t>(1), tw.data(), n, static_cast<size_t>(1), one, c, ldc);
+    }
+
+    template<typename T>
+    void qr_factor(size_t m, size_t n, T *a, size_t lda, T *tau){
+        const size_t kn = std::min(m, n), NB = LEE_QR_BLOCK;
+        if(n <= NB) { qr_factor_unblocked(m, n, a, lda, tau); return; }
+
+        std::vector<T> v, t(NB*NB);
+        for(size_t k0 = 0; k0 < kn; k0 += NB){
+            const size_t nb = std::min(NB, kn-k0), mk = m-k0;
+            T *ak = a+k0*lda+k0;
+            qr_factor_unblocked(mk, nb, ak, lda, tau+k0);
+            if(k0+nb == n) break;
+
+            v.resize(mk*nb);
+            qr_block_v(mk, nb, ak, lda, v.data());
+            qr_block_t(mk, nb, v.data(), tau+k0, t.data());
+            qr_block_apply(mk, nb, v.data(), t.data(), true, ak+nb, n-k0-nb, lda);
+        }
+    }
+
+    template<typename T>
+    void qr_apply_qt(size_t m, size_t k, const T *a, size_t lda, const T *tau, T *b, size_t nrhs, size_t ldb){
+        std::vector<T> w(nrhs);
+
+        for(size_t r = 0; r < k; ++r){
+            if(tau[r] == static_cast<T>(0)) continue;
+
+            std::copy(b+r*ldb, b+r*ldb+nrhs, w.begin());
+            for(size_t i = r+1; i < m; ++i){
+                const T v = a[i*lda+r];
+                for(size_t j = 0; j < nrhs; ++j)
+                    w[j] += v*b[i*ldb+j];
+            }
+            for(size_t j = 0; j < nrhs; ++j)
+                b[r*ldb+j] -= tau[r]*w[j];
+            for(size_t i = r+1; i < m; ++i){
+                const T v = tau[r]*a[i*lda+r];
+                for(size_t j = 0; j < nrhs; ++j)
+                    b[i*ldb+j] -= v*w[j];
+            }
+        }
+    }
+
+    template<typename T>
+    void qr_solve(size_t m, size_t n, const T *a, size_t lda, const T *tau, T *b, size_t nrhs, size_t ldb){
+        qr_apply_qt(m, std::min(m, n), a, lda, tau, b, nrhs, ldb);
+
+        // R x = (Q^T b)(0:n)
+        for(size_t i = n; i-- > 0; ){
+            T *bi = b+i*ldb;
+            for(size_t p = i+1; p < n; ++p){
+                const T r = a[i*lda+p];
+                const T *bp = b+p*ldb;
+                for(size_t j = 0; j < nrhs; ++j)
+                    bi[j] -= r*bp[j];
+            }
+            for(size_t j = 0; j < nrhs; ++j)
+                bi[j] /= a[i*lda+i];
+        }
+    }
+
+    template<typename T>
+    void qr_form_q(size_t m, size_t k, const T *a, size_t lda, const T *tau, T *q, size_t nq){
+        const size_t NB = LEE_QR_BLOCK;
+        for(size_t i = 0; i < m; ++i)
+            for(size_t j = 0; j < nq; ++j)
+                q[i*nq+j] = (i == j) ? static_cast<T>(1) : static_cast<T>(0);
+
+        // Q = H_0*(H_1*(...*I)), blocks of reflectors from the last one back
+        std::vector<T> v, t(NB*NB);
+        for(size_t k1 = k; k1 > 0; ){
+            const size_t k0 = k1 > NB ? k1-NB : 0, nb = k1-k0, mk = m-k0;
+            v.resize(mk*nb);
+            qr_block_v(mk, nb, a+k0*lda+k0, lda, v.data());
+            qr_block_t(mk, nb, v.data(), tau+k0, t.data());
+            qr_block_apply(mk, nb, v.data(), t.data(), false, q+k0*nq, nq, nq);
+            k1 = k0;
+        }
+    }
+
+}   // MatrixImpl
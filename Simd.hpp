@@ -0,0 +1,285 @@
+#pragma once
+
+#include <vector>
+#include <cstring>
+#include <functional>
+#include <type_traits>
+
+/*
+** Packet evaluation of element-wise expression trees
+** | PacketExpr<V>::value                  V can be read a packet at a time
+** | PacketExpr<V>::load(p, v, i)         p = elements i .. i+width-1 of V
+** | packet_assign(dst, src, first, last) dst[first, last) = src[first, last)
+** kernels
+** | AVX-512 (64 bytes), AVX2 (32 bytes) and SSE2 (16 bytes), picked once at
+** | run time from the CPU features; the remainder is a scalar tail.
+** | The kernels are flattened, so a whole binaryProxy/applyProxy tree is
+** | inlined into one vector loop.
+*/
+
+namespace Lee{
+    template<typename T, size_t S>
+    class inlineStorage;
+
+    template<typename T>
+    class tempStorage;
+
+    template<typename T>
+    class Scalar;
+
+    template<typename T, typename V, typename F>
+    class applyProxy;
+
+    template<typename T, typename V1, typename V2, typename F>
+    class binaryProxy;
+
+    template<typename T, typename V, typename F>
+    class binaryProxyRScalar;
+
+    template<typename T, typename V, typename F>
+    class binaryProxyLScalar;
+}
+
+namespace MatrixImpl{
+
+    template<typename T>
+    struct abs;
+
+#if defined(__GNUC__)
+    template<typename T, size_t B>
+    struct PacketType{
+        typedef T type __attribute__((vector_size(B)));
+    };
+
+    // packets only travel by reference, which keeps the non-AVX ABI out of the picture
+    template<typename P, typename T>
+    inline void packet_broadcast(P &res, const T &elem){
+        res = P{}+elem;
+    }
+
+    // functors with a packet form
+    template<typename F>
+    struct PacketOp{
+        static const bool value = false;
+    };
+
+    template<typename T>
+    struct PacketOp<std::plus<T>>{
+        static const bool value = true;
+
+        template<typename P>
+        static void apply(P &res, const P &a, const P &b) { res = a+b; }
+    };
+
+    template<typename T>
+    struct PacketOp<std::minus<T>>{
+        static const bool value = true;
+
+        template<typename P>
+        static void apply(P &res, const P &a, const P &b) { res = a-b; }
+    };
+
+    template<typename T>
+    struct PacketOp<std::multiplies<T>>{
+        static const bool value = true;
+
+        template<typename P>
+        static void apply(P &res, const P &a, const P &b) { res = a*b; }
+    };
+
+    template<typename T>
+    struct PacketOp<std::divides<T>>{
+        static const bool value = true;
+
+        template<typename P>
+        static void apply(P &res, const P &a, const P &b) { res = a/b; }
+    };
+
+    template<typename T>
+    struct PacketOp<std::modulus<T>>{
+        static const bool value = std::is_integral<T>::value;
+
+        template<typename P>
+        static void apply(P &res, const P &a, const P &b) { res = a%b; }
+    };
+
+    template<typename T>
+    struct PacketOp<std::negate<T>>{
+        static const bool value = true;
+
+        template<typename P>
+        static void apply(P &res, const P &a) { res = -a; }
+    };
+
+    template<typename T>
+    struct PacketOp<abs<T>>{
+        static const bool value = true;
+
+        template<typename P>
+        static void apply(P &res, const P &a) { res = a < P{} ? -a : a; }
+    };
+
+    // expression nodes with a packet form
+    template<typename V>
+    struct PacketExpr{
+        static const bool value = false;
+    };
+
+    template<typename T>
+    struct PacketExpr<std::vector<T>>{
+        static const bool value = std::is_arithmetic<T>::value && !std::is_same<T, bool>::value;
+
+        template<typename P>
+        static void load(P &res, const std::vector<T> &v, size_t i){
+            std::memcpy(&res, v.data()+i, sizeof(P));
+        }
+    };
+
+    template<typename T, size_t S>
+    struct PacketExpr<Lee::inlineStorage<T, S>>{
+        static const bool value = std::is_arithmetic<T>::value && !std::is_same<T, bool>::value;
+
+        template<typename P>
+        static void load(P &res, const Lee::inlineStorage<T, S> &v, size_t i){
+            std::memcpy(&res, v.data()+i, sizeof(P));
+        }
+    };
+
+    template<typename T>
+    struct PacketExpr<Lee::tempStorage<T>>{
+        static const bool value = std::is_arithmetic<T>::value && !std::is_same<T, bool>::value;
+
+        template<typename P>
+        static void load(P &res, const Lee::tempStorage<T> &v, size_t i){
+            std::memcpy(&res, v.data()+i, sizeof(P));
+        }
+    };
+
+    template<typename T>
+    struct PacketExpr<Lee::Scalar<T>>{
+        static const bool value = true;
+
+        template<typename P>
+        static void load(P &res, const Lee::Scalar<T> &s, size_t) { packet_broadcast(res, s[0]); }
+    };
+
+    template<typename T, typename V, typename F>
+    struct PacketExpr<Lee::applyProxy<T, V, F>>{
+        static const bool value = PacketExpr<V>::value && PacketOp<F>::value;
+
+        template<typename P>
+        static void load(P &res, const Lee::applyProxy<T, V, F> &p, size_t i){
+            P a;
+            PacketExpr<V>::load(a, p.left(), i);
+            PacketOp<F>::apply(res, a);
+        }
+    };
+
+    template<typename T, typename V1, typename V2, typename F>
+    struct PacketExpr<Lee::binaryProxy<T, V1, V2, F>>{
+        static const bool value = PacketExpr<V1>::value && PacketExpr<V2>::value && PacketOp<F>::value;
+
+        template<typename P>
+        static void load(P &res, const Lee::binaryProxy<T, V1, V2, F> &p, size_t i){
+            P a, b;
+            PacketExpr<V1>::load(a, p.left(), i);
+            PacketExpr<V2>::load(b, p.right(), i);
+            PacketOp<F>::apply(res, a, b);
+        }
+    };
+
+    template<typename T, typename V, typename F>
+    struct PacketExpr<Lee::binaryProxyRScalar<T, V, F>>{
+        static const bool value = PacketExpr<V>::value && PacketOp<F>::value;
+
+        template<typename P>
+        static void load(P &res, const Lee::binaryProxyRScalar<T, V, F> &p, size_t i){
+            P a, b;
+            PacketExpr<V>::load(a, p.left(), i);
+            packet_broadcast(b, p.right()[0]);
+            PacketOp<F>::apply(res, a, b);
+        }
+    };
+
+    template<typename T, typename V, typename F>
+    struct PacketExpr<Lee::binaryProxyLScalar<T, V, F>>{
+        static const bool value = PacketExpr<V>::value && PacketOp<F>::value;
+
+        template<typename P>
+        static void load(P &res, const Lee::binaryProxyLScalar<T, V, F> &p, size_t i){
+            P a, b;
+            packet_broadcast(a, p.left()[0]);
+            PacketExpr<V>::load(b, p.right(), i);
+            PacketOp<F>::apply(res, a, b);
+        }
+    };
+
+    template<typename T, size_t B, typename V>
+    inline void packet_assign_n(T *dst, const V &src, size_t first, size_t last){
+        typedef typename PacketType<T, B>::type P;
+        const size_t W = B/sizeof(T);
+
+        size_t i = first;
+        for(; i+W <= last; i += W){
+            P p;
+            PacketExpr<V>::load(p, src, i);
+            std::memcpy(dst+i, &p, B);
+        }
+        for(; i < last; ++i)
+            dst[i] = src[i];
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    template<typename T, typename V>
+    __attribute__((target("avx512f"), flatten))
+    void packet_assign_avx512(T *dst, const V &src, size_t first, size_t last){
+        packet_assign_n<T, 64>(dst, src, first, last);
+    }
+
+    template<typename T, typename V>
+    __attribute__((target("avx2"), flatten))
+    void packet_assign_avx2(T *dst, const V &src, size_t first, size_t last){
+        packet_assign_n<T, 32>(dst, src, first, last);
+    }
+
+    // 0: SSE2, 1: AVX2, 2: AVX-512
+    inline int simd_level(){
+        static const int level = __builtin_cpu_supports("avx512f") ? 2 :
+                                 __builtin_cpu_supports("avx2") ? 1 : 0;
+        return level;
+    }
+#endif
+
+    template<typename T, typename V>
+    __attribute__((flatten))
+    void packet_assign_base(T *dst, const V &src, size_t first, size_t last){
+        packet_assign_n<T, 16>(dst, src, first, last);
+    }
+
+    // dst[first, last) = src[first, last)
+    template<typename T, typename V>
+    void packet_assign(T *dst, const V &src, size_t first, size_t last){
+#if defined(__x86_64__) || defined(__i386__)
+        switch(simd_level()){
+            case 2:  packet_assign_avx512(dst, src, first, last); return;
+            case 1:  packet_assign_avx2(dst, src, first, last); return;
+            default: break;
+        }
+#endif
+        packet_assign_base(dst, src, first, last);
+    }
+
+#else
+    template<typename V>
+    struct PacketExpr{
+        static const bool value = false;
+    };
+
+    template<typename T, typename V>
+    void packet_assign(T *dst, const V &src, size_t first, size_t last){
+        for(size_t i = first; i < last; ++i)
+            dst[i] = src[i];
+    }
+#endif
+
+}   // MatrixImpl
@@ -0,0 +1,293 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <mutex>
+#include <cassert>
+#include "DynamicMatrix.hpp"
+#include "Parallel.hpp"
+
+/*
+** Compressed sparse matrices
+** classes
+** | SparseMatrix<T, SparseOrder::Row>    CSR, alias CSRMatrix<T>
+** | SparseMatrix<T, SparseOrder::Col>    CSC, alias CSCMatrix<T>
+** initialize
+** | SparseMatrix a(m, n)                     empty
+** | SparseMatrix a(m, n, triplets)           {row, col, value}, any order, duplicates summed
+** | SparseMatrix a(m, n, ptr, idx, val)      compressed arrays taken as they are
+** visit
+** | a(i, j)                                  zero if not stored
+** | a.diagonal()
+** products, y a DynamicMatrix with one or more columns
+** | a*x                                      A*x
+** | transpose_multiply(a, x)                 A^T*x without forming A^T
+** | transpose(a), to_csr(a), to_csc(a)
+** CSR times x and CSC transposed times x gather along rows and split the rows over
+** threads; the other two scatter, each thread into its own buffer (Parallel.hpp).
+*/
+
+namespace Lee{
+
+    enum class SparseOrder { Row, Col };
+
+    template<typename T>
+    struct Triplet{
+        size_t row;
+        size_t col;
+        T value;
+    };
+
+    template<typename T, SparseOrder O = SparseOrder::Row>
+    class SparseMatrix{
+    public:
+        using value_type = T;
+
+        static const SparseOrder order = O;
+
+        SparseMatrix() : nrows{0}, ncols{0}, ptr(1, 0) {}
+
+        SparseMatrix(size_t m, size_t n) : nrows{m}, ncols{n}, ptr((O == SparseOrder::Row ? m : n)+1, 0) {}
+
+        SparseMatrix(size_t m, size_t n, const std::vector<Triplet<T>> &triplets)
+            : nrows{m}, ncols{n}, ptr(outer_size()+1, 0) {
+            // counting sort by outer index, then sort and merge inside every outer slice
+            for(const auto &t : triplets){
+                assert(t.row < nrows && t.col < ncols && "triplet out of range");
+                ++ptr[outer_of(t.row, t.col)+1];
+            }
+            for(size_t o = 0; o < outer_size(); ++o)
+                ptr[o+1] += ptr[o];
+
+            std::vector<std::pair<size_t, T>> entries(triplets.size());
+            std::vector<size_t> next(ptr.begin(), ptr.end()-1);
+            for(const auto &t : triplets)
+                entries[next[outer_of(t.row, t.col)]++] = std::make_pair(inner_of(t.row, t.col), t.value);
+
+            idx.reserve(entries.size());
+            val.reserve(entries.size());
+            size_t start = 0;
+            for(size_t o = 0; o < outer_size(); ++o){
+                auto first = entries.begin()+ptr[o], last = entries.begin()+ptr[o+1];
+                std::sort(first, last, [](const std::pair<size_t, T> &a, const std::pair<size_t, T> &b){
+                    return a.first < b.first;
+                });
+                for(auto it = first; it != last; ++it){
+                    if(idx.size() > start && idx.back() == it->first) val.back() += it->second;
+                    else { idx.push_back(it->first); val.push_back(it->second); }
+                }
+                ptr[o] = start;
+                start = idx.size();
+            }
+            ptr[outer_size()] = start;
+        }
+
+        SparseMatrix(size_t m, size_t n, std::vector<size_t> p, std::vector<size_t> i, std::vector<T> v)
+            : nrows{m}, ncols{n}, ptr(std::move(p)), idx(std::move(i)), val(std::move(v)) {
+            assert(ptr.size() == outer_size()+1 && ptr.back() == idx.size() && idx.size() == val.size()
+                   && "compressed arrays do not match");
+        }
+
+        size_t rows() const { return nrows; }
+
+        size_t cols() const { return ncols; }
+
+        size_t nonzeros() const { return val.size(); }
+
+        size_t outer_size() const { return O == SparseOrder::Row ? nrows : ncols; }
+
+        size_t inner_size() const { return O == SparseOrder::Row ? ncols : nrows; }
+
+        const std::vector<size_t>& outer_index() const { return ptr; }
+
+        const std::vector<size_t>& inner_index() const { return idx; }
+
+        const std::vector<T>& values() const { return val; }
+
+        std::vector<T>& values() { return val; }
+
+        T operator()(size_t i, size_t j) const{
+            assert(i < nrows && j < ncols && "Matrix index out of range");
+            const size_t o = outer_of(i, j), in = inner_of(i, j);
+            auto first = idx.begin()+ptr[o], last = idx.begin()+ptr[o+1];
+            auto it = std::lower_bound(first, last, in);
+            return (it != last && *it == in) ? val[it-idx.begin()] : static_cast<T>(0);
+        }
+
+        std::vector<T> diagonal() const{
+            std::vector<T> d(std::min(nrows, ncols), static_cast<T>(0));
+            for(size_t o = 0; o < std::min(outer_size(), d.size()); ++o){
+                auto first = idx.begin()+ptr[o], last = idx.begin()+ptr[o+1];
+                auto it = std::lower_bound(first, last, o);
+                if(it != last && *it == o) d[o] = val[it-idx.begin()];
+            }
+            return d;
+        }
+
+    private:
+        size_t outer_of(size_t i, size_t j) const { return O == SparseOrder::Row ? i : j; }
+
+        size_t inner_of(size_t i, size_t j) const { return O == SparseOrder::Row ? j : i; }
+
+        size_t nrows;
+        size_t ncols;
+        std::vector<size_t> ptr;        // outer_size()+1 offsets into idx and val
+        std::vector<size_t> idx;        // inner index of each stored value, sorted per outer slice
+        std::vector<T> val;
+    };
+
+    template<typename T>
+    using CSRMatrix = SparseMatrix<T, SparseOrder::Row>;
+
+    template<typename T>
+    using CSCMatrix = SparseMatrix<T, SparseOrder::Col>;
+
+}   // Lee
+
+namespace MatrixImpl{
+
+    // y[o*k+c] = sum of val*x[inner*k+c] over the slice of o, slices split over threads
+    template<typename T>
+    void sparse_gather(size_t outer, const size_t *ptr, const size_t *idx, const T *val, const T *x, T *y, size_t k){
+        parallel_rows(outer, ptr[outer]*k, [=](size_t o0, size_t o1){
+            // one column: the sum stays in a register
+            if(k == 1){
+                for(size_t o = o0; o < o1; ++o){
+                    T s = static_cast<T>(0);
+                    for(size_t p = ptr[o]; p < ptr[o+1]; ++p)
+                        s += val[p]*x[idx[p]];
+                    y[o] = s;
+                }
+                return;
+            }
+            for(size_t o = o0; o < o1; ++o){
+                T *yo = y+o*k;
+                std::fill(yo, yo+k, static_cast<T>(0));
+                for(size_t p = ptr[o]; p < ptr[o+1]; ++p){
+                    const T v = val[p];
+                    const T *xi = x+idx[p]*k;
+                    for(size_t c = 0; c < k; ++c)
+                        yo[c] += v*xi[c];
+                }
+            }
+        });
+    }
+
+    // y[inner*k+c] = sum of val*x[o*k+c] over every slice o storing inner
+    template<typename T>
+    void sparse_scatter(size_t outer, size_t inner, const size_t *ptr, const size_t *idx, const T *val, const T *x, T *y, size_t k){
+        std::fill(y, y+inner*k, static_cast<T>(0));
+        std::mutex merge;
+        parallel_rows(outer, ptr[outer]*k, [=, &merge](size_t o0, size_t o1){
+            // a thread with only part of the slices keeps its own sums until the merge
+            std::vector<T> local;
+            T *acc = y;
+            if(o0 != 0 || o1 != outer) { local.assign(inner*k, static_cast<T>(0)); acc = local.data(); }
+            for(size_t o = o0; o < o1; ++o){
+                const T *xo = x+o*k;
+                for(size_t p = ptr[o]; p < ptr[o+1]; ++p){
+                    const T v = val[p];
+                    T *yi = acc+idx[p]*k;
+                    for(size_t c = 0; c < k; ++c)
+                        yi[c] += v*xo[c];
+                }
+            }
+            if(acc != y){
+                std::lock_guard<std::mutex> lock(merge);
+                for(size_t e = 0; e < inner*k; ++e)
+                    y[e] += acc[e];
+            }
+        });
+    }
+
+    // y = op(A)*x, x and y row-major with k columns; trans: op(A) = A^T
+    template<typename T, Lee::SparseOrder O>
+    void sparse_multiply(const Lee::SparseMatrix<T, O> &A, bool trans, const T *x, T *y, size_t k){
+        const bool gather = (O == Lee::SparseOrder::Row) != trans;
+        if(gather) sparse_gather(A.outer_size(), A.outer_index().data(), A.inner_index().data(), A.values().data(), x, y, k);
+        else sparse_scatter(A.outer_size(), A.inner_size(), A.outer_index().data(), A.inner_index().data(), A.values().data(), x, y, k);
+    }
+
+    // dense operands are read in place, expressions evaluated once into tmp
+    template<typename T>
+    const T* sparse_operand(const Lee::DynamicMatrix<T> &x, Lee::DynamicMatrix<T>&) { return x.data().data(); }
+
+    template<typename T, typename V>
+    const T* sparse_operand(const Lee::DynamicMatrix<T, V> &x, Lee::DynamicMatrix<T> &tmp){
+        tmp = x;
+        return tmp.data().data();
+    }
+
+    // the same entries compressed along the other dimension
+    template<typename T, Lee::SparseOrder To, Lee::SparseOrder From>
+    Lee::SparseMatrix<T, To> sparse_reorder(const Lee::SparseMatrix<T, From> &A){
+        const size_t outer = A.outer_size(), inner = A.inner_size(), nnz = A.nonzeros();
+        const std::vector<size_t> &ptr = A.outer_index(), &idx = A.inner_index();
+        const std::vector<T> &val = A.values();
+
+        std::vector<size_t> p(inner+1, 0), i(nnz);
+        std::vector<T> v(nnz);
+        for(size_t e = 0; e < nnz; ++e)
+            ++p[idx[e]+1];
+        for(size_t o = 0; o < inner; ++o)
+            p[o+1] += p[o];
+        std::vector<size_t> next(p.begin(), p.end()-1);
+        // walking the old slices in order keeps every new slice sorted
+        for(size_t o = 0; o < outer; ++o)
+            for(size_t e = ptr[o]; e < ptr[o+1]; ++e){
+                const size_t d = next[idx[e]]++;
+                i[d] = o;
+                v[d] = val[e];
+            }
+        return Lee::SparseMatrix<T, To>(A.rows(), A.cols(), std::move(p), std::move(i), std::move(v));
+    }
+
+}   // MatrixImpl
+
+namespace Lee{
+
+    template<typename T, SparseOrder O, typename V>
+    DynamicMatrix<T> operator*(const SparseMatrix<T, O> &A, const DynamicMatrix<T, V> &x){
+        assert(A.cols() == x.rows() && "dimensions do not match");
+        DynamicMatrix<T> tmp, y(A.rows(), x.cols());
+        if(y.rows() && y.cols()) MatrixImpl::sparse_multiply(A, false, MatrixImpl::sparse_operand(x, tmp), &y(0, 0), x.cols());
+        return y;
+    }
+
+    template<typename T, SparseOrder O, typename V>
+    DynamicMatrix<T> transpose_multiply(const SparseMatrix<T, O> &A, const DynamicMatrix<T, V> &x){
+        assert(A.rows() == x.rows() && "dimensions do not match");
+        DynamicMatrix<T> tmp, y(A.cols(), x.cols());
+        if(y.rows() && y.cols()) MatrixImpl::sparse_multiply(A, true, MatrixImpl::sparse_operand(x, tmp), &y(0, 0), x.cols());
+        return y;
+    }
+
+    // CSR of A^T holds the same arrays as CSC of A
+    template<typename T>
+    CSCMatrix<T> transpose(const CSRMatrix<T> &A){
+        return CSCMatrix<T>(A.cols(), A.rows(), A.outer_index(), A.inner_index(), A.values());
+    }
+
+    template<typename T>
+    CSRMatrix<T> transpose(const CSCMatrix<T> &A){
+        return CSRMatrix<T>(A.cols(), A.rows(), A.outer_index(), A.inner_index(), A.values());
+    }
+
+    template<typename T, SparseOrder O>
+    CSRMatrix<T> to_csr(const SparseMatrix<T, O> &A){
+        return MatrixImpl::sparse_reorder<T, SparseOrder::Row>(A);
+    }
+
+    template<typename T>
+    CSRMatrix<T> to_csr(const CSRMatrix<T> &A) { return A; }
+
+    template<typename T, SparseOrder O>
+    CSCMatrix<T> to_csc(const SparseMatrix<T, O> &A){
+        return MatrixImpl::sparse_reorder<T, SparseOrder::Col>(A);
+    }
+
+    template<typename T>
+    CSCMatrix<T> to_csc(const CSCMatrix<T> &A) { return A; }
+
+}   // Lee
@@ -0,0 +1,103 @@
+#include <iostream>
+#include <cmath>
+#include <cassert>
+#include <vector>
+#include "Sparse.hpp"
+
+namespace{
+
+    // m x n triplets in scrambled order, a fifth of the positions stored, each as two to four duplicates
+    std::vector<Lee::Triplet<double>> triplets(size_t m, size_t n, unsigned seed, Lee::DynamicMatrix<double> &dense, size_t &positions){
+        std::vector<Lee::Triplet<double>> t;
+        dense = Lee::DynamicMatrix<double>(m, n, 0.0);
+        positions = 0;
+        for(size_t i = 0; i < m; ++i)
+            for(size_t j = 0; j < n; ++j){
+                seed = seed*1103515245u+12345u;
+                if((seed >> 8)%5) continue;
+                ++positions;
+                for(size_t d = 0; d < 2+(seed >> 20)%3; ++d){
+                    const double v = static_cast<double>((seed >> (4+d))%100)/16-3;
+                    t.push_back({i, j, v});
+                    dense(i, j) += v;
+                }
+            }
+        for(size_t k = t.size(); k > 1; --k){
+            seed = seed*1103515245u+12345u;
+            std::swap(t[k-1], t[(seed >> 8)%k]);
+        }
+        return t;
+    }
+
+    template<typename A, typename B>
+    double max_diff(const A &a, const B &b){
+        assert(a.rows() == b.rows() && a.cols() == b.cols() && "shapes differ");
+        double d = 0;
+        for(size_t i = 0; i < a.rows(); ++i)
+            for(size_t j = 0; j < a.cols(); ++j)
+                d = std::max(d, std::abs(a(i, j)-b(i, j)));
+        return d;
+    }
+
+    // duplicates merged, inner indices sorted and unique in every outer slice
+    template<Lee::SparseOrder O>
+    void construction(const Lee::SparseMatrix<double, O> &A, const Lee::DynamicMatrix<double> &dense, size_t positions){
+        assert(max_diff(A, dense) < 1e-12 && "element access differs from the summed triplets");
+        assert(A.nonzeros() == positions && "duplicates not merged");
+
+        const std::vector<size_t> &ptr = A.outer_index(), &idx = A.inner_index();
+        for(size_t o = 0; o < A.outer_size(); ++o)
+            for(size_t p = ptr[o]+1; p < ptr[o+1]; ++p)
+                assert(idx[p-1] < idx[p] && "inner indices not sorted and unique");
+
+        const std::vector<double> d = A.diagonal();
+        for(size_t i = 0; i < std::min(A.rows(), A.cols()); ++i)
+            assert(d[i] == A(i, i) && "diagonal");
+    }
+
+    // A*x and A^T*x for CSR and CSC against the dense product, serial and split over threads
+    void products(size_t m, size_t n){
+        Lee::DynamicMatrix<double> dense;
+        size_t positions;
+        const std::vector<Lee::Triplet<double>> t = triplets(m, n, static_cast<unsigned>(m*n), dense, positions);
+        const Lee::CSRMatrix<double> R(m, n, t);
+        const Lee::CSCMatrix<double> C(m, n, t);
+        construction(R, dense, positions);
+        construction(C, dense, positions);
+
+        Lee::DynamicMatrix<double> x(n, 3), y(m, 3);
+        for(size_t i = 0; i < n; ++i)
+            for(size_t j = 0; j < 3; ++j) x(i, j) = std::cos(0.3*i+j);
+        for(size_t i = 0; i < m; ++i)
+            for(size_t j = 0; j < 3; ++j) y(i, j) = std::sin(0.7*i-j);
+        const Lee::DynamicMatrix<double> ax = dense*x, aty = Lee::transpose(dense)*y;
+
+        const size_t threshold = Lee::parallel_threshold();
+        for(int threaded = 0; threaded < 2; ++threaded){
+            if(threaded) { Lee::set_parallel_threshold(16); Lee::set_num_threads(4); }
+            assert(max_diff(R*x, ax) < 1e-11 && "CSR gather");
+            assert(max_diff(C*x, ax) < 1e-11 && "CSC scatter");
+            assert(max_diff(Lee::transpose_multiply(R, y), aty) < 1e-11 && "CSR transposed scatter");
+            assert(max_diff(Lee::transpose_multiply(C, y), aty) < 1e-11 && "CSC transposed gather");
+            assert(max_diff(C*(x*2.0), ax*2.0) < 1e-11 && "CSC times an expression");
+        }
+        Lee::set_parallel_threshold(threshold);
+        Lee::set_num_threads(0);
+
+        // order conversions keep every entry
+        assert(max_diff(Lee::to_csc(R), dense) == 0 && max_diff(Lee::to_csr(C), dense) == 0 && "order conversion");
+        const Lee::CSCMatrix<double> RT = Lee::transpose(R);
+        assert(RT.rows() == n && RT.cols() == m && max_diff(RT, Lee::transpose(dense)) == 0 && "transpose");
+    }
+
+}
+
+void Sparse_Test(){
+    std::cout << "\nSparse Test:\n";
+    products(1, 1);
+    products(37, 53);
+    products(300, 200);
+    const Lee::CSRMatrix<double> E(4, 6, std::vector<Lee::Triplet<double>>());
+    assert(E.nonzeros() == 0 && E(3, 5) == 0 && "empty CSR");
+    std::cout << "CSR and CSC from duplicate triplets, gather and scatter SpMV: ok\n";
+}
@@ -0,0 +1,297 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <limits>
+#include <tuple>
+#include "Matrix.hpp"
+#include "DynamicMatrix.hpp"
+#include "Gemm.hpp"
+#include "QR.hpp"
+#include "Parallel.hpp"
+#include "Monitor.hpp"
+
+/*
+** Singular value decomposition A = U*diag(s)*V^T, A: m x n, k = min(m, n), s descending
+** | svd(A, result)                         (U m x k, s k x 1, V n x k), orthonormal columns
+** | singular_values(A, result)             s alone, no rotations accumulated
+** | randomized_svd(A, r, oversample, power_iterations, result)
+** |                                        rank r approximation (U m x r, s r x 1, V n x r)
+** | result (Monitor.hpp)                   Jacobi sweeps, and converged = false after LEE_JACOBI_SWEEPS;
+** |                                        residual: largest |cos| between two columns in the last sweep
+** one-sided Jacobi
+** | A = Q*R first, then the columns of R are rotated in pairs until they are mutually orthogonal;
+** | each sweep is a round-robin tournament: n/2 disjoint pairs per round, rotated on separate threads
+** | once a round touches LEE_JACOBI_PARALLEL elements (a round of a smaller n is over in microseconds)
+** randomized
+** | Y = A*Omega with r+oversample random columns, orthonormalized after each of the power iterations
+** | Y = A*(A^T*Y); the Jacobi SVD of the small B^T = A^T*Y gives the factors; every product is a GEMM
+** all matrices row-major; U is completed to orthonormal columns when A is rank deficient
+*/
+
+#ifndef LEE_JACOBI_SWEEPS
+#define LEE_JACOBI_SWEEPS 60
+#endif
+
+#ifndef LEE_JACOBI_PARALLEL
+#define LEE_JACOBI_PARALLEL (1 << 20)
+#endif
+
+namespace MatrixImpl{
+
+    // rotates the k rows (length len) of w until they are mutually orthogonal, the rows of vt (k x k) along
+    template<typename T>
+    Lee::SolverResult<T> jacobi_orthogonalize(size_t k, size_t len, T *w, T *vt){
+        const T tol = std::sqrt(static_cast<T>(len))*std::numeric_limits<T>::epsilon();
+        const size_t players = k+k%2, npairs = players/2;
+        std::vector<size_t> first(npairs), second(npairs);
+        std::vector<unsigned char> rotated(npairs);
+        std::vector<T> cosine(npairs);
+        Lee::SolverResult<T> res{false, 0, static_cast<T>(0)};
+        const size_t work = 6*npairs*len >= LEE_JACOBI_PARALLEL ? 6*npairs*len : 0;
+
+        for(size_t sweep = 0; sweep < LEE_JACOBI_SWEEPS; ++sweep){
+            bool any = false;
+            res.residual = static_cast<T>(0);
+            for(size_t round = 0; round+1 < players; ++round){
+                // circle method: player players-1 stays, the others move one seat per round
+                for(size_t i = 0; i < npairs; ++i){
+                    first[i] = (round+i)%(players-1);
+                    second[i] = i == 0 ? players-1 : (round+players-1-i)%(players-1);
+                }
+                parallel_rows(npairs, work, [&](size_t p0, size_t p1){
+                    for(size_t pr = p0; pr < p1; ++pr){
+                        rotated[pr] = 0;
+                        cosine[pr] = 0;
+                        const size_t p = std::min(first[pr], second[pr]), q = std::max(first[pr], second[pr]);
+                        if(q >= k) continue;
+                        T *wp = w+p*len, *wq = w+q*len;
+                        T alpha = 0, beta = 0, gamma = 0;
+                        for(size_t j = 0; j < len; ++j){
+                            alpha += wp[j]*wp[j];
+                            beta += wq[j]*wq[j];
+                            gamma += wp[j]*wq[j];
+                        }
+                        if(gamma != static_cast<T>(0)) cosine[pr] = std::abs(gamma)/std::sqrt(alpha*beta);
+                        if(std::abs(gamma) <= tol*std::sqrt(alpha*beta)) continue;
+
+                        const T zeta = (beta-alpha)/(2*gamma);
+                        const T t = (zeta >= 0 ? 1 : -1)/(std::abs(zeta)+std::sqrt(1+zeta*zeta));
+                        const T c = 1/std::sqrt(1+t*t), s = c*t;
+                        for(size_t j = 0; j < len; ++j){
+                            const T x = wp[j], y = wq[j];
+                            wp[j] = c*x-s*y;
+                            wq[j] = s*x+c*y;
+                        }
+                        if(vt){
+                            T *vp = vt+p*k, *vq = vt+q*k;
+                            for(size_t j = 0; j < k; ++j){
+                                const T x = vp[j], y = vq[j];
+                                vp[j] = c*x-s*y;
+                                vq[j] = s*x+c*y;
+                            }
+                        }
+                        rotated[pr] = 1;
+                    }
+                });
+                for(size_t i = 0; i < npairs; ++i){
+                    any = any || rotated[i];
+                    res.residual = std::max(res.residual, cosine[i]);
+                }
+            }
+            ++res.iterations;
+            if(!any){
+                res.converged = true;
+                break;
+            }
+        }
+        return res;
+    }
+
+    // m >= n; s (n) descending, u (m x n) and v (n x n) unless nullptr
+    template<typename T>
+    Lee::SolverResult<T> svd_jacobi(size_t m, size_t n, const T *a, size_t lda, T *s, T *u, T *v){
+        std::vector<T> r(m*n), tau(n), w(n*n, static_cast<T>(0)), vt(v ? n*n : 0), q(u ? m*n : 0);
+        for(size_t i = 0; i < m; ++i)
+            std::copy(a+i*lda, a+i*lda+n, r.begin()+i*n);
+        qr_factor(m, n, r.data(), n, tau.data());
+        for(size_t i = 0; i < n; ++i)
+            for(size_t j = i; j < n; ++j)
+                w[j*n+i] = r[i*n+j];
+        if(u) qr_form_q(m, n, r.data(), n, tau.data(), q.data(), n);
+        if(v)
+            for(size_t i = 0; i < n; ++i)
+                vt[i*n+i] = static_cast<T>(1);
+
+        const Lee::SolverResult<T> res = jacobi_orthogonalize(n, n, w.data(), v ? vt.data() : static_cast<T*>(nullptr));
+
+        std::vector<T> norm(n);
+        std::vector<size_t> order(n);
+        for(size_t i = 0; i < n; ++i)
+            norm[i] = std::sqrt(std::inner_product(w.begin()+i*n, w.begin()+(i+1)*n, w.begin()+i*n, static_cast<T>(0)));
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&norm](size_t i, size_t j) { return norm[i] > norm[j]; });
+        for(size_t j = 0; j < n; ++j)
+            s[j] = norm[order[j]];
+
+        if(u){
+            // U = Q*Ur, column j of Ur the rotated column of R over its norm
+            const T small = static_cast<T>(n)*std::numeric_limits<T>::epsilon()*s[0];
+            std::vector<T> ur(n*n, static_cast<T>(0));
+            size_t rank = 0;
+            for(size_t j = 0; j < n && s[j] > small; ++j, ++rank){
+                const T *wj = w.data()+order[j]*n;
+                for(size_t i = 0; i < n; ++i)
+                    ur[i*n+j] = wj[i]/s[j];
+            }
+            // (numerically) zero singular values: complete Ur to an orthogonal matrix
+            for(size_t j = rank, e = 0; j < n; ++e){
+                std::vector<T> x(n, static_cast<T>(0));
+                x[e] = static_cast<T>(1);
+                for(int pass = 0; pass < 2; ++pass)
+                    for(size_t p = 0; p < j; ++p){
+                        T dot = static_cast<T>(0);
+                        for(size_t i = 0; i < n; ++i)
+                            dot += ur[i*n+p]*x[i];
+                        for(size_t i = 0; i < n; ++i)
+                            x[i] -= dot*ur[i*n+p];
+                    }
+                const T nx = std::sqrt(std::inner_product(x.begin(), x.end(), x.begin(), static_cast<T>(0)));
+                if(nx < static_cast<T>(0.5)) continue;
+                for(size_t i = 0; i < n; ++i)
+                    ur[i*n+j] = x[i]/nx;
+                ++j;
+            }
+            gemm_parallel(m, n, n, static_cast<T>(1), q.data(), n, 1, ur.data(), n, 1, static_cast<T>(0), u, n);
+        }
+        if(v)
+            for(size_t j = 0; j < n; ++j)
+                for(size_t i = 0; i < n; ++i)
+                    v[i*n+j] = vt[order[j]*n+i];
+        return res;
+    }
+
+    // any shape: s (k), u (m x k), v (n x k), k = min(m, n)
+    template<typename T>
+    Lee::SolverResult<T> svd(size_t m, size_t n, const T *a, size_t lda, T *s, T *u, T *v){
+        if(m >= n) return svd_jacobi(m, n, a, lda, s, u, v);
+
+        // A^T = U'*S*V'^T, so U = V' and V = U'
+        std::vector<T> at(n*m);
+        for(size_t i = 0; i < m; ++i)
+            for(size_t j = 0; j < n; ++j)
+                at[j*m+i] = a[i*lda+j];
+        return svd_jacobi(n, m, at.data(), m, s, v, u);
+    }
+
+    // the l columns of y (m x l) replaced by an orthonormal basis of their span
+    template<typename T>
+    void orthonormalize_columns(size_t m, size_t l, T *y){
+        std::vector<T> tau(l), q(m*l);
+        qr_factor(m, l, y, l, tau.data());
+        qr_form_q(m, l, y, l, tau.data(), q.data(), l);
+        std::copy(q.begin(), q.end(), y);
+    }
+
+    // rank r <= min(m, n): s (r), u (m x r), v (n x r)
+    template<typename T>
+    Lee::SolverResult<T> randomized_svd(size_t m, size_t n, const T *a, size_t lda, size_t r, size_t oversample,
+                                        size_t power_iterations, T *s, T *u, T *v){
+        const T one = static_cast<T>(1), zero = static_cast<T>(0);
+        const size_t l = std::min(r+oversample, std::min(m, n));
+        std::vector<T> omega(n*l), y(m*l), z(n*l);
+
+        unsigned seed = 1;
+        for(auto &x : omega){
+            seed = seed*1103515245u+12345u;
+            x = static_cast<T>(seed >> 8)/static_cast<T>(1u << 24)-static_cast<T>(0.5);
+        }
+        gemm_parallel(m, l, n, one, a, lda, 1, omega.data(), l, 1, zero, y.data(), l);
+        orthonormalize_columns(m, l, y.data());
+        for(size_t it = 0; it < power_iterations; ++it){
+            gemm_parallel(n, l, m, one, a, 1, lda, y.data(), l, 1, zero, z.data(), l);
+            orthonormalize_columns(n, l, z.data());
+            gemm_parallel(m, l, n, one, a, lda, 1, z.data(), l, 1, zero, y.data(), l);
+            orthonormalize_columns(m, l, y.data());
+        }
+
+        // B^T = A^T*Y = Ub*Sb*Vb^T, so A ~ Y*B = (Y*Vb)*Sb*Ub^T
+        gemm_parallel(n, l, m, one, a, 1, lda, y.data(), l, 1, zero, z.data(), l);
+        std::vector<T> sb(l), ub(n*l), vb(l*l);
+        const Lee::SolverResult<T> res = svd_jacobi(n, l, z.data(), l, sb.data(), ub.data(), vb.data());
+
+        std::copy(sb.begin(), sb.begin()+r, s);
+        gemm_parallel(m, r, l, one, y.data(), l, 1, vb.data(), l, 1, zero, u, r);
+        for(size_t i = 0; i < n; ++i)
+            std::copy(ub.begin()+i*l, ub.begin()+i*l+r, v+i*r);
+        return res;
+    }
+
+}   // MatrixImpl
+
+namespace Lee{
+
+    template<typename T, size_t M, size_t N, typename V>
+    std::tuple<Matrix<T, M, (M < N ? M : N)>, Matrix<T, (M < N ? M : N), 1>, Matrix<T, N, (M < N ? M : N)>>
+    svd(const Matrix<T, M, N, V> &A, SolverResult<T> *result = nullptr){
+        const size_t K = M < N ? M : N;
+        Matrix<T, M, N> a(A);
+        Matrix<T, M, K> u;
+        Matrix<T, K, 1> s;
+        Matrix<T, N, K> v;
+        MatrixImpl::solver_result(result, MatrixImpl::svd(M, N, &a(0, 0), N, &s(0, 0), &u(0, 0), &v(0, 0)));
+        return std::make_tuple(u, s, v);
+    }
+
+    template<typename T, typename V>
+    std::tuple<DynamicMatrix<T>, DynamicMatrix<T>, DynamicMatrix<T>> svd(const DynamicMatrix<T, V> &A,
+                                                                         SolverResult<T> *result = nullptr){
+        const size_t m = A.rows(), n = A.cols(), k = std::min(m, n);
+        DynamicMatrix<T> a(A), u(m, k), s(k, 1), v(n, k);
+        MatrixImpl::solver_result(result, k ? MatrixImpl::svd(m, n, &a(0, 0), n, &s(0, 0), &u(0, 0), &v(0, 0))
+                                            : SolverResult<T>{true, 0, static_cast<T>(0)});
+        return std::make_tuple(u, s, v);
+    }
+
+    template<typename T, size_t M, size_t N, typename V>
+    Matrix<T, (M < N ? M : N), 1> singular_values(const Matrix<T, M, N, V> &A, SolverResult<T> *result = nullptr){
+        Matrix<T, M, N> a(A);
+        Matrix<T, (M < N ? M : N), 1> s;
+        MatrixImpl::solver_result(result, MatrixImpl::svd(M, N, &a(0, 0), N, &s(0, 0), static_cast<T*>(nullptr), static_cast<T*>(nullptr)));
+        return s;
+    }
+
+    template<typename T, typename V>
+    DynamicMatrix<T> singular_values(const DynamicMatrix<T, V> &A, SolverResult<T> *result = nullptr){
+        const size_t m = A.rows(), n = A.cols(), k = std::min(m, n);
+        DynamicMatrix<T> a(A), s(k, 1);
+        MatrixImpl::solver_result(result, k ? MatrixImpl::svd(m, n, &a(0, 0), n, &s(0, 0), static_cast<T*>(nullptr), static_cast<T*>(nullptr))
+                                            : SolverResult<T>{true, 0, static_cast<T>(0)});
+        return s;
+    }
+
+    // A is read in place, never copied
+    template<typename T>
+    std::tuple<DynamicMatrix<T>, DynamicMatrix<T>, DynamicMatrix<T>>
+    randomized_svd(const DynamicMatrix<T> &A, size_t rank, size_t oversample = 10, size_t power_iterations = 2,
+                   SolverResult<T> *result = nullptr){
+        const size_t m = A.rows(), n = A.cols();
+        assert(rank <= std::min(m, n) && "rank exceeds the smaller dimension");
+        DynamicMatrix<T> u(m, rank), s(rank, 1), v(n, rank);
+        MatrixImpl::solver_result(result, rank ? MatrixImpl::randomized_svd(m, n, A.data().data(), n, rank, oversample, power_iterations,
+                                                                            &s(0, 0), &u(0, 0), &v(0, 0))
+                                               : SolverResult<T>{true, 0, static_cast<T>(0)});
+        return std::make_tuple(u, s, v);
+    }
+
+    template<typename T, typename V>
+    std::tuple<DynamicMatrix<T>, DynamicMatrix<T>, DynamicMatrix<T>>
+    randomized_svd(const DynamicMatrix<T, V> &A, size_t rank, size_t oversample = 10, size_t power_iterations = 2,
+                   SolverResult<T> *result = nullptr){
+        return randomized_svd(DynamicMatrix<T>(A), rank, oversample, power_iterations, result);
+    }
+
+}   // Lee
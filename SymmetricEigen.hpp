@@ -0,0 +1,264 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <limits>
+#include <tuple>
+#include "Matrix.hpp"
+#include "DynamicMatrix.hpp"
+#include "Gemm.hpp"
+#include "QR.hpp"
+#include "Parallel.hpp"
+#include "Monitor.hpp"
+
+/*
+** All eigenvalues (and eigenvectors) of a dense symmetric matrix, A = Z*diag(w)*Z^T
+** | symmetric_eigen(A, result)     (w n x 1 ascending, Z n x n, column j the unit eigenvector of w(j))
+** | symmetric_eigenvalues(A, result)
+** |                                w alone: no reflectors kept, no rotations accumulated, O(n^2) after the reduction
+** | result (Monitor.hpp)           QL sweeps, and converged = false when a value needed more than 30*n of them;
+** |                                residual: largest |e(i)|/(|d(i)|+|d(i+1)|) left undeflated
+** | sym_tridiagonalize(n, a, lda, d, e, tau)
+** |                                Q^T*A*Q = tridiagonal (diagonal d, subdiagonal e); reflectors below the subdiagonal
+** | sym_form_q(n, a, lda, tau, q)  q (n x n) = Q^T
+** | sym_tridiagonal_ql(n, d, e, z) implicit QL with Wilkinson shifts, rows of z rotated along (z = nullptr: values only)
+** |                                returns the sweeps taken
+** blocking
+** | LEE_SYTRD_BLOCK columns are reduced at a time, the trailing matrix updated by A -= V*W^T+W*V^T as two GEMMs;
+** | Q is formed from the reflectors in compact WY form (QR.hpp); every QL sweep is applied to z split over threads
+** only the lower triangle of A is read; all matrices row-major
+*/
+
+#ifndef LEE_SYTRD_BLOCK
+#define LEE_SYTRD_BLOCK 32
+#endif
+
+namespace MatrixImpl{
+
+    // H = I - tau*v*v^T with H*x = beta*e_0, x (n, stride inc) overwritten by v(1:n); returns beta
+    template<typename T>
+    T householder(size_t n, T *x, size_t inc, T &tau){
+        T sigma = static_cast<T>(0);
+        for(size_t i = 1; i < n; ++i)
+            sigma += x[i*inc]*x[i*inc];
+        const T alpha = x[0];
+        if(sigma == static_cast<T>(0)) { tau = static_cast<T>(0); return alpha; }
+
+        const T norm = std::sqrt(alpha*alpha+sigma);
+        const T beta = alpha > static_cast<T>(0) ? -norm : norm;
+        const T scale = 1/(alpha-beta);
+        for(size_t i = 1; i < n; ++i)
+            x[i*inc] *= scale;
+        tau = (beta-alpha)/beta;
+        return beta;
+    }
+
+    template<typename T>
+    void sym_tridiagonalize(size_t n, T *a, size_t lda, T *d, T *e, T *tau){
+        const size_t NB = LEE_SYTRD_BLOCK;
+        const T one = static_cast<T>(1), zero = static_cast<T>(0);
+        std::vector<T> V, W, v(n), w(n), tmp(NB);
+        if(n == 0) return;
+        for(size_t i = 0; i < n; ++i)
+            for(size_t j = 0; j < i; ++j)
+                a[j*lda+i] = a[i*lda+j];
+
+        for(size_t k0 = 0; k0+1 < n; k0 += NB){
+            const size_t nb = std::min(NB, n-1-k0), r = n-k0, k1 = k0+nb;
+            V.assign(r*nb, zero);
+            W.assign(r*nb, zero);
+
+            for(size_t i = 0; i < nb; ++i){
+                const size_t c = k0+i, len = n-c-1;
+                T *Vc = V.data()+(c-k0)*nb, *Wc = W.data()+(c-k0)*nb;
+
+                // A(c:n, c) -= V*W(c, :)^T + W*V(c, :)^T, the panel columns so far
+                if(i){
+                    gemv(n-c, i, -one, Vc, nb, 1, Wc, 1, one, a+c*lda+c, lda);
+                    gemv(n-c, i, -one, Wc, nb, 1, Vc, 1, one, a+c*lda+c, lda);
+                }
+                d[c] = a[c*lda+c];
+                e[c] = householder(len, a+(c+1)*lda+c, lda, tau[c]);
+                if(tau[c] == zero) continue;
+
+                v[0] = one;
+                for(size_t j = 1; j < len; ++j)
+                    v[j] = a[(c+1+j)*lda+c];
+
+                // w = tau*(A22-V*W^T-W*V^T)*v, then w -= tau/2*(w^T*v)*v
+                gemv_parallel(len, len, one, a+(c+1)*lda+c+1, lda, 1, v.data(), 1, zero, w.data(), 1);
+                if(i){
+                    gemv(i, len, one, Wc+nb, 1, nb, v.data(), 1, zero, tmp.data(), 1);
+                    gemv(len, i, -one, Vc+nb, nb, 1, tmp.data(), 1, one, w.data(), 1);
+                    gemv(i, len, one, Vc+nb, 1, nb, v.data(), 1, zero, tmp.data(), 1);
+                    gemv(len, i, -one, Wc+nb, nb, 1, tmp.data(), 1, one, w.data(), 1);
+                }
+                T wv = zero;
+                for(size_t j = 0; j < len; ++j){
+                    w[j] *= tau[c];
+                    wv += w[j]*v[j];
+                }
+                const T alpha = -tau[c]/2*wv;
+                for(size_t j = 0; j < len; ++j){
+                    Vc[(j+1)*nb+i] = v[j];
+                    Wc[(j+1)*nb+i] = w[j]+alpha*v[j];
+                }
+            }
+
+            // A(k1:n, k1:n) -= V*W^T + W*V^T
+            const size_t m2 = n-k1;
+            const T *Vk = V.data()+(k1-k0)*nb, *Wk = W.data()+(k1-k0)*nb;
+            gemm_parallel(m2, m2, nb, -one, Vk, nb, 1, Wk, 1, nb, one, a+k1*lda+k1, lda);
+            gemm_parallel(m2, m2, nb, -one, Wk, nb, 1, Vk, 1, nb, one, a+k1*lda+k1, lda);
+        }
+        d[n-1] = a[(n-1)*lda+n-1];
+        e[n-1] = zero;
+    }
+
+    // H_c acts on rows c+1..n-1 and is stored as column c of the QR reflectors of a shifted down one row
+    template<typename T>
+    void sym_form_q(size_t n, const T *a, size_t lda, const T *tau, T *q){
+        std::fill(q, q+n*n, static_cast<T>(0));
+        if(n == 0) return;
+        q[0] = static_cast<T>(1);
+        if(n == 1) return;
+
+        std::vector<T> q1((n-1)*(n-1));
+        qr_form_q(n-1, n-1, a+lda, lda, tau, q1.data(), n-1);
+        for(size_t i = 0; i+1 < n; ++i)
+            for(size_t j = 0; j+1 < n; ++j)
+                q[(j+1)*n+i+1] = q1[i*(n-1)+j];
+    }
+
+    // rows i, i+1 of z (n columns) by the rotations of one sweep, in order
+    template<typename T>
+    void sym_apply_rotations(size_t n, T *z, const T *cs, const T *sn, size_t first, size_t last){
+        parallel_rows(n, 3*n*(last-first), [=](size_t j0, size_t j1){
+            for(size_t i = last; i-- > first; ){
+                T *zi = z+i*n, *zn = z+(i+1)*n;
+                const T c = cs[i], s = sn[i];
+                for(size_t j = j0; j < j1; ++j){
+                    const T f = zn[j];
+                    zn[j] = s*zi[j]+c*f;
+                    zi[j] = c*zi[j]-s*f;
+                }
+            }
+        });
+    }
+
+    // d (n) diagonal, e (n) subdiagonal e[i] = T(i+1, i); d overwritten by the eigenvalues, e destroyed;
+    // row j of z becomes the eigenvector of d[j] (z = Q^T on entry); not converged when a value takes more than 30*n sweeps
+    template<typename T>
+    Lee::SolverResult<T> sym_tridiagonal_ql(size_t n, T *d, T *e, T *z){
+        const T eps = std::numeric_limits<T>::epsilon();
+        std::vector<T> cs(z ? n : 0), sn(z ? n : 0);
+        Lee::SolverResult<T> res{true, 0, static_cast<T>(0)};
+        if(n) e[n-1] = static_cast<T>(0);
+
+        for(size_t l = 0; l < n; ++l){
+            size_t iter = 0, m;
+            do{
+                for(m = l; m+1 < n; ++m)
+                    if(std::abs(e[m]) <= eps*(std::abs(d[m])+std::abs(d[m+1]))) break;
+                if(m == l) break;
+                if(++iter > 30*n){
+                    res.converged = false;
+                    for(size_t i = l; i+1 < n; ++i)
+                        res.residual = std::max(res.residual, std::abs(e[i])/(std::abs(d[i])+std::abs(d[i+1])));
+                    return res;
+                }
+                ++res.iterations;
+
+                T g = (d[l+1]-d[l])/(2*e[l]);
+                T r = std::hypot(g, static_cast<T>(1));
+                g = d[m]-d[l]+e[l]/(g+(g >= 0 ? r : -r));
+                T s = 1, c = 1, p = 0;
+                size_t i = m, stop = l;
+                bool underflow = false;
+                while(i-- > l){
+                    const T f = s*e[i], b = c*e[i];
+                    e[i+1] = r = std::hypot(f, g);
+                    if(r == static_cast<T>(0)) { d[i+1] -= p; e[m] = 0; underflow = true; stop = i+1; break; }
+                    s = f/r;
+                    c = g/r;
+                    g = d[i+1]-p;
+                    r = (d[i]-g)*s+2*c*b;
+                    p = s*r;
+                    d[i+1] = g+p;
+                    g = c*r-b;
+                    if(z) { cs[i] = c; sn[i] = s; }
+                }
+                if(z) sym_apply_rotations(n, z, cs.data(), sn.data(), stop, m);
+                if(underflow) continue;
+                d[l] -= p;
+                e[l] = g;
+                e[m] = 0;
+            } while(m != l);
+        }
+        return res;
+    }
+
+    // eigenvalues w ascending; z (n x n) the eigenvectors as columns unless nullptr; a destroyed
+    template<typename T>
+    Lee::SolverResult<T> sym_eigen(size_t n, T *a, size_t lda, T *w, T *z){
+        std::vector<T> e(n), tau(n), zt(z ? n*n : 0);
+        sym_tridiagonalize(n, a, lda, w, e.data(), tau.data());
+        if(z) sym_form_q(n, a, lda, tau.data(), zt.data());
+        const Lee::SolverResult<T> res = sym_tridiagonal_ql(n, w, e.data(), z ? zt.data() : nullptr);
+
+        std::vector<size_t> order(n);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [w](size_t i, size_t j) { return w[i] < w[j]; });
+        std::vector<T> sorted(n);
+        for(size_t j = 0; j < n; ++j)
+            sorted[j] = w[order[j]];
+        std::copy(sorted.begin(), sorted.end(), w);
+        if(z)
+            for(size_t j = 0; j < n; ++j)
+                for(size_t i = 0; i < n; ++i)
+                    z[i*n+j] = zt[order[j]*n+i];
+        return res;
+    }
+
+}   // MatrixImpl
+
+namespace Lee{
+
+    template<typename T, size_t N, typename V>
+    std::tuple<Matrix<T, N, 1>, Matrix<T, N, N>> symmetric_eigen(const Matrix<T, N, N, V> &A, SolverResult<T> *result = nullptr){
+        Matrix<T, N, N> a(A), z;
+        Matrix<T, N, 1> w;
+        MatrixImpl::solver_result(result, MatrixImpl::sym_eigen(N, &a(0, 0), N, &w(0, 0), &z(0, 0)));
+        return std::make_tuple(w, z);
+    }
+
+    template<typename T, typename V>
+    std::tuple<DynamicMatrix<T>, DynamicMatrix<T>> symmetric_eigen(const DynamicMatrix<T, V> &A, SolverResult<T> *result = nullptr){
+        assert(A.rows() == A.cols() && "matrix is not square");
+        const size_t n = A.rows();
+        DynamicMatrix<T> a(A), w(n, 1), z(n, n);
+        MatrixImpl::solver_result(result, n ? MatrixImpl::sym_eigen(n, &a(0, 0), n, &w(0, 0), &z(0, 0)) : SolverResult<T>{true, 0, static_cast<T>(0)});
+        return std::make_tuple(w, z);
+    }
+
+    template<typename T, size_t N, typename V>
+    Matrix<T, N, 1> symmetric_eigenvalues(const Matrix<T, N, N, V> &A, SolverResult<T> *result = nullptr){
+        Matrix<T, N, N> a(A);
+        Matrix<T, N, 1> w;
+        MatrixImpl::solver_result(result, MatrixImpl::sym_eigen(N, &a(0, 0), N, &w(0, 0), static_cast<T*>(nullptr)));
+        return w;
+    }
+
+    template<typename T, typename V>
+    DynamicMatrix<T> symmetric_eigenvalues(const DynamicMatrix<T, V> &A, SolverResult<T> *result = nullptr){
+        assert(A.rows() == A.cols() && "matrix is not square");
+        const size_t n = A.rows();
+        DynamicMatrix<T> a(A), w(n, 1);
+        MatrixImpl::solver_result(result, n ? MatrixImpl::sym_eigen(n, &a(0, 0), n, &w(0, 0), static_cast<T*>(nullptr)) : SolverResult<T>{true, 0, static_cast<T>(0)});
+        return w;
+    }
+
+}   // Lee
@@ -3,29 +3,138 @@
 
 #include "Elimination.hpp"
 #include "Factorization.hpp"
+#include "Sparse.hpp"
+#include "Krylov.hpp"
+#include "Monitor.hpp"
+#include "LinearOperator.hpp"
 
-namespace Lee{
+namespace MatrixImpl{
 
-    template<typename T, int N>
-    Matrix<T, N, 1> UpperBackSub(const Matrix<T, N, N> &U, Matrix<T, N, 1> b){
-        for(int i = N-1; i >= 0; --i){
-            for(int j = N-1; j > i; --j)
+    template<typename Mat, typename Vec>
+    void UpperBackSub(const Mat &U, Vec &b){
+        const size_t N = U.rows();
+        for(size_t i = N; i-- > 0;){
+            for(size_t j = N-1; j > i; --j)
                 b(i, 0) -= (U(i, j)*b(j, 0));
             b(i, 0) /= U(i, i);
         }
-        return b;
     }
 
-    template<typename T, int N>
-    Matrix<T, N, 1> LowerBackSub(const Matrix<T, N, N> &L, Matrix<T, N, 1> b){
-        for(int i = 0; i < N; ++i){
-            for(int j = 0; j < i; ++j)
+    template<typename Mat, typename Vec>
+    void LowerBackSub(const Mat &L, Vec &b){
+        const size_t N = L.rows();
+        for(size_t i = 0; i < N; ++i){
+            for(size_t j = 0; j < i; ++j)
                 b(i, 0) -=(L(i, j)*b(j, 0)); 
             b(i, 0) /= L(i, i);
         }
+    }
+
+    // Jacobi: x += D^-1*(b-A*x), r = b-A*x is left by the convergence test; any operator with a diagonal
+    template<typename T>
+    class JacobiSweep{
+    public:
+        template<typename Op>
+        explicit JacobiSweep(const Op &A) : inv(inverse_diagonal(operator_diagonal(A))) {}
+
+        template<typename Op>
+        void operator()(const Op&, const T*, const T *r, T *x) const{
+            for(size_t i = 0; i < inv.size(); ++i)
+                x[i] += inv[i]*r[i];
+        }
+
+    private:
+        std::vector<T> inv;
+    };
+
+    // Gauss-Seidel: x updated in place, row i already sees the new values above it
+    template<typename T>
+    class GaussSeidelSweep{
+    public:
+        template<typename Mat>
+        explicit GaussSeidelSweep(const Mat&) {}
+
+        template<typename Mat>
+        void operator()(const Mat &A, const T *b, const T*, T *x) const{
+            const size_t N = A.rows();
+            for(size_t i = 0; i < N; ++i){
+                T s = b[i];
+                for(size_t j = 0; j < i; ++j)
+                    s -= A(i, j)*x[j];
+                for(size_t j = i+1; j < N; ++j)
+                    s -= A(i, j)*x[j];
+                x[i] = s/A(i, i);
+            }
+        }
+
+        // the stored entries of each CSR row only
+        void operator()(const Lee::CSRMatrix<T> &A, const T *b, const T*, T *x) const{
+            const size_t N = A.rows();
+            const size_t *ptr = A.outer_index().data(), *idx = A.inner_index().data();
+            const T *val = A.values().data();
+            for(size_t i = 0; i < N; ++i){
+                T s = b[i], d = 0;
+                for(size_t p = ptr[i]; p < ptr[i+1]; ++p){
+                    if(idx[p] == i) d = val[p];
+                    else s -= val[p]*x[idx[p]];
+                }
+                x[i] = s/d;
+            }
+        }
+    };
+
+    // x refined in place by sweeps until ||b-A*x|| <= tol or max_iter sweeps
+    template<typename Sweep, typename T, typename Op, typename Vec, typename Mon>
+    Lee::SolverResult<T> stationary_solve(const Op &A, const Vec &b, Vec &x, T tol, size_t max_iter, Mon &monitor){
+        const size_t N = b.rows();
+        if(N == 0) return Lee::SolverResult<T>{true, 0, static_cast<T>(0)};
+        SolverClockFor<Mon> clock;
+        const Sweep sweep(A);
+        const T *pb = b.data().data();
+        T *px = &x(0, 0);
+        std::vector<T> r(N);
+
+        Lee::SolverResult<T> res{false, 0, operator_residual(N, A, pb, px, r.data())};
+        while(res.iterations < max_iter && res.residual > tol){
+            sweep(A, pb, r.data(), px);
+            res.residual = operator_residual(N, A, pb, px, r.data());
+            monitor(++res.iterations, res.residual, clock.elapsed());
+        }
+        res.converged = res.residual <= tol;
+        return res;
+    }
+
+}   // MatrixImpl
+
+namespace Lee{
+
+    template<typename T, size_t N>
+    Matrix<T, N, 1> UpperBackSub(const Matrix<T, N, N> &U, Matrix<T, N, 1> b){
+        MatrixImpl::UpperBackSub(U, b);
+        return b;
+    }
+
+    template<typename T>
+    DynamicMatrix<T> UpperBackSub(const DynamicMatrix<T> &U, DynamicMatrix<T> b){
+        assert(U.rows() == U.cols() && U.rows() == b.rows() && "dimensions do not match");
+        MatrixImpl::UpperBackSub(U, b);
+        return b;
+    }
+
+    template<typename T, size_t N>
+    Matrix<T, N, 1> LowerBackSub(const Matrix<T, N, N> &L, Matrix<T, N, 1> b){
+        MatrixImpl::LowerBackSub(L, b);
+        return b;
+    }
+
+    template<typename T>
+    DynamicMatrix<T> LowerBackSub(const DynamicMatrix<T> &L, DynamicMatrix<T> b){
+        assert(L.rows() == L.cols() && L.rows() == b.rows() && "dimensions do not match");
+        MatrixImpl::LowerBackSub(L, b);
         return b;
     }
-    template<typename T, int N>
+
+    template<typename T, size_t N>
     Matrix<T, N, 1> GaussianDirect(const Matrix<T, N, N> &A, const Matrix<T, N, 1> &b){
         // Forward elimination
         Matrix<T, N, N+1> Au = col_cat<T, N, N+1>(A, b);
@@ -38,108 +147,144 @@ namespace Lee{
         return x;
     }
 
-    template<typename T, int N>
-    Matrix<T, N, 1> GaussianPLU(Matrix<T, N, N> A, Matrix<T, N, 1> b){
+    template<typename T>
+    DynamicMatrix<T> GaussianDirect(const DynamicMatrix<T> &A, const DynamicMatrix<T> &b){
+        const size_t N = A.rows();
         // Forward elimination
-        Matrix<T, N, N> L = std::get<0>(PLU(A));
-        Matrix<T, N, N> U = std::get<1>(PLU(A));
+        DynamicMatrix<T> Au = upper(col_cat(A, b));
+        DynamicMatrix<T> An = col_split(Au, 0, N-1);
+        DynamicMatrix<T> bn = col_split(Au, N, N);
         // Back substitution
-        Matrix<T, N, 1> y = LowerBackSub(L, b);
-        Matrix<T, N, 1> x = UpperBackSub(U, y);
+        DynamicMatrix<T> x = UpperBackSub(An, bn);
 
         return x;
     }
 
-    // Jacobi iteration in system form
-    template<typename T, int N>
-    Matrix<T, N, 1> DirectJacobi(Matrix<T, N, N> A, Matrix<T, N, 1> b, Matrix<T, N, 1> x0, T tol){
-        Matrix<T, N, 1> x1 = x0, x2;
-        int k = 0, km = 20;
-
-        while(k++<km && norm2(A*x2-b)>tol){
-            x2.to_zero();
-            for(int i = 0; i < N; ++i){
-                for(int j = 0; j < i; ++j)
-                    x2(i, 0) += A(i, j)*x1(j, 0);
-                for(int j = i+1; j < N; ++j)
-                    x2(i, 0) += A(i, j)*x1(j, 0);
-                x2(i, 0) = -(x2(i, 0)-b(i, 0))/A(i, i);
-            }
-            cout << "x:\n" << x1;             
-            x1 = x2;
-        }
-        if(k >= km) std::cerr << "Iteration Fail!\n";
-        return x2;
-    }
-
-    // Jacobi iteration in matrix form
-    template<typename T, int N>
-    Matrix<T, N, 1> MatrixJacobi(Matrix<T, N, N> A, Matrix<T, N, 1> b, Matrix<T, N, 1> x0, T tol){
-        Matrix<T, N, 1> x1 = x0, x2;
-        int k = 0, km = 20;
-        Matrix<T, N, N> D, L, U;
-
-        for(int i = 0; i < N; ++i)
-                D(i, i) = A(i, i);
-        for(int i = 0; i < N; ++i)
-            for(int j = 0; j < i; ++j)
-                L(i, j) = A(i, j);
-        for(int i = 0; i < N; ++i)
-            for(int j = i+1; j < N; ++j)
-                U(i, j) = A(i, j);
-
-        while(k++<km && norm2(A*x2-b)>tol){
-            std::cout << "x:\n" << x1;
-            x2 = inv(D)*(b-(L+U)*x1);
-            x1 = x2;
-        }
-        if(k >= km) std::cerr << "Iteration Fail!\n";
-        return x2;
-    }
-
-    template<typename T, int N>
-    Matrix<T, N, 1> DirectGaussSeidel(Matrix<T, N, N> A, Matrix<T, N, 1> b, Matrix<T, N, 1>x0, T tol){
-        Matrix<T, N, 1> x1 = x0, x2;
-        int k = 0, km = 20;
-
-        while(k++<km && norm2(A*x2-b)>tol){
-            x2.to_zero();
-            for(int i = 0; i < N; ++i){
-                for(int j = 0; j < i; ++j)
-                    x2(i, 0) += A(i, j)*x2(j, 0);
-                for(int j = i+1; j < N; ++j)
-                    x2(i, 0) += A(i, j)*x1(j, 0);
-                x2(i, 0) = -(x2(i, 0)-b(i, 0))/A(i, i);
-            }
-            std::cout << "x:\n" << x1;
-            x1 = x2;
+    template<typename T, size_t N>
+    Matrix<T, N, 1> GaussianPLU(Matrix<T, N, N> A, Matrix<T, N, 1> b){
+        std::vector<size_t> perm;
+        // Forward elimination, A overwritten by L\U
+        int sign = lu_inplace(A, perm);
+        assert(sign != 0 && "GaussianPLU with a singular matrix");
+        (void)sign;
+        // Forward and back substitution
+        MatrixImpl::lu_solve<T>(A, perm, b);
+
+        return b;
+    }
+
+    template<typename T>
+    DynamicMatrix<T> GaussianPLU(DynamicMatrix<T> A, DynamicMatrix<T> b){
+        assert(A.rows() == b.rows() && "dimensions do not match");
+        std::vector<size_t> perm;
+        // Forward elimination, A overwritten by L\U
+        int sign = lu_inplace(A, perm);
+        assert(sign != 0 && "GaussianPLU with a singular matrix");
+        (void)sign;
+        // Forward and back substitution
+        MatrixImpl::lu_solve<T>(A, perm, b);
+
+        return b;
+    }
+
+    // A symmetric positive definite: A = L*L^T, then L*y = b and L^T*x = y
+    template<typename T, size_t N>
+    Matrix<T, N, 1> GaussianCholesky(Matrix<T, N, N> A, Matrix<T, N, 1> b){
+        bool spd = cholesky_inplace(A);
+        assert(spd && "GaussianCholesky with a matrix that is not positive definite");
+        (void)spd;
+        // only the lower triangle holds L
+        MatrixImpl::LowerBackSub(A, b);
+        MatrixImpl::UpperBackSub(transpose(A), b);
+
+        return b;
+    }
+
+    template<typename T>
+    DynamicMatrix<T> GaussianCholesky(DynamicMatrix<T> A, DynamicMatrix<T> b){
+        assert(A.rows() == b.rows() && "dimensions do not match");
+        bool spd = cholesky_inplace(A);
+        assert(spd && "GaussianCholesky with a matrix that is not positive definite");
+        (void)spd;
+        // only the lower triangle holds L
+        MatrixImpl::LowerBackSub(A, b);
+        MatrixImpl::UpperBackSub(transpose(A), b);
+
+        return b;
+    }
+
+    // Jacobi iteration in system form, x0 the first iterate; progress in result and monitor (Monitor.hpp)
+    // A: any operator with a diagonal (LinearOperator.hpp); b, x0: Matrix<T, N, 1> or DynamicMatrix<T>
+    template<typename Op, typename Vec, typename Mon = NullMonitor>
+    Vec DirectJacobi(const Op &A, const Vec &b, Vec x0, typename Vec::value_type tol, size_t max_iter = 1000,
+                     SolverResult<typename Vec::value_type> *result = nullptr, Mon monitor = Mon()){
+        assert(A.rows() == A.cols() && A.rows() == b.rows() && A.rows() == x0.rows() && "dimensions do not match");
+        typedef MatrixImpl::JacobiSweep<typename Vec::value_type> Sweep;
+        MatrixImpl::solver_result(result, MatrixImpl::stationary_solve<Sweep>(A, b, x0, tol, max_iter, monitor));
+        return x0;
+    }
+
+    // Jacobi iteration in matrix form: x = D^-1*(b-(L+U)*x)
+    template<typename T, size_t N, typename Mon = NullMonitor>
+    Matrix<T, N, 1> MatrixJacobi(const Matrix<T, N, N> &A, const Matrix<T, N, 1> &b, Matrix<T, N, 1> x0, T tol,
+                                 size_t max_iter = 1000, SolverResult<T> *result = nullptr, Mon monitor = Mon()){
+        MatrixImpl::SolverClockFor<Mon> clock;
+        Matrix<T, N, N> D, LU;
+
+        for(size_t i = 0; i < N; ++i)
+            for(size_t j = 0; j < N; ++j)
+                (i == j ? D(i, j) : LU(i, j)) = A(i, j);
+        const Matrix<T, N, N> Dinv = inv(D);
+
+        SolverResult<T> res{false, 0, norm2(A*x0-b)};
+        while(res.iterations < max_iter && res.residual > tol){
+            x0 = Dinv*(b-LU*x0);
+            res.residual = norm2(A*x0-b);
+            monitor(++res.iterations, res.residual, clock.elapsed());
         }
-        if(k >= km) std::cerr << "Iteration Fail!\n";
-        return x2;
-    }
-
-    // maybe not exist!!!
-    template<typename T, int N>
-    Matrix<T, N, 1> MatrixGaussSeidel(Matrix<T, N, N> A, Matrix<T, N, 1> b, Matrix<T, N, 1>x0, T tol){
-        Matrix<T, N, 1> x1 = x0, x2;
-        int k = 0, km = 20;
-        Matrix<T, N, N> L, D, U;
-
-        for(int i = 0; i < N; ++i)
-            D(i, i) = A(i, i);
-        for(int i = 0; i < N; ++i)
-            for(int j = 0; j < i; ++j)
-                L(i, j) = A(i, j);
-        for(int i = 0; i < N; ++i)
-            for(int j = i+1; j < N; ++j)
-                U(i, j) = A(i, j);
-
-        while(k++<km && norm2(A*x2-b)>tol){
-            x2 = inv(D)*(b-U*x1-L*x2);
-            x1 = x2;
+        res.converged = res.residual <= tol;
+        MatrixImpl::solver_result(result, res);
+        return x0;
+    }
+
+    // A: Matrix, DynamicMatrix or SparseMatrix, the sweeps read its rows
+    template<typename Mat, typename Vec, typename Mon = NullMonitor>
+    Vec DirectGaussSeidel(const Mat &A, const Vec &b, Vec x0, typename Vec::value_type tol, size_t max_iter = 1000,
+                          SolverResult<typename Vec::value_type> *result = nullptr, Mon monitor = Mon()){
+        assert(A.rows() == A.cols() && A.rows() == b.rows() && A.rows() == x0.rows() && "dimensions do not match");
+        typedef MatrixImpl::GaussSeidelSweep<typename Vec::value_type> Sweep;
+        MatrixImpl::solver_result(result, MatrixImpl::stationary_solve<Sweep>(A, b, x0, tol, max_iter, monitor));
+        return x0;
+    }
+
+    // a CSC matrix is converted to rows once
+    template<typename T, typename Vec, typename Mon = NullMonitor>
+    Vec DirectGaussSeidel(const CSCMatrix<T> &A, const Vec &b, Vec x0, typename Vec::value_type tol, size_t max_iter = 1000,
+                          SolverResult<typename Vec::value_type> *result = nullptr, Mon monitor = Mon()){
+        return DirectGaussSeidel(to_csr(A), b, x0, tol, max_iter, result, monitor);
+    }
+
+    // Gauss-Seidel in matrix form: x = (D+L)^-1*(b-U*x)
+    template<typename T, size_t N, typename Mon = NullMonitor>
+    Matrix<T, N, 1> MatrixGaussSeidel(const Matrix<T, N, N> &A, const Matrix<T, N, 1> &b, Matrix<T, N, 1> x0, T tol,
+                                      size_t max_iter = 1000, SolverResult<T> *result = nullptr, Mon monitor = Mon()){
+        MatrixImpl::SolverClockFor<Mon> clock;
+        Matrix<T, N, N> DL, U;
+
+        for(size_t i = 0; i < N; ++i)
+            for(size_t j = 0; j < N; ++j)
+                (j <= i ? DL(i, j) : U(i, j)) = A(i, j);
+        const Matrix<T, N, N> DLinv = inv(DL);
+
+        SolverResult<T> res{false, 0, norm2(A*x0-b)};
+        while(res.iterations < max_iter && res.residual > tol){
+            x0 = DLinv*(b-U*x0);
+            res.residual = norm2(A*x0-b);
+            monitor(++res.iterations, res.residual, clock.elapsed());
         }
-        if(k >= km) std::cerr<<"Iteration Fail\n";
-        return x2;
+        res.converged = res.residual <= tol;
+        MatrixImpl::solver_result(result, res);
+        return x0;
     }
 }
 
@@ -0,0 +1,25 @@
+#include <iostream>
+
+// regression tests, built at -O2 by "make test"; each one asserts on failure
+void Evaluator_Test();
+void Batched_Test();
+void KrylovEigen_Test();
+void Factorization_Test();
+void Eigen_Test();
+void Krylov_Test();
+void Sparse_Test();
+void Polynomial_Test();
+
+int main(){
+    Evaluator_Test();
+    Batched_Test();
+    KrylovEigen_Test();
+    Factorization_Test();
+    Eigen_Test();
+    Krylov_Test();
+    Sparse_Test();
+    Polynomial_Test();
+
+    std::cout << "\nall tests passed\n";
+    return 0;
+}